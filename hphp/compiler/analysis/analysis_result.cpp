@@ -269,6 +269,16 @@ bool AnalysisResult::classMemberExists(const std::string &name,
   return m_classDecs.find(name) != m_classDecs.end();
 }
 
+ClassScopePtr
+AnalysisResult::findUniqueMethodClass(const std::string &name) const {
+  StringToClassScopePtrVecMap::const_iterator iter =
+    m_methodToClassDecs.find(name);
+  if (iter != m_methodToClassDecs.end() && iter->second.size() == 1) {
+    return iter->second[0];
+  }
+  return ClassScopePtr();
+}
+
 ClassScopePtr AnalysisResult::findExactClass(ConstructPtr cs,
                                              const std::string &name) const {
   ClassScopePtr cls = findClass(name);
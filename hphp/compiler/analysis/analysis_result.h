@@ -293,6 +293,12 @@ public:
    */
   ClassScopePtrVec findClasses(const std::string &className) const;
   bool classMemberExists(const std::string &name, FindClassBy by) const;
+  /**
+   * Find the only class that has a method by this (lower-cased) name,
+   * either declared or inherited. Returns null if there is no such
+   * class or if there is more than one.
+   */
+  ClassScopePtr findUniqueMethodClass(const std::string &methodName) const;
   ClassScopePtr findExactClass(ConstructPtr cs, const std::string &name) const;
   bool checkClassPresent(ConstructPtr cs, const std::string &name) const;
   FunctionScopePtr findFunction(const std::string &funcName) const ;
@@ -17,6 +17,7 @@
 #include <util/logger.h>
 #include <util/util.h>
 #include <util/job_queue.h>
+#include <util/timer.h>
 #include <util/parser/hphp.tab.hpp>
 #include <runtime/vm/bytecode.h>
 #include <runtime/vm/repo.h>
@@ -93,8 +94,11 @@
 
 #include <system/lib/systemlib.h>
 
+#include <atomic>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <set>
 #include <vector>
 #include <algorithm>
 
@@ -789,7 +793,7 @@ void SymbolicStack::setInt(int64 v) {
   m_symStack.back().intval = v;
 }
 
-void SymbolicStack::setKnownType(DataType dt, bool predicted /* = false */) {
+void SymbolicStack::setKnownType(DataType dt, Unit::MetaInfo::Kind kind) {
   assert(m_symStack.size());
   SymEntry& se = m_symStack.back();
   if (se.className) {
@@ -800,7 +804,7 @@ void SymbolicStack::setKnownType(DataType dt, bool predicted /* = false */) {
     se.metaType = META_DATA_TYPE;
     se.metaData.dt = dt;
   }
-  se.dtPredicted = predicted;
+  se.dtKind = kind;
 }
 
 DataType SymbolicStack::getKnownType(int index, bool noRef) const {
@@ -817,10 +821,11 @@ DataType SymbolicStack::getKnownType(int index, bool noRef) const {
   return KindOfUnknown;
 }
 
-bool SymbolicStack::isTypePredicted(int index /* = -1, stack top */) const {
+Unit::MetaInfo::Kind
+SymbolicStack::getKnownTypeKind(int index /* = -1, stack top */) const {
   if (index < 0) index += m_symStack.size();
   assert((unsigned)index < m_symStack.size());
-  return m_symStack[index].dtPredicted;
+  return m_symStack[index].dtKind;
 }
 
 void SymbolicStack::cleanTopMeta() {
@@ -1060,6 +1065,7 @@ void MetaInfoBuilder::add(int pos, Unit::MetaInfo::Kind kind,
   } else if (i == 1 && info[0].m_kind == Unit::MetaInfo::NopOut) {
     return;
   } else if (kind == Unit::MetaInfo::DataTypeInferred ||
+             kind == Unit::MetaInfo::DataTypeProgramInferred ||
              kind == Unit::MetaInfo::DataTypePredicted) {
     // Put DataType first, because if applyInputMetaData saw Class
     // first, it would call recordRead which mark the input as
@@ -1070,14 +1076,11 @@ void MetaInfoBuilder::add(int pos, Unit::MetaInfo::Kind kind,
 }
 
 void MetaInfoBuilder::addKnownDataType(DataType dt,
-                                       bool     dtPredicted,
+                                       Unit::MetaInfo::Kind dtKind,
                                        int      pos,
                                        bool     mVector,
                                        int      arg) {
   if (dt != KindOfUnknown) {
-    Unit::MetaInfo::Kind dtKind = (dtPredicted ?
-                                   Unit::MetaInfo::DataTypePredicted :
-                                   Unit::MetaInfo::DataTypeInferred);
     add(pos, dtKind, mVector, arg, dt);
   }
 }
@@ -1188,7 +1191,7 @@ void EmitterVisitor::popEvalStack(char expected, int arg, int pos) {
   if (arg >= 0 && pos >= 0 &&
       (expected == StackSym::C || expected == StackSym::R)) {
     m_metaInfo.addKnownDataType(m_evalStack.getKnownType(),
-                                m_evalStack.isTypePredicted(),
+                                m_evalStack.getKnownTypeKind(),
                                 pos, false, arg);
   }
 
@@ -1230,7 +1233,7 @@ void EmitterVisitor::popSymbolicLocal(Opcode op, int arg, int pos) {
   } else {
     if (arg >= 0 && pos >= 0) {
       m_metaInfo.addKnownDataType(m_evalStack.getKnownType(),
-                                  m_evalStack.isTypePredicted(),
+                                  m_evalStack.getKnownTypeKind(),
                                   pos, false, arg);
     }
     popEvalStack(StackSym::L);
@@ -1796,6 +1799,29 @@ static StringData* getClassName(ExpressionPtr e) {
   return nullptr;
 }
 
+/*
+ * In WholeProgram mode, if exactly one class in the program has a
+ * public, non-static method by this name, any object that successfully
+ * dispatches $obj->name() without going through __call must be an
+ * instance of that class. The runtime still guards on the prediction.
+ */
+static StringData* getPredictedMethodClass(ExpressionPtr obj,
+                                           const std::string& methName) {
+  if (!Option::WholeProgram) return nullptr;
+  AnalysisResultConstPtr ar = obj->getScope()->getContainingProgram();
+  std::string lname = Util::toLower(methName);
+  ClassScopePtr cls = ar->findUniqueMethodClass(lname);
+  if (!cls || cls->isTrait() || cls->isInterface() || cls->isAbstract() ||
+      cls->isRedeclaring()) {
+    return nullptr;
+  }
+  FunctionScopePtr func = cls->findFunction(ar, lname, true);
+  if (!func || !func->isPublic() || func->isStatic() || func->isAbstract()) {
+    return nullptr;
+  }
+  return StringData::GetStaticString(cls->getOriginalName());
+}
+
 static DataType getPredictedDataType(ExpressionPtr expr) {
   if (!expr->maybeInited()) {
     return KindOfUninit;
@@ -1848,7 +1874,8 @@ void EmitterVisitor::fixReturnType(Emitter& e, FunctionCallPtr fn,
   }
 
   if (voidReturn) {
-    m_evalStack.setKnownType(KindOfNull, false /* inferred */);
+    m_evalStack.setKnownType(KindOfNull,
+                             Unit::MetaInfo::DataTypeProgramInferred);
     m_evalStack.setNotRef();
   } else if (!ref) {
     DataType dt = getPredictedDataType(fn);
@@ -1857,15 +1884,15 @@ void EmitterVisitor::fixReturnType(Emitter& e, FunctionCallPtr fn,
         switch (dt) {
           case KindOfBoolean:
           case KindOfInt64:
-          case KindOfDouble: /* inferred */
-                             m_evalStack.setKnownType(dt, false);
+          case KindOfDouble: m_evalStack.setKnownType(
+                               dt, Unit::MetaInfo::DataTypeProgramInferred);
                              break;
-          default:           /* predicted */
-                             m_evalStack.setKnownType(dt, true);
+          default:           m_evalStack.setKnownType(
+                               dt, Unit::MetaInfo::DataTypePredicted);
                              break;
         }
       } else {
-        m_evalStack.setKnownType(dt, true /* predicted */);
+        m_evalStack.setKnownType(dt, Unit::MetaInfo::DataTypePredicted);
       }
     }
     m_evalStack.setNotRef();
@@ -1922,7 +1949,7 @@ bool EmitterVisitor::visit(ConstructPtr node) {
   switch (StackSym::GetSymFlavor(sym)) {
     case StackSym::C:
       m_evalStack.setNotRef();
-      m_evalStack.setKnownType(dt);
+      m_evalStack.setKnownType(dt, Unit::MetaInfo::DataTypeProgramInferred);
       break;
     case StackSym::L:
       if (dt == KindOfUninit ||
@@ -1931,7 +1958,7 @@ bool EmitterVisitor::visit(ConstructPtr node) {
            !static_pointer_cast<SimpleVariable>(e)->couldBeAliased())) {
         m_evalStack.setNotRef();
       }
-      m_evalStack.setKnownType(dt);
+      m_evalStack.setKnownType(dt, Unit::MetaInfo::DataTypeProgramInferred);
       break;
   }
 
@@ -3078,7 +3105,8 @@ bool EmitterVisitor::visitImpl(ConstructPtr node) {
           static_pointer_cast<SimpleFunctionCall>(node));
         ExpressionListPtr params = call->getParams();
         auto inputIsAnObject = [&](int inputIndex) {
-          m_metaInfo.addKnownDataType(KindOfObject, /* predicted */ false,
+          m_metaInfo.addKnownDataType(KindOfObject,
+                                      Unit::MetaInfo::DataTypeInferred,
                                       m_ue.bcPos(), false, inputIndex);
         };
 
@@ -3438,6 +3466,14 @@ bool EmitterVisitor::visitImpl(ConstructPtr node) {
           Id id = m_ue.mergeLitstr(clsName);
           m_metaInfo.add(fpiStart, Unit::MetaInfo::Class, false,
                          useDirectForm ? 0 : 1, id);
+        } else if (useDirectForm) {
+          StringData* predicted = getPredictedMethodClass(
+            om->getObject(), om->getName());
+          if (predicted) {
+            Id id = m_ue.mergeLitstr(predicted);
+            m_metaInfo.add(fpiStart, Unit::MetaInfo::ClassPredicted, false,
+                           0, id);
+          }
         }
         {
           FPIRegionRecorder fpi(this, m_ue, m_evalStack, fpiStart);
@@ -3877,7 +3913,7 @@ void EmitterVisitor::buildVectorImm(std::vector<uchar>& vectorImm,
     char symFlavor = StackSym::GetSymFlavor(sym);
     char marker = StackSym::GetMarker(sym);
     m_metaInfo.addKnownDataType(m_evalStack.getKnownType(iFirst),
-                                m_evalStack.isTypePredicted(iFirst),
+                                m_evalStack.getKnownTypeKind(iFirst),
                                 m_ue.bcPos(), true, 0);
     if (const StringData* cls = m_evalStack.getClsName(iFirst)) {
       Id id = m_ue.mergeLitstr(cls);
@@ -3957,7 +3993,7 @@ void EmitterVisitor::buildVectorImm(std::vector<uchar>& vectorImm,
                      false, mcodeNum, m_ue.mergeLitstr(cls));
     }
     m_metaInfo.addKnownDataType(m_evalStack.getKnownType(i),
-                                m_evalStack.isTypePredicted(i),
+                                m_evalStack.getKnownTypeKind(i),
                                 m_ue.bcPos(), true, i - iFirst);
 
     switch (marker) {
@@ -7131,32 +7167,59 @@ class UEQ : public Synchronizable {
     m_ues.push_back(ue);
     notify();
   }
-  UnitEmitter* tryPop(long sec, long long nsec) {
+  /*
+   * Move every queued unit into ues, waiting up to the given time if the
+   * queue is empty.  Returns false if nothing was popped.
+   */
+  bool tryPopAll(std::vector<UnitEmitter*>& ues, long sec, long long nsec) {
     Lock lock(this);
     if (m_ues.empty()) {
       // Check for empty() after wait(), in case of spurious wakeup.
       if (!wait(sec, nsec) || m_ues.empty()) {
-        return nullptr;
+        return false;
       }
     }
     assert(m_ues.size() > 0);
-    UnitEmitter* ue = m_ues.front();
-    assert(ue != nullptr);
-    m_ues.pop_front();
-    return ue;
+    ues.insert(ues.end(), m_ues.begin(), m_ues.end());
+    m_ues.clear();
+    return true;
   }
  private:
   std::deque<UnitEmitter*> m_ues;
 };
 static UEQ s_ueq;
 
+/*
+ * Per-phase timing for emitAllHHBC, reported when it finishes.  The emit
+ * time is summed over all worker threads.
+ */
+struct EmitterStats {
+  EmitterStats() : emitMicros(0), units(0), commitMicros(0), syncMicros(0),
+                   waitMicros(0), batches(0), rollbacks(0), duplicates(0),
+                   reused(0) {}
+  std::atomic<int64> emitMicros;
+  std::atomic<int64> units;
+  // The fields below are only touched by the committing thread.
+  int64 commitMicros;
+  int64 syncMicros; // part of commitMicros spent in RepoTxn::commit()
+  int64 waitMicros;
+  int64 batches;
+  int64 rollbacks;
+  int64 duplicates;
+  int64 reused;
+};
+static EmitterStats s_emitterStats;
+
 class EmitterWorker : public JobQueueWorker<FileScopeRawPtr, true, true> {
  public:
   EmitterWorker() : m_ret(true) {}
   virtual void doJob(JobType job) {
     try {
       AnalysisResultPtr ar = ((AnalysisResult*)m_opaque)->shared_from_this();
+      int64 start = Timer::GetCurrentTimeMicros();
       UnitEmitter* ue = emitHHBCVisitor(ar, job);
+      s_emitterStats.emitMicros += Timer::GetCurrentTimeMicros() - start;
+      s_emitterStats.units++;
       if (Option::GenerateBinaryHHBC) {
         s_ueq.push(ue);
       } else {
@@ -7174,46 +7237,368 @@ class EmitterWorker : public JobQueueWorker<FileScopeRawPtr, true, true> {
   bool m_ret;
 };
 
+typedef JobQueueDispatcher<EmitterWorker::JobType, EmitterWorker>
+  EmitterDispatcher;
+typedef std::map<MD5, MD5> UnitDepsMap;
+
+/*
+ * Compiler options that change the bytecode emitted for a file.
+ */
+static const std::string& optionsSummary() {
+  static std::string summary;
+  if (summary.empty()) {
+    std::ostringstream os;
+    os << Option::WholeProgram << Option::ParseTimeOpts
+       << Option::PreOptimization << Option::PostOptimization
+       << Option::EnableHipHopSyntax << Option::EnableHipHopExperimentalSyntax
+       << Option::JitEnableRenameFunction << Option::EnableShortTags
+       << Option::EnableAspTags << Option::EnableXHP << Option::NativeXHP
+       << Option::EnableFinallyStatement << Option::AllDynamic
+       << Option::AllVolatile << Option::HardTypeHints
+       << Option::EliminateDeadCode << Option::CopyProp
+       << Option::LocalCopyProp << Option::StringLoopOpts
+       << Option::ControlFlow << Option::VariableCoalescing
+       << Option::ArrayAccessIdempotent << Option::GenerateDocComments
+       << Option::RepoDebugInfo << RuntimeOption::EnableEmitSwitch
+       << ':' << Option::ScannerType << ':' << Option::AutoInline;
+    std::set<std::string> dynamic(Option::DynamicInvokeFunctions.begin(),
+                                  Option::DynamicInvokeFunctions.end());
+    for (std::set<std::string>::const_iterator it = dynamic.begin();
+         it != dynamic.end(); ++it) {
+      os << ':' << *it;
+    }
+    summary = os.str();
+  }
+  return summary;
+}
+
+static void addTypeSummary(std::string& out, TypePtr t) {
+  out += t ? t->toString() : std::string("-");
+}
+
+/*
+ * Whole-program results the emitter reads from fsp's own scopes: the
+ * inputs to AttrUnique, AttrPersistent and AttrNoOverride, and inferred
+ * parameter and return types. Other files change these without touching
+ * fsp (a subclass overriding a method clears AttrNoOverride on the
+ * parent), so they are not covered by the file md5 or its dependencies.
+ */
+static void addScopeSummary(std::string& out, BlockScopeRawPtr scope) {
+  if (scope->is(BlockScope::ClassScope)) {
+    ClassScopeRawPtr cls = scope->getContainingClass();
+    out += "\0c:" + cls->getName() + ':';
+    out += cls->isRedeclaring() ? 'r' : '-';
+    out += '0' + (int)cls->derivesFromRedeclaring();
+    out += cls->isVolatile() ? 'v' : '-';
+    out += cls->getAttribute(ClassScope::NotFinal) ? 'n' : '-';
+  } else if (scope->is(BlockScope::FunctionScope)) {
+    FunctionScopeRawPtr f = scope->getContainingFunction();
+    out += "\0f:";
+    if (ClassScopeRawPtr cls = f->getContainingClass()) {
+      out += cls->getName() + "::";
+    }
+    out += f->getName() + ':';
+    out += f->isRedeclaring() ? 'r' : '-';
+    out += f->isVolatile() ? 'v' : '-';
+    out += f->isPersistent() ? 'p' : '-';
+    out += f->hasOverride() ? 'o' : '-';
+    out += f->isRefReturn() ? '&' : '-';
+    addTypeSummary(out, f->getReturnType());
+    for (int i = 0; i < f->getMaxParamCount(); i++) {
+      out += ',';
+      addTypeSummary(out, f->getParamType(i));
+    }
+  }
+}
+
+/*
+ * Per expression, the inferred type the emitter turns into known or
+ * predicted stack types, and the class predicted for method calls, which
+ * depends on every class in the program.
+ */
+static void addExpressionSummary(std::string& out, ConstructPtr c) {
+  if (!c) return;
+  if (ExpressionPtr e = boost::dynamic_pointer_cast<Expression>(c)) {
+    out += e->maybeInited() ? '+' : '-';
+    out += e->isNonNull() ? '!' : '?';
+    addTypeSummary(out, e->getActualType());
+    if (e->is(Expression::KindOfObjectMethodExpression)) {
+      ObjectMethodExpressionPtr om(
+        static_pointer_cast<ObjectMethodExpression>(e));
+      if (StringData* cls = getPredictedMethodClass(om->getObject(),
+                                                    om->getName())) {
+        out += '@';
+        out += cls->data();
+      }
+    }
+    out += ';';
+  }
+  for (int i = 0, n = c->getKidCount(); i < n; i++) {
+    addExpressionSummary(out, c->getNthKid(i));
+  }
+}
+
+/*
+ * Fingerprint of everything outside of fsp that its bytecode may depend
+ * on. It combines:
+ *   - the scope dependencies recorded during analysis. For functions only
+ *     the signature and inferred types are used, so changing a callee's
+ *     body leaves its callers alone. Classes and constants are represented
+ *     by the md5 of the file declaring them;
+ *   - in WholeProgram mode, the analysis results for fsp's own scopes and
+ *     expressions (see addScopeSummary and addExpressionSummary);
+ *   - the compiler options.
+ */
+static MD5 unitDepsMd5(FileScopeRawPtr fsp) {
+  BlockScopeRawPtrQueue scopes;
+  fsp->getScopesSet(scopes);
+  scopes.push_back(fsp);
+
+  std::set<std::string> summaries;
+  for (BlockScopeRawPtrQueue::const_iterator it = scopes.begin();
+       it != scopes.end(); ++it) {
+    const BlockScopeRawPtrFlagsPtrVec &deps = (*it)->getDeps();
+    for (BlockScopeRawPtrFlagsPtrVec::const_iterator dit = deps.begin();
+         dit != deps.end(); ++dit) {
+      BlockScopeRawPtr dep = dit->first;
+      FileScopeRawPtr file = dep->getContainingFile();
+      if (file == fsp) continue;
+      string summary;
+      if (FunctionScopeRawPtr f = dep->getContainingFunction()) {
+        summary = "f:";
+        if (ClassScopeRawPtr cls = dep->getContainingClass()) {
+          summary += cls->getName() + "::";
+        }
+        summary += f->getName();
+        if (f->isRedeclaring()) summary += ":r";
+        TypePtr ret = f->getReturnType();
+        summary += ":" + (ret ? ret->toString() : string("-"));
+        for (int i = 0; i < f->getMaxParamCount(); i++) {
+          summary += f->isRefParam(i) ? ",&" : ",";
+          if (TypePtr t = f->getParamType(i)) summary += t->toString();
+        }
+      } else if (ClassScopeRawPtr cls = dep->getContainingClass()) {
+        summary = "c:" + cls->getName();
+        if (cls->isRedeclaring()) summary += ":r";
+        if (file) summary += ":" + file->getMd5().toString();
+      } else if (file) {
+        summary = "F:" + file->getMd5().toString();
+      }
+      summaries.insert(summary);
+    }
+  }
+
+  string all = fsp->getMd5().toString();
+  all += '\0';
+  all += optionsSummary();
+  for (std::set<std::string>::const_iterator it = summaries.begin();
+       it != summaries.end(); ++it) {
+    all += '\0';
+    all += *it;
+  }
+  if (Option::WholeProgram) {
+    for (BlockScopeRawPtrQueue::const_iterator it = scopes.begin();
+         it != scopes.end(); ++it) {
+      addScopeSummary(all, *it);
+    }
+    all += '\0';
+    addExpressionSummary(all, fsp->getStmt());
+  }
+  int md5len;
+  char* md5str = string_md5(all.c_str(), all.size(), false, md5len);
+  MD5 md5(md5str);
+  free(md5str);
+  return md5;
+}
+
+MD5 unitFingerprint(FileScopeRawPtr fsp) {
+  return unitDepsMd5(fsp);
+}
+
+/*
+ * State of the main thread while it hands files out to the emitters.
+ */
+struct EmitterJobs {
+  explicit EmitterJobs(EmitterDispatcher& d) : dispatcher(d) {}
+  EmitterDispatcher& dispatcher;
+  UnitDepsMap deps;
+  std::vector<FileScopeRawPtr> reuse; // copied from the previous repo
+};
+
 static void addEmitterWorker(AnalysisResultPtr ar, StatementPtr sp,
                              void *data) {
-  ((JobQueueDispatcher<EmitterWorker::JobType,
-    EmitterWorker>*)data)->enqueue(sp->getFileScope());
+  EmitterJobs* jobs = (EmitterJobs*)data;
+  FileScopeRawPtr fsp = sp->getFileScope();
+  if (Option::GenerateBinaryHHBC) {
+    MD5 deps = unitDepsMd5(fsp);
+    jobs->deps[fsp->getMd5()] = deps;
+    if (!Option::GenerateTextHHBC &&
+        Repo::get().findPrevUnit(fsp->getMd5(), deps)) {
+      jobs->reuse.push_back(fsp);
+      return;
+    }
+  }
+  jobs->dispatcher.enqueue(fsp);
+}
+
+static void commitUnitDeps(const MD5& md5, const UnitDepsMap& deps) {
+  UnitDepsMap::const_iterator it = deps.find(md5);
+  if (it == deps.end()) return;
+  Repo& repo = Repo::get();
+  try {
+    RepoTxn txn(repo);
+    if (!repo.insertUnitDeps(UnitOriginFile, md5, it->second, txn)) {
+      txn.commit();
+    }
+  } catch (RepoExc& re) {
+    Logger::Verbose("Failed to record dependencies of %s",
+                    md5.toString().c_str());
+  }
 }
 
-static void batchCommit(std::vector<UnitEmitter*>& ues) {
+/*
+ * Commit the first n units of ues in a single transaction and remove them
+ * from ues.  Units whose md5 has already been written (files with
+ * identical contents) only get their path recorded; inserting them again
+ * would fail and roll back the whole batch.
+ */
+static void batchCommit(std::vector<UnitEmitter*>& ues, size_t n,
+                        std::set<MD5>& written, const UnitDepsMap& deps) {
   assert(Option::GenerateBinaryHHBC);
+  assert(n <= ues.size());
   Repo& repo = Repo::get();
+  int64 start = Timer::GetCurrentTimeMicros();
 
-  // Attempt batch commit.  This can legitimately fail due to multiple input
-  // files having identical contents.
+  // A unit is a duplicate if an earlier batch wrote it, or an earlier
+  // unit in this one. Nothing is added to 'written' until it is in the
+  // repo.
+  std::vector<bool> dup(n);
+  std::set<MD5> batch;
+  for (size_t i = 0; i < n; i++) {
+    const MD5& md5 = ues[i]->md5();
+    dup[i] = written.count(md5) || !batch.insert(md5).second;
+    if (dup[i]) s_emitterStats.duplicates++;
+  }
+
+  // Attempt batch commit.  This can still fail if the repo already holds
+  // some of the units.
   bool err = false;
-  {
+  try {
     RepoTxn txn(repo);
 
-    for (std::vector<UnitEmitter*>::const_iterator it = ues.begin();
-         it != ues.end(); ++it) {
-      UnitEmitter* ue = *it;
-      if (repo.insertUnit(ue, UnitOriginFile, txn)) {
+    for (size_t i = 0; i < n; i++) {
+      UnitEmitter* ue = ues[i];
+      if (dup[i] ? repo.insertMd5(UnitOriginFile, ue, txn)
+                 : repo.insertUnit(ue, UnitOriginFile, txn)) {
+        err = true;
+        break;
+      }
+      UnitDepsMap::const_iterator it = deps.find(ue->md5());
+      if (!dup[i] && it != deps.end() &&
+          repo.insertUnitDeps(UnitOriginFile, ue->md5(), it->second, txn)) {
         err = true;
         break;
       }
     }
     if (!err) {
+      int64 syncStart = Timer::GetCurrentTimeMicros();
       txn.commit();
+      s_emitterStats.syncMicros += Timer::GetCurrentTimeMicros() - syncStart;
     }
+  } catch (RepoExc& re) {
+    Logger::Verbose("Batch commit of %zu units failed: %s", n,
+                    re.msg().c_str());
+    err = true;
   }
 
   // Clean up.
-  for (std::vector<UnitEmitter*>::const_iterator it = ues.begin();
-       it != ues.end(); ++it) {
-      UnitEmitter* ue = *it;
-      // Commit units individually if an error occurred during batch commit.
-      if (err) {
+  for (size_t i = 0; i < n; i++) {
+    UnitEmitter* ue = ues[i];
+    // Commit units individually if an error occurred during batch commit.
+    if (err) {
+      if (dup[i]) {
+        repo.commitMd5(UnitOriginFile, ue);
+      } else {
         repo.commitUnit(ue, UnitOriginFile);
+        commitUnitDeps(ue->md5(), deps);
       }
-      delete ue;
+    }
+    written.insert(ue->md5());
+    delete ue;
   }
-  ues.clear();
+  ues.erase(ues.begin(), ues.begin() + n);
+
+  s_emitterStats.batches++;
+  if (err) s_emitterStats.rollbacks++;
+  s_emitterStats.commitMicros += Timer::GetCurrentTimeMicros() - start;
+}
+
+static bool copyPrevUnit(FileScopeRawPtr fsp, bool dup,
+                         const UnitDepsMap& deps, RepoTxn& txn) {
+  Repo& repo = Repo::get();
+  const MD5& md5 = fsp->getMd5();
+  const StringData* path = StringData::GetStaticString(fsp->getName());
+  if (dup) {
+    return repo.insertMd5(UnitOriginFile, path, md5, txn);
+  }
+  UnitDepsMap::const_iterator it = deps.find(md5);
+  assert(it != deps.end());
+  return repo.copyPrevUnit(UnitOriginFile, md5, txn) ||
+    repo.insertMd5(UnitOriginFile, path, md5, txn) ||
+    repo.insertUnitDeps(UnitOriginFile, md5, it->second, txn);
+}
+
+/*
+ * Copy the units of unchanged files from the previous repo, in batches.
+ * A file that cannot be copied is handed to the emitters instead.
+ */
+static void copyPrevUnits(EmitterJobs& jobs, size_t batchSize,
+                          std::set<MD5>& written) {
+  Repo& repo = Repo::get();
+  int64 start = Timer::GetCurrentTimeMicros();
+  const std::vector<FileScopeRawPtr>& files = jobs.reuse;
+  for (size_t first = 0; first < files.size(); first += batchSize) {
+    size_t n = std::min(batchSize, files.size() - first);
+    std::vector<bool> dup(n);
+    for (size_t i = 0; i < n; i++) {
+      dup[i] = !written.insert(files[first + i]->getMd5()).second;
+    }
+
+    bool err = false;
+    try {
+      RepoTxn txn(repo);
+      for (size_t i = 0; i < n && !err; i++) {
+        err = copyPrevUnit(files[first + i], dup[i], jobs.deps, txn);
+      }
+      if (!err) txn.commit();
+    } catch (RepoExc& re) {
+      err = true;
+    }
+    s_emitterStats.batches++;
+    if (!err) {
+      s_emitterStats.reused += n;
+      continue;
+    }
+
+    s_emitterStats.rollbacks++;
+    for (size_t i = 0; i < n; i++) {
+      FileScopeRawPtr fsp = files[first + i];
+      bool failed = true;
+      try {
+        RepoTxn txn(repo);
+        failed = copyPrevUnit(fsp, dup[i], jobs.deps, txn);
+        if (!failed) txn.commit();
+      } catch (RepoExc& re) {
+      }
+      if (failed) {
+        if (!dup[i]) written.erase(fsp->getMd5());
+        jobs.dispatcher.enqueue(fsp);
+      } else {
+        s_emitterStats.reused++;
+      }
+    }
+  }
+  s_emitterStats.commitMicros += Timer::GetCurrentTimeMicros() - start;
 }
 
 static void emitSystemLib() {
@@ -7280,35 +7665,57 @@ void emitAllHHBC(AnalysisResultPtr ar) {
   /* same for TypeConstraint */
   TypeConstraint tc;
 
-  JobQueueDispatcher<EmitterWorker::JobType, EmitterWorker>
-    dispatcher(threadCount, true, 0, false, ar.get());
+  if (Option::GenerateBinaryHHBC && !Option::RepoPreviousPath.empty()) {
+    if (Option::PreOptimization || Option::PostOptimization ||
+        Option::AutoInline) {
+      // These rewrite a file's AST with constants and function bodies
+      // from other files, which the unit fingerprint does not capture.
+      Logger::Warning("Not reusing units from %s with cross-file "
+                      "optimizations enabled; emitting all files",
+                      Option::RepoPreviousPath.c_str());
+    } else if (!Repo::get().attachPrevious(
+                 Option::RepoPreviousPath.c_str())) {
+      Logger::Warning("Unable to reuse units from %s; emitting all files",
+                      Option::RepoPreviousPath.c_str());
+    }
+  }
+
+  Timer timer(Timer::WallTime);
+  EmitterDispatcher dispatcher(threadCount, true, 0, false, ar.get());
+  EmitterJobs jobs(dispatcher);
 
   dispatcher.start();
-  ar->visitFiles(addEmitterWorker, &dispatcher);
+  ar->visitFiles(addEmitterWorker, &jobs);
 
   if (Option::GenerateBinaryHHBC) {
-    // kBatchSize needs to strike a balance between reducing transaction commit
-    // overhead (bigger batches are better), and limiting the cost incurred by
-    // failed commits due to identical units that require rollback and retry
-    // (smaller batches have less to lose).  Empirical results indicate that a
-    // value in the 2-10 range is reasonable.
-    static const unsigned kBatchSize = 8;
+    // The batch size needs to strike a balance between reducing transaction
+    // commit overhead (bigger batches are better), and limiting the cost
+    // incurred by failed commits that require rollback and retry (smaller
+    // batches have less to lose).  Since units with identical contents are
+    // filtered out before insertion, failures are rare.
+    const size_t batchSize = Option::RepoCommitBatchSize;
     std::vector<UnitEmitter*> ues;
+    std::set<MD5> written;
+
+    // Units of unchanged files are copied while the workers are busy
+    // emitting the rest.
+    copyPrevUnits(jobs, batchSize, written);
 
     // Gather up units created by the worker threads and commit them in
-    // batches.
+    // batches while the workers keep emitting.
     bool didPop;
     bool inShutdown = false;
     while (true) {
       // Poll, but with a 100ms timeout so that this thread doesn't spin wildly
       // if it gets ahead of the workers.
-      UnitEmitter* ue = s_ueq.tryPop(0, 100 * 1000 * 1000);
-      if ((didPop = (ue != nullptr))) {
-        ues.push_back(ue);
+      int64 start = Timer::GetCurrentTimeMicros();
+      didPop = s_ueq.tryPopAll(ues, 0, 100 * 1000 * 1000);
+      s_emitterStats.waitMicros += Timer::GetCurrentTimeMicros() - start;
+      while (ues.size() >= batchSize) {
+        batchCommit(ues, batchSize, written, jobs.deps);
       }
-      if (ues.size() == kBatchSize
-          || (!didPop && inShutdown && ues.size() > 0)) {
-        batchCommit(ues);
+      if (!didPop && inShutdown && ues.size() > 0) {
+        batchCommit(ues, ues.size(), written, jobs.deps);
       }
       if (!inShutdown) {
         inShutdown = dispatcher.pollEmpty();
@@ -7322,6 +7729,22 @@ void emitAllHHBC(AnalysisResultPtr ar) {
   } else {
     dispatcher.waitEmpty();
   }
+
+  const EmitterStats& st = s_emitterStats;
+  Logger::Info("emitted %lld units in %lld ms on %u threads "
+               "(%lld ms summed over threads)",
+               (long long)st.units.load(), (long long)timer.getMicroSeconds()
+               / 1000, threadCount, (long long)st.emitMicros.load() / 1000);
+  if (Option::GenerateBinaryHHBC) {
+    Logger::Info("repo commit: %lld ms (%lld ms in transaction commits) in "
+                 "%lld batches (%lld rolled back), "
+                 "%lld duplicate units, %lld units reused, "
+                 "%lld ms waiting for emitters",
+                 (long long)st.commitMicros / 1000,
+                 (long long)st.syncMicros / 1000, (long long)st.batches,
+                 (long long)st.rollbacks, (long long)st.duplicates,
+                 (long long)st.reused, (long long)st.waitMicros / 1000);
+  }
 }
 
 /**
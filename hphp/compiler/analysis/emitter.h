@@ -63,7 +63,7 @@ struct MetaInfoBuilder {
   void add(int pos, Unit::MetaInfo::Kind kind,
            bool mVector, int arg, Id data);
   void addKnownDataType(DataType dt,
-                        bool     dtPredicted,
+                        Unit::MetaInfo::Kind dtKind,
                         int      pos,
                         bool     mVector,
                         int      arg);
@@ -184,7 +184,7 @@ private:
       , metaType(META_NONE)
       , notRef(false)
       , notNull(false)
-      , dtPredicted(false)
+      , dtKind(Unit::MetaInfo::DataTypeInferred)
       , className(nullptr)
       , intval(-1)
       , unnamedLocalStart(InvalidAbsoluteOffset)
@@ -194,11 +194,11 @@ private:
     MetaType metaType;
     bool notRef:1;
     bool notNull:1;
-    bool dtPredicted:1;
     union {
       const StringData* name;   // META_LITSTR
       DataType dt;              // META_DATA_TYPE
     }   metaData;
+    Unit::MetaInfo::Kind dtKind; // how metaData.dt is known
     const StringData* className;
     int64 intval; // used for L and I symbolic flavors
 
@@ -242,7 +242,8 @@ public:
   void setKnownCls(const StringData* s, bool nonNull);
   void setNotRef();
   bool getNotRef() const;
-  void setKnownType(DataType dt, bool predicted = false);
+  void setKnownType(DataType dt, Unit::MetaInfo::Kind kind =
+                                  Unit::MetaInfo::DataTypeInferred);
   void cleanTopMeta();
   DataType getKnownType(int index = -1, bool noRef = true) const;
   void setClsBaseType(ClassBaseType);
@@ -253,7 +254,7 @@ public:
   const StringData* getName(int index) const;
   const StringData* getClsName(int index) const;
   bool isCls(int index) const;
-  bool isTypePredicted(int index = -1 /* stack top */) const;
+  Unit::MetaInfo::Kind getKnownTypeKind(int index = -1 /* stack top */) const;
   void set(int index, char sym);
   unsigned size() const;
   bool empty() const;
@@ -665,6 +666,12 @@ public:
 
 void emitAllHHBC(AnalysisResultPtr ar);
 
+/*
+ * The fingerprint stored with a file's unit. A unit in a previous repo is
+ * reused only if the file's md5 and this fingerprint both match.
+ */
+MD5 unitFingerprint(FileScopeRawPtr fsp);
+
 extern "C" {
   Unit* hphp_compiler_parse(const char* code, int codeLen, const MD5& md5,
                             const char* filename);
@@ -83,7 +83,9 @@ map<string, string> Option::FunctionSections;
 bool Option::GenerateTextHHBC = false;
 bool Option::GenerateBinaryHHBC = false;
 string Option::RepoCentralPath;
+string Option::RepoPreviousPath;
 bool Option::RepoDebugInfo = false;
+int Option::RepoCommitBatchSize = 64;
 
 string Option::IdPrefix = "$$";
 string Option::LabelEscape = "$";
@@ -400,7 +402,13 @@ void Option::Load(Hdf &config) {
       Hdf repoCentral = repo["Central"];
       RepoCentralPath = repoCentral["Path"].getString();
     }
+    {
+      Hdf repoPrevious = repo["Previous"];
+      RepoPreviousPath = repoPrevious["Path"].getString();
+    }
     RepoDebugInfo = repo["DebugInfo"].getBool(false);
+    RepoCommitBatchSize = repo["CommitBatchSize"].getInt32(64);
+    if (RepoCommitBatchSize <= 0) RepoCommitBatchSize = 1;
   }
 
   {
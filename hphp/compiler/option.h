@@ -189,7 +189,9 @@ public:
   static bool GenerateTextHHBC;
   static bool GenerateBinaryHHBC;
   static std::string RepoCentralPath;
+  static std::string RepoPreviousPath;
   static bool RepoDebugInfo;
+  static int RepoCommitBatchSize;
 
   /**
    * Names of hot and cold functions to be marked in sources.
@@ -91,6 +91,12 @@ DefineConstant(
     'type'   => Int64,
   ));
 
+DefineConstant(
+  array(
+    'name'   => "JSON_FB_STREAM",
+    'type'   => Int64,
+  ));
+
 ///////////////////////////////////////////////////////////////////////////////
 // Functions
 //
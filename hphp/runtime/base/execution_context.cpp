@@ -313,6 +313,21 @@ String BaseExecutionContext::obDetachContents() {
   return "";
 }
 
+/**
+ * Send the current buffer as the whole response, handing its segments to
+ * the transport rather than joining them into one string first.
+ */
+void BaseExecutionContext::obSendContents(Transport *transport) {
+  // take the contents out first, as a header callback may write more output
+  StringBuffer contents;
+  if (!m_buffers.empty()) {
+    contents.absorb(m_buffers.back()->oss);
+  }
+  std::vector<StringSlice> segments;
+  contents.getSegments(segments);
+  transport->sendRawSegments(segments);
+}
+
 int BaseExecutionContext::obGetContentLength() {
   if (m_buffers.empty()) {
     return 0;
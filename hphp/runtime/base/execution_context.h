@@ -261,6 +261,7 @@ public:
   void obStart(CVarRef handler = null);
   String obCopyContents();
   String obDetachContents();
+  void obSendContents(Transport *transport);
   int obGetContentLength();
   void obClean();
   bool obFlush();
@@ -353,9 +354,12 @@ public:
   DECLARE_DBG_SETTING_ACCESSORS
 
 private:
+  // output buffers grow by doubling up to this size, then add segments
+  static const int kOutputSegmentSize = 64 * 1024;
+
   class OutputBuffer {
   public:
-    OutputBuffer() : oss(8192) {}
+    OutputBuffer() : oss(8192) { oss.setSegmentSize(kOutputSegmentSize); }
     StringBuffer oss;
     Variant handler;
   };
@@ -17,14 +17,19 @@
 #include <runtime/base/util/request_local.h>
 #include <util/lock.h>
 #include <util/logger.h>
+#include <util/thread_local.h>
 #include <pcre.h>
 #include <onigposix.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/builtin_functions.h>
 #include <runtime/base/zend/zend_functions.h>
+#include <runtime/base/zend/zend_string.h>
 #include <runtime/base/array/array_iterator.h>
 #include <runtime/base/taint/taint_observer.h>
+#include <runtime/vm/treadmill.h>
+#include <runtime/base/server/server_stats.h>
 #include <tbb/concurrent_hash_map.h>
+#include <atomic>
 
 #define PREG_PATTERN_ORDER          1
 #define PREG_SET_ORDER              2
@@ -38,8 +43,6 @@
 
 #define PREG_GREP_INVERT            (1<<0)
 
-#define PCRE_CACHE_SIZE 4096
-
 enum {
   PHP_PCRE_NO_ERROR = 0,
   PHP_PCRE_INTERNAL_ERROR,
@@ -53,21 +56,93 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 // regex cache and helpers
 
+// compiled patterns still allocated, cached or not
+static std::atomic<int> s_pcreEntryCount;
+
 class pcre_cache_entry {
   pcre_cache_entry(const pcre_cache_entry&);
   pcre_cache_entry& operator=(const pcre_cache_entry&);
 
 public:
-  pcre_cache_entry() {}
+  pcre_cache_entry()
+    : key(nullptr), used(true), refCount(1), fast(FastNone) {
+    s_pcreEntryCount.fetch_add(1, std::memory_order_relaxed);
+  }
   ~pcre_cache_entry() {
+    s_pcreEntryCount.fetch_sub(1, std::memory_order_relaxed);
+#ifdef PCRE_STUDY_JIT_COMPILE
+    if (extra) pcre_free_study(extra);
+#else
     if (extra) free(extra); // we don't have pcre_free_study yet
+#endif
     pcre_free(re);
+    if (key) key->destruct();
   }
 
+  const StringData *key; // malloced copy of the regex, owned by the cache
   pcre *re;
   pcre_extra *extra; // Holds results of studying
   int preg_options;
   int compile_options;
+  int num_subpats; // captured subpatterns + 1
+  // looked up since the last eviction sweep; only a hint, so relaxed
+  mutable std::atomic<bool> used;
+  // the cache's reference plus one per PCREEntryRef, kept only when !hhvm
+  mutable std::atomic<int> refCount;
+
+  void incRef() const {
+    if (!hhvm) refCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  void decRef() const {
+    if (!hhvm && refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  // Patterns simple enough to match without PCRE, see classify_pattern()
+  enum FastKind {
+    FastNone,
+    FastLiteral, // a fixed string
+    FastClass,   // one character class, maybe followed by '+'
+  };
+  FastKind fast;
+  std::string literal;
+  bool class_repeat;
+  unsigned char class_bits[256 / 8];
+
+  bool inClass(unsigned char c) const {
+    return class_bits[c >> 3] & (1 << (c & 7));
+  }
+};
+
+/*
+ * A cached pattern in use by a request. Under hhvm evicted entries are
+ * freed by the Treadmill once every request that could have looked them
+ * up has finished. Nothing advances the Treadmill otherwise, so there the
+ * handle holds a reference and the last one released frees the entry.
+ */
+class PCREEntryRef {
+public:
+  PCREEntryRef() : m_ent(nullptr) {}
+  // takes over a reference the caller already holds
+  explicit PCREEntryRef(const pcre_cache_entry *ent) : m_ent(ent) {}
+  PCREEntryRef(const PCREEntryRef &other) : m_ent(other.m_ent) {
+    if (m_ent) m_ent->incRef();
+  }
+  ~PCREEntryRef() {
+    if (m_ent) m_ent->decRef();
+  }
+  PCREEntryRef &operator=(const PCREEntryRef &other) {
+    PCREEntryRef copy(other);
+    std::swap(m_ent, copy.m_ent);
+    return *this;
+  }
+
+  operator const pcre_cache_entry*() const { return m_ent; }
+  const pcre_cache_entry *operator->() const { return m_ent; }
+
+private:
+  const pcre_cache_entry *m_ent;
 };
 
 typedef tbb::concurrent_hash_map<const StringData*,const pcre_cache_entry*,
@@ -75,25 +150,115 @@ typedef tbb::concurrent_hash_map<const StringData*,const pcre_cache_entry*,
 
 static PCREStringMap s_pcreCacheMap;
 
-static const pcre_cache_entry* lookup_cached_pcre(CStrRef regex) {
+/*
+ * Every cached entry, for the eviction sweep; concurrent_hash_map can't be
+ * iterated safely while other threads insert. Guarded by s_pcreCacheLock,
+ * which is only taken when a new pattern is compiled.
+ */
+static std::vector<const pcre_cache_entry*> s_pcreCacheEntries;
+static Mutex s_pcreCacheLock;
+
+/*
+ * Evicted entries may still be in use by requests that looked them up
+ * before they were evicted, so under hhvm they are freed once those have
+ * finished.
+ */
+class PCREEntryFreer : public VM::Treadmill::WorkItem {
+public:
+  explicit PCREEntryFreer(std::vector<const pcre_cache_entry*> &entries) {
+    m_entries.swap(entries);
+  }
+  virtual void operator()() {
+    for (unsigned int i = 0; i < m_entries.size(); i++) {
+      delete m_entries[i];
+    }
+  }
+private:
+  std::vector<const pcre_cache_entry*> m_entries;
+};
+
+/*
+ * Second-chance (CLOCK) approximation of LRU: entries that have not been
+ * looked up since the previous sweep go first, then whatever it takes to
+ * get back under 7/8 of the limit. Lookups only ever set a flag, so hits
+ * stay lock-free.
+ */
+static void evict_cached_pcres(size_t limit,
+                               std::vector<const pcre_cache_entry*> &victims) {
+  size_t target = limit - limit / 8;
+  std::vector<const pcre_cache_entry*> kept;
+  kept.reserve(s_pcreCacheEntries.size());
+  for (int pass = 0; pass < 2; pass++) {
+    size_t remaining = s_pcreCacheEntries.size() - victims.size();
+    for (unsigned int i = 0; i < s_pcreCacheEntries.size(); i++) {
+      const pcre_cache_entry *ent = s_pcreCacheEntries[i];
+      if (!ent) continue;
+      if (remaining > target &&
+          (pass == 1 || !ent->used.load(std::memory_order_relaxed))) {
+        s_pcreCacheMap.erase(ent->key);
+        victims.push_back(ent);
+        s_pcreCacheEntries[i] = nullptr;
+        remaining--;
+      } else {
+        ent->used.store(false, std::memory_order_relaxed);
+      }
+    }
+  }
+  for (unsigned int i = 0; i < s_pcreCacheEntries.size(); i++) {
+    if (s_pcreCacheEntries[i]) kept.push_back(s_pcreCacheEntries[i]);
+  }
+  s_pcreCacheEntries.swap(kept);
+}
+
+static PCREEntryRef lookup_cached_pcre(CStrRef regex) {
   TAINT_OBSERVER_CAP_STACK();
   PCREStringMap::const_accessor acc;
   if (s_pcreCacheMap.find(acc, regex.get())) {
-    return acc->second;
+    const pcre_cache_entry *ent = acc->second;
+    if (!ent->used.load(std::memory_order_relaxed)) {
+      ent->used.store(true, std::memory_order_relaxed);
+    }
+    // eviction erases under the write lock, so the entry is still cached
+    ent->incRef();
+    return PCREEntryRef(ent);
   }
-  return 0;
+  return PCREEntryRef();
 }
 
-static const pcre_cache_entry*
-insert_cached_pcre(CStrRef regex, const pcre_cache_entry* ent) {
+static PCREEntryRef
+insert_cached_pcre(CStrRef regex, pcre_cache_entry* ent) {
   TAINT_OBSERVER_CAP_STACK();
-  PCREStringMap::accessor acc;
-  if (s_pcreCacheMap.insert(acc, StringData::GetStaticString(regex.get()))) {
-    acc->second = ent;
-    return ent;
+  ent->key = new StringData(regex.data(), regex.size(), CopyMalloc);
+  std::vector<const pcre_cache_entry*> victims;
+  {
+    Lock lock(s_pcreCacheLock);
+    {
+      PCREStringMap::accessor acc;
+      if (!s_pcreCacheMap.insert(acc, ent->key)) {
+        delete ent;
+        acc->second->incRef();
+        return PCREEntryRef(acc->second);
+      }
+      acc->second = ent;
+      ent->incRef();
+    }
+    s_pcreCacheEntries.push_back(ent);
+    if (RuntimeOption::PregCacheSize > 0 &&
+        s_pcreCacheEntries.size() > (size_t)RuntimeOption::PregCacheSize) {
+      evict_cached_pcres(RuntimeOption::PregCacheSize, victims);
+    }
   }
-  delete ent;
-  return acc->second;
+  if (hhvm) {
+    if (!victims.empty()) {
+      VM::Treadmill::WorkItem::enqueue(new PCREEntryFreer(victims));
+    }
+  } else {
+    // drop the cache's reference; requests still using one keep it alive
+    for (unsigned int i = 0; i < victims.size(); i++) {
+      victims[i]->decRef();
+    }
+  }
+  return PCREEntryRef(ent);
 }
 
 /*
@@ -108,6 +273,27 @@ static __thread pcre_extra t_extra_data;
 // The last pcre error code is available for the whole thread.
 static __thread int t_last_error_code;
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+/*
+ * JIT-compiled patterns run on this stack instead of the default 32K one
+ * on the machine stack. Cached patterns are shared between threads, so
+ * they are given a callback that finds the calling thread's stack, which
+ * is freed when the thread exits.
+ */
+struct PCREJitStack {
+  PCREJitStack() : stack(pcre_jit_stack_alloc(32 * 1024, 256 * 1024)) {}
+  ~PCREJitStack() {
+    if (stack) pcre_jit_stack_free(stack);
+  }
+  pcre_jit_stack *stack;
+};
+static IMPLEMENT_THREAD_LOCAL(PCREJitStack, s_jit_stack);
+
+static pcre_jit_stack* get_jit_stack(void*) {
+  return s_jit_stack->stack;
+}
+#endif
+
 namespace {
 
 template<bool useSmartFree = false>
@@ -124,11 +310,214 @@ private:
 typedef FreeHelperImpl<true> SmartFreeHelper;
 }
 
-static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
+///////////////////////////////////////////////////////////////////////////////
+// patterns matched without PCRE
+
+static inline void class_add(unsigned char *bits, unsigned char c) {
+  bits[c >> 3] |= 1 << (c & 7);
+}
+
+/*
+ * The byte an escape inside a class or literal stands for, or -1 if it
+ * is not a plain character. Escaped non-alphanumerics are always literal.
+ */
+static int simple_escape(char c) {
+  switch (c) {
+  case 'n': return '\n';
+  case 'r': return '\r';
+  case 't': return '\t';
+  case 'f': return '\f';
+  default:
+    if (isalnum((unsigned char)c) || c == 0) return -1;
+    return (unsigned char)c;
+  }
+}
+
+static bool class_add_escape(unsigned char *bits, char c) {
+  switch (c) {
+  case 'd':
+    for (int i = '0'; i <= '9'; i++) class_add(bits, i);
+    return true;
+  case 'w':
+    for (int i = 0; i < 256; i++) {
+      if (isalnum(i) && i < 128) class_add(bits, i);
+    }
+    class_add(bits, '_');
+    return true;
+  default:
+    return false;
+  }
+}
+
+/*
+ * Recognize patterns that are a plain string, or a single character class
+ * (optionally followed by '+'), in the byte-oriented mode. Such patterns
+ * have no subpatterns and never match the empty string, so preg_exec() can
+ * find the leftmost match itself and report exactly what pcre_exec() would.
+ * Anything unusual is left to PCRE; the pattern has already compiled, so
+ * this only needs to understand valid syntax.
+ */
+static void classify_pattern(pcre_cache_entry *pce, const char *pattern,
+                             int coptions) {
+  if (coptions & (PCRE_EXTENDED | PCRE_ANCHORED | PCRE_UTF8)) return;
+  if (!*pattern) return;
+
+  if (*pattern == '[' || (*pattern == '\\' &&
+                          (pattern[1] == 'd' || pattern[1] == 'w'))) {
+    unsigned char bits[256 / 8];
+    memset(bits, 0, sizeof(bits));
+    const char *p = pattern;
+    bool negate = false;
+    if (*p == '\\') {
+      class_add_escape(bits, p[1]);
+      p += 2;
+    } else {
+      p++;
+      if (*p == '^') {
+        negate = true;
+        p++;
+      }
+      bool first = true;
+      for (;; first = false) {
+        int lo;
+        if (*p == ']' && !first) {
+          p++;
+          break;
+        }
+        if (*p == 0 || *p == '[') return;
+        if (*p == '\\') {
+          if (class_add_escape(bits, p[1])) {
+            p += 2;
+            continue;
+          }
+          lo = simple_escape(p[1]);
+          if (lo < 0) return;
+          p += 2;
+        } else {
+          lo = (unsigned char)*p++;
+        }
+        int hi = lo;
+        if (*p == '-' && p[1] != ']') {
+          p++;
+          if (*p == '\\') {
+            hi = simple_escape(p[1]);
+            if (hi < 0) return;
+            p += 2;
+          } else if (*p == '[' || *p == 0) {
+            return;
+          } else {
+            hi = (unsigned char)*p++;
+          }
+          if (hi < lo) return;
+        }
+        for (int c = lo; c <= hi; c++) class_add(bits, c);
+      }
+    }
+    bool repeat = false;
+    if (*p == '+') {
+      // under U the '+' is lazy, so every match is a single byte
+      repeat = !(coptions & PCRE_UNGREEDY);
+      p++;
+    }
+    if (*p) return;
+    if (coptions & PCRE_CASELESS) {
+      for (int c = 'a'; c <= 'z'; c++) {
+        int u = c - 'a' + 'A';
+        if ((bits[c >> 3] & (1 << (c & 7))) ||
+            (bits[u >> 3] & (1 << (u & 7)))) {
+          class_add(bits, c);
+          class_add(bits, u);
+        }
+      }
+    }
+    if (negate) {
+      for (unsigned int i = 0; i < sizeof(bits); i++) bits[i] = ~bits[i];
+    }
+    memcpy(pce->class_bits, bits, sizeof(bits));
+    pce->class_repeat = repeat;
+    pce->fast = pcre_cache_entry::FastClass;
+    return;
+  }
+
+  if (coptions & PCRE_CASELESS) return;
+  std::string literal;
+  for (const char *p = pattern; *p; p++) {
+    switch (*p) {
+    case '^': case '$': case '.': case '[': case ']': case '|':
+    case '(': case ')': case '?': case '*': case '+': case '{': case '}':
+      return;
+    case '\\':
+      {
+        // only escaped punctuation; \n and friends may mean more in PCRE
+        if (isalnum((unsigned char)p[1]) || p[1] == 0) return;
+        literal += *++p;
+      }
+      break;
+    default:
+      literal += *p;
+      break;
+    }
+  }
+  pce->literal = literal;
+  pce->fast = pcre_cache_entry::FastLiteral;
+}
+
+// how many matches took each path, in the server stats
+static const int s_fastLiteralKey =
+  ServerStats::RegisterKey("preg.fast_literal");
+static const int s_fastClassKey = ServerStats::RegisterKey("preg.fast_class");
+static const int s_pcreKey = ServerStats::RegisterKey("preg.pcre");
+
+/*
+ * pcre_exec() on a cached pattern. Patterns classify_pattern() recognized
+ * are matched here instead; they have no subpatterns, so only the
+ * whole-match offsets are filled in.
+ */
+static int preg_exec(const pcre_cache_entry *pce, pcre_extra *extra,
+                     const char *subject, int length, int start_offset,
+                     int options, int *offsets, int size_offsets) {
+  if (pce->fast != pcre_cache_entry::FastNone &&
+      start_offset >= 0 && start_offset <= length &&
+      !(options & (PCRE_ANCHORED | PCRE_NOTEMPTY))) {
+    const char *end = subject + length;
+    const char *start = subject + start_offset;
+    const char *match = nullptr;
+    const char *match_end = nullptr;
+    if (pce->fast == pcre_cache_entry::FastLiteral) {
+      ServerStats::Log(s_fastLiteralKey, 1);
+      int len = pce->literal.size();
+      if (end - start >= len) {
+        match = string_memnstr(start, pce->literal.data(), len, end);
+      }
+      if (match) match_end = match + len;
+    } else {
+      ServerStats::Log(s_fastClassKey, 1);
+      const char *p = start;
+      while (p < end && !pce->inClass(*p)) p++;
+      if (p < end) {
+        match = p++;
+        if (pce->class_repeat) {
+          while (p < end && pce->inClass(*p)) p++;
+        }
+        match_end = p;
+      }
+    }
+    if (!match) return PCRE_ERROR_NOMATCH;
+    offsets[0] = match - subject;
+    offsets[1] = match_end - subject;
+    return 1;
+  }
+  ServerStats::Log(s_pcreKey, 1);
+  return pcre_exec(pce->re, extra, subject, length, start_offset, options,
+                   offsets, size_offsets);
+}
+
+static PCREEntryRef pcre_get_compiled_regex_cache(CStrRef regex) {
   /* Try to lookup the cached regex entry, and if successful, just pass
      back the compiled pattern, otherwise go on and compile it. */
-  if (const pcre_cache_entry* pce = lookup_cached_pcre(regex)) {
-    return pce;
+  PCREEntryRef cached = lookup_cached_pcre(regex);
+  if (cached) {
+    return cached;
   }
 
   /* Parse through the leading whitespace, and display a warning if we
@@ -137,7 +526,7 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
   while (isspace((int)*(unsigned char *)p)) p++;
   if (*p == 0) {
     raise_warning("Empty regular expression");
-    return nullptr;
+    return PCREEntryRef();
   }
 
   /* Get the delimiter and display a warning if it is alphanumeric
@@ -145,7 +534,7 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
   char delimiter = *p++;
   if (isalnum((int)*(unsigned char *)&delimiter) || delimiter == '\\') {
     raise_warning("Delimiter must not be alphanumeric or backslash");
-    return nullptr;
+    return PCREEntryRef();
   }
 
   char start_delimiter = delimiter;
@@ -169,7 +558,7 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
     if (*pp == 0) {
       raise_warning("No ending delimiter '%c' found: [%s]", delimiter,
                       regex.data());
-      return nullptr;
+      return PCREEntryRef();
     }
   } else {
     /* We iterate through the pattern, searching for the matching ending
@@ -190,7 +579,7 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
     if (*pp == 0) {
       raise_warning("No ending matching delimiter '%c' found: [%s]",
                       end_delimiter, regex.data());
-      return nullptr;
+      return PCREEntryRef();
     }
   }
 
@@ -231,7 +620,7 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
 
     default:
       raise_warning("Unknown modifier '%c': [%s]", pp[-1], regex.data());
-      return nullptr;
+      return PCREEntryRef();
     }
   }
 
@@ -247,21 +636,32 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
   pcre *re = pcre_compile(pattern, coptions, &error, &erroffset, 0);
   if (re == nullptr) {
     raise_warning("Compilation failed: %s at offset %d", error, erroffset);
-    return nullptr;
+    return PCREEntryRef();
   }
   // Careful: from here 're' needs to be freed if something throws.
 
   /* If study option was specified, study the pattern and
-     store the result in extra for passing to pcre_exec. */
+     store the result in extra for passing to pcre_exec. Patterns are
+     always studied when they can be JIT compiled. */
   pcre_extra *extra = nullptr;
-  if (do_study) {
-    int soptions = 0;
+  int soptions = 0;
+#ifdef PCRE_STUDY_JIT_COMPILE
+  if (RuntimeOption::PregJit) {
+    soptions |= PCRE_STUDY_JIT_COMPILE;
+  }
+#endif
+  if (do_study || soptions) {
     extra = pcre_study(re, soptions, &error);
     if (extra) {
       extra->flags |= PCRE_EXTRA_MATCH_LIMIT |
         PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+#ifdef PCRE_STUDY_JIT_COMPILE
+      if (soptions & PCRE_STUDY_JIT_COMPILE) {
+        pcre_assign_jit_stack(extra, get_jit_stack, nullptr);
+      }
+#endif
     }
-    if (error != nullptr) {
+    if (error != nullptr && do_study) {
       try {
         raise_warning("Error while studying pattern");
       } catch (...) {
@@ -271,12 +671,24 @@ static const pcre_cache_entry* pcre_get_compiled_regex_cache(CStrRef regex) {
     }
   }
 
+  int num_subpats; // Number of captured subpatterns
+  int rc = pcre_fullinfo(re, extra, PCRE_INFO_CAPTURECOUNT, &num_subpats);
+  if (rc < 0) {
+    pcre_cache_entry freer; // in case raise_warning() throws
+    freer.re = re;
+    freer.extra = extra;
+    raise_warning("Internal pcre_fullinfo() error %d", rc);
+    return PCREEntryRef();
+  }
+
   /* Store the compiled pattern and extra info in the cache. */
   pcre_cache_entry *new_entry = new pcre_cache_entry();
   new_entry->re = re;
   new_entry->extra = extra;
   new_entry->preg_options = poptions;
   new_entry->compile_options = coptions;
+  new_entry->num_subpats = num_subpats + 1;
+  classify_pattern(new_entry, pattern, coptions);
   return insert_cached_pcre(regex, new_entry);
 }
 
@@ -291,33 +703,32 @@ static void set_extra_limits(pcre_extra*& extra) {
   extra->match_limit_recursion = RuntimeOption::PregRecursionLimit;
 }
 
-static int *create_offset_array(const pcre_cache_entry *pce,
-                                int &size_offsets) {
-  pcre_extra *extra = pce->extra;
-  set_extra_limits(extra);
-
-  /* Calculate the size of the offsets array, and allocate memory for it. */
-  int num_subpats; // Number of captured subpatterns
-  int rc = pcre_fullinfo(pce->re, extra, PCRE_INFO_CAPTURECOUNT, &num_subpats);
-  if (rc < 0) {
-    raise_warning("Internal pcre_fullinfo() error %d", rc);
-    return nullptr;
-  }
-  num_subpats++;
-  size_offsets = num_subpats * 3;
-  return (int *)smart_malloc(size_offsets * sizeof(int));
-}
-
-static pcre* pcre_get_compiled_regex(CStrRef regex, pcre_extra **extra,
-                                     int *preg_options) {
-  const pcre_cache_entry* pce = pcre_get_compiled_regex_cache(regex);
-  if (extra) {
-    *extra = pce ? pce->extra : nullptr;
+namespace {
+/*
+ * The offsets array pcre_exec() fills in. Patterns with a handful of
+ * subpatterns, which is nearly all of them, use storage inside the object
+ * so a match never allocates. This can't be one buffer per thread because
+ * preg calls nest through preg_replace_callback().
+ */
+class OffsetArray : private boost::noncopyable {
+public:
+  explicit OffsetArray(const pcre_cache_entry *pce)
+    : m_size(pce->num_subpats * 3) {
+    m_offsets = m_size <= kInlineSize ?
+      m_inline : (int *)smart_malloc(m_size * sizeof(int));
   }
-  if (preg_options) {
-    *preg_options = pce ? pce->preg_options : 0;
+  ~OffsetArray() {
+    if (m_offsets != m_inline) smart_free(m_offsets);
   }
-  return pce ? pce->re : nullptr;
+  int *get() { return m_offsets; }
+  int size() const { return m_size; }
+
+private:
+  static const int kInlineSize = 3 * 16;
+  int m_inline[kInlineSize];
+  int *m_offsets;
+  int m_size;
+};
 }
 
 static inline void add_offset_pair(Variant &result, CStrRef str, int offset,
@@ -376,6 +787,9 @@ static void pcre_handle_exec_error(int pcre_code) {
     preg_code = PHP_PCRE_BACKTRACK_LIMIT_ERROR;
     break;
   case PCRE_ERROR_RECURSIONLIMIT:
+#ifdef PCRE_ERROR_JIT_STACKLIMIT
+  case PCRE_ERROR_JIT_STACKLIMIT:
+#endif
     preg_code = PHP_PCRE_RECURSION_LIMIT_ERROR;
     break;
   case PCRE_ERROR_BADUTF8:
@@ -394,17 +808,14 @@ static void pcre_handle_exec_error(int pcre_code) {
 ///////////////////////////////////////////////////////////////////////////////
 
 Variant preg_grep(CStrRef pattern, CArrRef input, int flags /* = 0 */) {
-  const pcre_cache_entry* pce = pcre_get_compiled_regex_cache(pattern);
-  if (pce == nullptr) {
+  PCREEntryRef pce = pcre_get_compiled_regex_cache(pattern);
+  if (!pce) {
     return false;
   }
 
-  int size_offsets = 0;
-  int *offsets = create_offset_array(pce, size_offsets);
-  if (offsets == nullptr) {
-    return false;
-  }
-  SmartFreeHelper freer(offsets);
+  OffsetArray offsetArray(pce);
+  int *offsets = offsetArray.get();
+  int size_offsets = offsetArray.size();
 
   /* Initialize return array */
   Array ret = Array::Create();
@@ -419,7 +830,7 @@ Variant preg_grep(CStrRef pattern, CArrRef input, int flags /* = 0 */) {
     String entry = iter.second().toString();
 
     /* Perform the match */
-    int count = pcre_exec(pce->re, extra, entry.data(), entry.size(),
+    int count = preg_exec(pce, extra, entry.data(), entry.size(),
                           0, 0, offsets, size_offsets);
 
     /* Check for too many substrings condition. */
@@ -455,8 +866,8 @@ Variant preg_grep(CStrRef pattern, CArrRef input, int flags /* = 0 */) {
 static Variant preg_match_impl(CStrRef pattern, CStrRef subject,
                                Variant *subpats, int flags, int start_offset,
                                bool global) {
-  const pcre_cache_entry* pce = pcre_get_compiled_regex_cache(pattern);
-  if (pce == nullptr) {
+  PCREEntryRef pce = pcre_get_compiled_regex_cache(pattern);
+  if (!pce) {
     return false;
   }
 
@@ -494,13 +905,10 @@ static Variant preg_match_impl(CStrRef pattern, CStrRef subject,
     }
   }
 
-  int size_offsets = 0;
-  int *offsets = create_offset_array(pce, size_offsets);
-  SmartFreeHelper offsetsFreer(offsets);
-  int num_subpats = size_offsets / 3;
-  if (offsets == nullptr) {
-    return false;
-  }
+  OffsetArray offsetArray(pce);
+  int *offsets = offsetArray.get();
+  int size_offsets = offsetArray.size();
+  int num_subpats = pce->num_subpats;
 
   /*
    * Build a mapping from subpattern numbers to their names. We will always
@@ -563,7 +971,7 @@ static Variant preg_match_impl(CStrRef pattern, CStrRef subject,
   int i;
   do {
     /* Execute the regular expression. */
-    int count = pcre_exec(pce->re, extra, subject.data(), subject.size(),
+    int count = preg_exec(pce, extra, subject.data(), subject.size(),
                           start_offset, g_notempty, offsets, size_offsets);
 
     /* Check for too many substrings condition. */
@@ -774,8 +1182,8 @@ static bool preg_get_backref(const char **str, int *backref) {
 static String php_pcre_replace(CStrRef pattern, CStrRef subject,
                                CVarRef replace_var, bool callable,
                                int limit, int *replace_count) {
-  const pcre_cache_entry* pce = pcre_get_compiled_regex_cache(pattern);
-  if (pce == nullptr) {
+  PCREEntryRef pce = pcre_get_compiled_regex_cache(pattern);
+  if (!pce) {
     return false;
   }
   bool eval = false;
@@ -787,12 +1195,9 @@ static String php_pcre_replace(CStrRef pattern, CStrRef subject,
     eval = true;
   }
 
-  int size_offsets;
-  int *offsets = create_offset_array(pce, size_offsets);
-  SmartFreeHelper offsetsFreer(offsets);
-  if (offsets == nullptr) {
-    return false;
-  }
+  OffsetArray offsetArray(pce);
+  int *offsets = offsetArray.get();
+  int size_offsets = offsetArray.size();
 
   const char *replace = nullptr;
   const char *replace_end = nullptr;
@@ -846,7 +1251,7 @@ static String php_pcre_replace(CStrRef pattern, CStrRef subject,
     int g_notempty = 0; // If the match should not be empty
     while (1) {
       /* Execute the regular expression. */
-      int count = pcre_exec(pce->re, extra, subject.data(), subject.size(),
+      int count = preg_exec(pce, extra, subject.data(), subject.size(),
                             start_offset, g_notempty, offsets, size_offsets);
 
       /* Check for too many substrings condition. */
@@ -1123,9 +1528,9 @@ int preg_replace_callback(Variant &result, CVarRef pattern, CVarRef callback,
 
 Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
                    int flags /* = 0 */) {
-  const pcre_cache_entry* pce = pcre_get_compiled_regex_cache(
+  PCREEntryRef pce = pcre_get_compiled_regex_cache(
     pattern.toString());
-  if (pce == nullptr) {
+  if (!pce) {
     return false;
   }
 
@@ -1137,12 +1542,9 @@ Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
     limit = -1;
   }
 
-  int size_offsets = 0;
-  int *offsets = create_offset_array(pce, size_offsets);
-  SmartFreeHelper offsetsFreer(offsets);
-  if (offsets == nullptr) {
-    return false;
-  }
+  OffsetArray offsetArray(pce);
+  int *offsets = offsetArray.get();
+  int size_offsets = offsetArray.size();
 
   String ssubject = subject.toString();
 
@@ -1152,15 +1554,15 @@ Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
   const char *last_match = ssubject.data();
   t_last_error_code = PHP_PCRE_NO_ERROR;
   pcre_extra *extra = pce->extra;
+  set_extra_limits(extra);
 
   // Get next piece if no limit or limit not yet reached and something matched
   Variant return_value = Array::Create();
   int g_notempty = 0;   /* If the match should not be empty */
   int utf8_check = 0;
-  pcre *re_bump = nullptr; /* Regex instance for empty matches */
-  pcre_extra *extra_bump = nullptr; /* Almost dummy */
+  PCREEntryRef pce_bump; /* Regex instance for empty matches */
   while ((limit == -1 || limit > 1)) {
-    int count = pcre_exec(pce->re, extra, ssubject.data(), ssubject.size(),
+    int count = preg_exec(pce, extra, ssubject.data(), ssubject.size(),
                           start_offset, g_notempty | utf8_check,
                           offsets, size_offsets);
 
@@ -1226,14 +1628,13 @@ Variant preg_split(CVarRef pattern, CVarRef subject, int limit /* = -1 */,
          to achieve this, unless we're already at the end of the string. */
       if (g_notempty != 0 && start_offset < ssubject.size()) {
         if (pce->compile_options & PCRE_UTF8) {
-          if (re_bump == nullptr) {
-            int dummy;
-            if ((re_bump = pcre_get_compiled_regex("/./us", &extra_bump,
-                                                   &dummy)) == nullptr) {
+          if (!pce_bump) {
+            pce_bump = pcre_get_compiled_regex_cache("/./us");
+            if (!pce_bump) {
               return false;
             }
           }
-          count = pcre_exec(re_bump, extra_bump, ssubject.data(),
+          count = pcre_exec(pce_bump->re, pce_bump->extra, ssubject.data(),
                             ssubject.size(), start_offset,
                             0, offsets, size_offsets);
           if (count < 1) {
@@ -1359,6 +1760,10 @@ size_t preg_pcre_cache_size() {
   return (size_t)s_pcreCacheMap.size();
 }
 
+size_t preg_pcre_entry_count() {
+  return (size_t)s_pcreEntryCount.load(std::memory_order_relaxed);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // regexec
 
@@ -53,6 +53,7 @@ Variant php_split(CStrRef spliton, CStrRef str, int count, bool icase);
 int preg_last_error();
 
 size_t preg_pcre_cache_size();
+size_t preg_pcre_entry_count(); // includes evicted ones still in use
 
 ///////////////////////////////////////////////////////////////////////////////
 }
@@ -30,6 +30,8 @@
 #include <runtime/base/server/xbox_server.h>
 #include <runtime/base/server/http_server.h>
 #include <runtime/base/server/replay_transport.h>
+#include <runtime/base/server/raw_http_transport.h>
+#include <runtime/base/server/replay_benchmark.h>
 #include <runtime/base/server/http_request_handler.h>
 #include <runtime/base/server/admin_request_handler.h>
 #include <runtime/base/server/server_stats.h>
@@ -40,6 +42,7 @@
 #include <util/timer.h>
 #include <util/stack_trace.h>
 #include <util/light_process.h>
+#include <util/ssl_session_cache.h>
 #include <runtime/base/stat_cache.h>
 #include <runtime/base/source_info.h>
 #include <runtime/base/rtti_info.h>
@@ -105,6 +108,8 @@ struct ProgramOptions {
   string     lint;
   bool       isTempFile;
   int        count;
+  int        threads;
+  double     speed;
   bool       noSafeAccessCheck;
   StringVec  args;
   string     buildId;
@@ -611,6 +616,16 @@ static int start_server(const std::string &username) {
         ServerNameIndication::load(sslCTX, config,
                                    RuntimeOption::SSLCertificateDir);
       }
+      if (sslCTX && !RuntimeOption::SSLSessionCacheFile.empty() &&
+          RuntimeOption::SSLSessionCacheSize > 0) {
+        if (!SSLSessionCache::Enable((SSL_CTX*)sslCTX,
+                                     RuntimeOption::SSLSessionCacheFile,
+                                     RuntimeOption::SSLSessionCacheSize,
+                                     RuntimeOption::SSLSessionTimeout)) {
+          Logger::Error("Unable to use SSL session cache file %s",
+                        RuntimeOption::SSLSessionCacheFile.c_str());
+        }
+      }
     } else {
       Logger::Error("Invalid certificate file or key file");
     }
@@ -770,7 +785,8 @@ static void close_server_log_file(int kind) {
  * to commandline options prior to config load
  */
 static void set_execution_mode(string mode) {
-  if (mode == "daemon" || mode == "server" || mode == "replay") {
+  if (mode == "daemon" || mode == "server" || mode == "replay" ||
+      mode == "bench") {
     RuntimeOption::ExecutionMode = "srv";
   } else if (mode == "run" || mode == "debug") {
     RuntimeOption::ExecutionMode = "cli";
@@ -798,7 +814,7 @@ static int execute_program_impl(int argc, char **argv) {
     ("repo-schema", "display the repo schema id used by this app")
     ("taint-status", "check if the compiler was built with taint enabled")
     ("mode,m", value<string>(&po.mode)->default_value("run"),
-     "run | debug (d) | server (s) | daemon | replay | translate (t)")
+     "run | debug (d) | server (s) | daemon | replay | bench | translate (t)")
     ("config,c", value<string>(&po.config),
      "load specified config file")
     ("config-value,v", value<StringVec >(&po.confStrings)->composing(),
@@ -837,6 +853,11 @@ static int execute_program_impl(int argc, char **argv) {
      "file specified is temporary and removed after execution")
     ("count", value<int>(&po.count)->default_value(1),
      "how many times to repeat execution")
+    ("threads", value<int>(&po.threads)->default_value(1),
+     "how many threads to replay requests on in bench mode")
+    ("speed", value<double>(&po.speed)->default_value(0),
+     "bench mode replays requests as recorded, this many times faster, "
+     "or as fast as it can with 0")
     ("no-safe-access-check",
       value<bool>(&po.noSafeAccessCheck)->default_value(false),
      "whether to ignore safe file access check")
@@ -1123,6 +1144,14 @@ static int execute_program_impl(int argc, char **argv) {
     HttpRequestHandler handler;
     for (int i = 0; i < po.count; i++) {
       for (unsigned int j = 0; j < po.args.size(); j++) {
+        // a captured HTTP request is replayed as is, anything else is
+        // taken to be an hdf file written by RecordInput
+        RawHttpTransport raw;
+        if (raw.readFile(po.args[j].c_str())) {
+          handler.handleRequest(&raw);
+          printf("%s\n", raw.getResponse().c_str());
+          continue;
+        }
         ReplayTransport rt;
         rt.replayInput(po.args[j].c_str());
         handler.handleRequest(&rt);
@@ -1132,6 +1161,20 @@ static int execute_program_impl(int argc, char **argv) {
     return 0;
   }
 
+  if (po.mode == "bench" && !po.args.empty()) {
+    RuntimeOption::RecordInput = false;
+    RuntimeOption::RecordStreamFile.clear();
+    RuntimeOption::ExecutionMode = "srv";
+    HttpServer server; // so we initialize runtime properly
+    ReplayBenchmark bench;
+    for (unsigned int i = 0; i < po.args.size(); i++) {
+      if (!bench.load(po.args[i].c_str())) return -1;
+    }
+    bench.run(std::max(po.threads, 1), std::max(po.count, 1), po.speed);
+    printf("%s", bench.report().c_str());
+    return 0;
+  }
+
   if (po.mode == "translate" && !po.args.empty()) {
     if (!access(po.args[0].c_str(), F_OK)) {
       translate_rtti(po.args[0].c_str());
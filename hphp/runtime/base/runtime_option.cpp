@@ -83,6 +83,9 @@ int64 RuntimeOption::StringOffsetLimit = 10 * 1024 * 1024; // 10MB
 
 std::string RuntimeOption::AccessLogDefaultFormat;
 std::vector<AccessLogFileData> RuntimeOption::AccessLogs;
+bool RuntimeOption::AsyncAccessLog = false;
+int RuntimeOption::AccessLogRingSize = 4096;
+int RuntimeOption::AccessLogFlushInterval = 10;
 
 std::string RuntimeOption::AdminLogFormat;
 std::string RuntimeOption::AdminLogFile;
@@ -103,6 +106,10 @@ bool RuntimeOption::ServerThreadRoundRobin = false;
 int RuntimeOption::ServerThreadDropCacheTimeoutSeconds = 0;
 bool RuntimeOption::ServerThreadJobLIFO = false;
 bool RuntimeOption::ServerThreadDropStack = false;
+int RuntimeOption::ServerQueueTargetMilliSeconds = 0;
+int RuntimeOption::ServerQueueIntervalMilliSeconds = 100;
+int RuntimeOption::ServerQueueDeadlineMilliSeconds = 0;
+std::set<std::string> RuntimeOption::ServerHighPriorityEndPoints;
 bool RuntimeOption::ServerHttpSafeMode = false;
 bool RuntimeOption::ServerStatCache = true;
 std::vector<std::string> RuntimeOption::ServerWarmupRequests;
@@ -124,6 +131,9 @@ int RuntimeOption::ServerDanglingWait;
 int RuntimeOption::ServerShutdownListenWait = 0;
 int RuntimeOption::ServerShutdownListenNoWork = -1;
 int RuntimeOption::GzipCompressionLevel = 3;
+bool RuntimeOption::AdaptiveCompressionLevel = false;
+int RuntimeOption::GzipMaxCompressionLevel = 6;
+bool RuntimeOption::EnableLZ4Compression = false;
 std::string RuntimeOption::ForceCompressionURL;
 std::string RuntimeOption::ForceCompressionCookie;
 std::string RuntimeOption::ForceCompressionParam;
@@ -163,6 +173,9 @@ int RuntimeOption::SSLPortFd = -1;
 std::string RuntimeOption::SSLCertificateFile;
 std::string RuntimeOption::SSLCertificateKeyFile;
 std::string RuntimeOption::SSLCertificateDir;
+std::string RuntimeOption::SSLSessionCacheFile;
+int RuntimeOption::SSLSessionCacheSize = 16384;
+int RuntimeOption::SSLSessionTimeout = 300;
 
 VirtualHostPtrVec RuntimeOption::VirtualHosts;
 IpBlockMapPtr RuntimeOption::IpBlocks;
@@ -180,6 +193,7 @@ std::string RuntimeOption::XboxServerInfoReqInitFunc;
 std::string RuntimeOption::XboxServerInfoReqInitDoc;
 bool RuntimeOption::XboxServerInfoAlwaysReset = false;
 bool RuntimeOption::XboxServerLogInfo = false;
+bool RuntimeOption::XboxSharedResults = false;
 std::string RuntimeOption::XboxProcessMessageFunc = "xbox_process_message";
 std::string RuntimeOption::XboxPassword;
 std::set<std::string> RuntimeOption::XboxPasswords;
@@ -197,6 +211,8 @@ bool RuntimeOption::EnableStaticContentCache = true;
 bool RuntimeOption::EnableStaticContentFromDisk = true;
 bool RuntimeOption::EnableOnDemandUncompress = true;
 bool RuntimeOption::EnableStaticContentMMap = true;
+bool RuntimeOption::EnableStaticContentSourceMMap = false;
+int RuntimeOption::StaticContentMMapMinSize = 1 << 20;
 
 std::string RuntimeOption::RTTIDirectory;
 bool RuntimeOption::EnableCliRTTI = false;
@@ -259,6 +275,7 @@ bool RuntimeOption::ServerErrorMessage = false;
 bool RuntimeOption::TranslateSource = false;
 bool RuntimeOption::RecordInput = false;
 bool RuntimeOption::ClearInputOnSuccess = true;
+std::string RuntimeOption::RecordStreamFile;
 std::string RuntimeOption::ProfilerOutputDir;
 std::string RuntimeOption::CoreDumpEmail;
 bool RuntimeOption::CoreDumpReport = true;
@@ -281,11 +298,13 @@ bool RuntimeOption::EnableMemcacheStats = false;
 bool RuntimeOption::EnableMemcacheKeyStats = false;
 bool RuntimeOption::EnableSQLStats = false;
 bool RuntimeOption::EnableSQLTableStats = false;
+bool RuntimeOption::EnableLatencyStats = false;
 bool RuntimeOption::EnableNetworkIOStatus = false;
 std::string RuntimeOption::StatsXSL;
 std::string RuntimeOption::StatsXSLProxy;
 int RuntimeOption::StatsSlotDuration = 10 * 60; // 10 minutes
 int RuntimeOption::StatsMaxSlot = 12 * 6; // 12 hours
+int RuntimeOption::StatsLatencyMaxURLs = 1000;
 
 bool RuntimeOption::EnableAPCSizeStats = false;
 bool RuntimeOption::EnableAPCSizeGroup = false;
@@ -429,6 +448,7 @@ std::map<std::string, std::string> RuntimeOption::SandboxServerVariables;
 bool RuntimeOption::SandboxFromCommonRoot;
 std::string RuntimeOption::SandboxDirectoriesRoot;
 std::string RuntimeOption::SandboxLogsRoot;
+bool RuntimeOption::SandboxShareUnits = false;
 
 bool RuntimeOption::EnableDebugger = false;
 bool RuntimeOption::EnableDebuggerServer = false;
@@ -447,6 +467,8 @@ std::string RuntimeOption::MailForceExtraParameters;
 int RuntimeOption::PregBacktraceLimit = 100000;
 int RuntimeOption::PregRecursionLimit = 100000;
 bool RuntimeOption::EnablePregErrorLog = true;
+int RuntimeOption::PregCacheSize = 4096;
+bool RuntimeOption::PregJit = true;
 
 bool RuntimeOption::EnableHotProfiler = true;
 int RuntimeOption::ProfilerTraceBuffer = 2000000;
@@ -615,6 +637,10 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
                                       getString(AccessLogDefaultFormat)));
       }
     }
+    AsyncAccessLog = logger["AsyncAccessLog"].getBool(false);
+    AccessLogRingSize = logger["AccessLogRingSize"].getInt32(4096);
+    if (AccessLogRingSize < 2) AccessLogRingSize = 2;
+    AccessLogFlushInterval = logger["AccessLogFlushInterval"].getInt32(10);
 
     AdminLogFormat = logger["AdminLog.Format"].getString("%h %t %s %U");
     AdminLogFile = logger["AdminLog.File"].getString();
@@ -675,6 +701,13 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
       server["ThreadDropCacheTimeoutSeconds"].getInt32(0);
     ServerThreadJobLIFO = server["ThreadJobLIFO"].getBool();
     ServerThreadDropStack = server["ThreadDropStack"].getBool();
+    ServerQueueTargetMilliSeconds =
+      server["QueueTargetMilliSeconds"].getInt32(0);
+    ServerQueueIntervalMilliSeconds =
+      server["QueueIntervalMilliSeconds"].getInt32(100);
+    ServerQueueDeadlineMilliSeconds =
+      server["QueueDeadlineMilliSeconds"].getInt32(0);
+    server["HighPriorityEndPoints"].get(ServerHighPriorityEndPoints);
     ServerHttpSafeMode = server["HttpSafeMode"].getBool();
     ServerStatCache = server["StatCache"].getBool(true);
     server["WarmupRequests"].get(ServerWarmupRequests);
@@ -696,6 +729,15 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
       ServerGracefulShutdownWait = ServerDanglingWait;
     }
     GzipCompressionLevel = server["GzipCompressionLevel"].getInt16(3);
+    AdaptiveCompressionLevel =
+      server["AdaptiveCompressionLevel"].getBool(false);
+    GzipMaxCompressionLevel = server["GzipMaxCompressionLevel"].getInt16(6);
+    if (GzipMaxCompressionLevel > 9) {
+      GzipMaxCompressionLevel = 9;
+    } else if (GzipMaxCompressionLevel < GzipCompressionLevel) {
+      GzipMaxCompressionLevel = GzipCompressionLevel;
+    }
+    EnableLZ4Compression = server["EnableLZ4Compression"].getBool(false);
 
     ForceCompressionURL    = server["ForceCompression"]["URL"].getString();
     ForceCompressionCookie = server["ForceCompression"]["Cookie"].getString();
@@ -730,6 +772,9 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     SSLCertificateFile = server["SSLCertificateFile"].getString();
     SSLCertificateKeyFile = server["SSLCertificateKeyFile"].getString();
     SSLCertificateDir = server["SSLCertificateDir"].getString();
+    SSLSessionCacheFile = server["SSLSessionCacheFile"].getString();
+    SSLSessionCacheSize = server["SSLSessionCacheSize"].getInt32(16384);
+    SSLSessionTimeout = server["SSLSessionTimeout"].getInt32(300);
 
     string srcRoot = Util::normalizeDir(server["SourceRoot"].getString());
     if (!srcRoot.empty()) SourceRoot = srcRoot;
@@ -761,6 +806,10 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     if (EnableStaticContentMMap) {
       EnableOnDemandUncompress = true;
     }
+    EnableStaticContentSourceMMap =
+      server["EnableStaticContentSourceMMap"].getBool(false);
+    StaticContentMMapMinSize =
+      server["StaticContentMMapMinSize"].getInt32(1 << 20);
     RTTIDirectory =
       Util::normalizeDir(server["RTTIDirectory"].getString("/tmp/"));
     EnableCliRTTI = server["EnableCliRTTI"].getBool();
@@ -949,6 +998,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     XboxServerInfoReqInitDoc = xbox["ServerInfo.RequestInitDocument"].get("");
     XboxServerInfoAlwaysReset = xbox["ServerInfo.AlwaysReset"].getBool(false);
     XboxServerLogInfo = xbox["ServerInfo.LogInfo"].getBool(false);
+    XboxSharedResults = xbox["SharedResults"].getBool(false);
     XboxProcessMessageFunc =
       xbox["ProcessMessageFunc"].get("xbox_process_message");
   }
@@ -1023,6 +1073,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     TranslateSource = debug["TranslateSource"].getBool();
     RecordInput = debug["RecordInput"].getBool();
     ClearInputOnSuccess = debug["ClearInputOnSuccess"].getBool(true);
+    RecordStreamFile = debug["RecordStreamFile"].getString();
     ProfilerOutputDir = debug["ProfilerOutputDir"].getString("/tmp");
     CoreDumpEmail = debug["CoreDumpEmail"].getString();
     CoreDumpReport = debug["CoreDumpReport"].getBool(true);
@@ -1055,6 +1106,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     EnableMemcacheKeyStats = stats["MemcacheKey"].getBool();
     EnableSQLStats = stats["SQL"].getBool();
     EnableSQLTableStats = stats["SQLTable"].getBool();
+    EnableLatencyStats = stats["Latency"].getBool();
     EnableNetworkIOStatus = stats["NetworkIO"].getBool();
 
     if (EnableStats && EnableMallocStats) {
@@ -1066,6 +1118,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
 
     StatsSlotDuration = stats["SlotDuration"].getInt32(10 * 60); // 10 minutes
     StatsMaxSlot = stats["MaxSlot"].getInt32(12 * 6); // 12 hours
+    StatsLatencyMaxURLs = stats["LatencyMaxURLs"].getInt32(1000);
 
     {
       Hdf apcSize = stats["APCSize"];
@@ -1251,6 +1304,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     SandboxFromCommonRoot = sandbox["FromCommonRoot"].getBool();
     SandboxDirectoriesRoot = sandbox["DirectoriesRoot"].getString();
     SandboxLogsRoot = sandbox["LogsRoot"].getString();
+    SandboxShareUnits = sandbox["ShareUnits"].getBool(false);
     sandbox["ServerVariables"].get(SandboxServerVariables);
   }
   {
@@ -1263,6 +1317,8 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     PregBacktraceLimit = preg["BacktraceLimit"].getInt32(100000);
     PregRecursionLimit = preg["RecursionLimit"].getInt32(100000);
     EnablePregErrorLog = preg["ErrorLog"].getBool(true);
+    PregCacheSize = preg["CacheSize"].getInt32(4096);
+    PregJit = preg["Jit"].getBool(true);
   }
 
   Extension::LoadModules(config);
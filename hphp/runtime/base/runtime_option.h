@@ -81,6 +81,9 @@ public:
 
   static std::string AccessLogDefaultFormat;
   static std::vector<AccessLogFileData> AccessLogs;
+  static bool AsyncAccessLog;
+  static int AccessLogRingSize;
+  static int AccessLogFlushInterval;
 
   static std::string AdminLogFormat;
   static std::string AdminLogFile;
@@ -100,6 +103,10 @@ public:
   static int ServerThreadDropCacheTimeoutSeconds;
   static bool ServerThreadJobLIFO;
   static bool ServerThreadDropStack;
+  static int ServerQueueTargetMilliSeconds;
+  static int ServerQueueIntervalMilliSeconds;
+  static int ServerQueueDeadlineMilliSeconds;
+  static std::set<std::string> ServerHighPriorityEndPoints;
   static bool ServerHttpSafeMode;
   static bool ServerStatCache;
   static std::vector<std::string> ServerWarmupRequests;
@@ -122,6 +129,9 @@ public:
   static int ServerShutdownListenWait;
   static int ServerShutdownListenNoWork;
   static int GzipCompressionLevel;
+  static bool AdaptiveCompressionLevel;
+  static int GzipMaxCompressionLevel;
+  static bool EnableLZ4Compression;
   static std::string ForceCompressionURL;
   static std::string ForceCompressionCookie;
   static std::string ForceCompressionParam;
@@ -166,6 +176,9 @@ public:
   static std::string SSLCertificateFile;
   static std::string SSLCertificateKeyFile;
   static std::string SSLCertificateDir;
+  static std::string SSLSessionCacheFile;
+  static int SSLSessionCacheSize;
+  static int SSLSessionTimeout;
 
   static int XboxServerThreadCount;
   static int XboxServerMaxQueueLength;
@@ -179,6 +192,7 @@ public:
   static std::string XboxServerInfoReqInitDoc;
   static bool XboxServerInfoAlwaysReset;
   static bool XboxServerLogInfo;
+  static bool XboxSharedResults;
   static std::string XboxProcessMessageFunc;
   static std::string XboxPassword;
   static std::set<std::string> XboxPasswords;
@@ -196,6 +210,8 @@ public:
   static bool EnableStaticContentFromDisk;
   static bool EnableOnDemandUncompress;
   static bool EnableStaticContentMMap;
+  static bool EnableStaticContentSourceMMap;
+  static int StaticContentMMapMinSize;
 
   static std::string RTTIDirectory;
   static bool EnableCliRTTI;
@@ -258,6 +274,7 @@ public:
   static bool TranslateSource;
   static bool RecordInput;
   static bool ClearInputOnSuccess;
+  static std::string RecordStreamFile;
   static std::string ProfilerOutputDir;
   static std::string CoreDumpEmail;
   static bool CoreDumpReport;
@@ -275,11 +292,13 @@ public:
   static bool EnableMemcacheKeyStats;
   static bool EnableSQLStats;
   static bool EnableSQLTableStats;
+  static bool EnableLatencyStats;
   static bool EnableNetworkIOStatus;
   static std::string StatsXSL;
   static std::string StatsXSLProxy;
   static int StatsSlotDuration;
   static int StatsMaxSlot;
+  static int StatsLatencyMaxURLs;
 
   static bool EnableAPCSizeStats;
   static bool EnableAPCSizeGroup;
@@ -476,6 +495,7 @@ public:
   static bool SandboxFromCommonRoot;
   static std::string SandboxDirectoriesRoot;
   static std::string SandboxLogsRoot;
+  static bool SandboxShareUnits;
 
   // Debugger options
   static bool EnableDebugger;
@@ -497,6 +517,8 @@ public:
   static int PregBacktraceLimit;
   static int PregRecursionLimit;
   static bool EnablePregErrorLog;
+  static int PregCacheSize;
+  static bool PregJit;
 
   // Convenience switch to turn on/off code alternatives via command-line
   // Do not commit code guarded by this flag, for evaluation only.
@@ -26,14 +26,15 @@
 #include <util/compatibility.h>
 #include <util/util.h>
 #include <runtime/base/hardware_counter.h>
-
-using std::endl;
+#include <sys/uio.h>
+#include <algorithm>
 
 namespace HPHP {
 
 ///////////////////////////////////////////////////////////////////////////////
 
 AccessLog::~AccessLog() {
+  stop();
   signal(SIGCHLD, SIG_DFL);
   for (uint i = 0; i < m_output.size(); ++i) {
     if (m_output[i].log) {
@@ -73,9 +74,13 @@ void AccessLog::init(const string &format,
 
 void AccessLog::openFiles(const string &username) {
   assert(m_output.empty() && m_cronOutput.empty());
+  CompileFormat(m_defaultFormat.c_str(), m_defaultFields);
   if (m_files.empty()) return;
   for (vector<AccessLogFileData>::const_iterator it = m_files.begin();
        it != m_files.end(); ++it) {
+    m_fields.push_back(LogFormat());
+    CompileFormat(it->format.c_str(), m_fields.back());
+
     const string &file = it->file;
     const string &symLink = it->symLink;
     assert(!file.empty());
@@ -104,6 +109,24 @@ void AccessLog::openFiles(const string &username) {
       m_output.emplace_back(fp);
     }
   }
+  if (RuntimeOption::AsyncAccessLog) {
+    m_async = true;
+    m_writer.setNoInit();
+    m_writer.start();
+  }
+}
+
+void AccessLog::stop() {
+  if (!m_async) return;
+  {
+    // wait for threads in the middle of pushing a line; any thread after
+    // this sees m_stopped and writes directly
+    WriteLock lock(m_closeLock);
+    if (m_stopped.exchange(true)) return;
+  }
+  m_writer.waitForEnd();
+  // nothing can be pushed any more, so this drains every ring for good
+  flushRings();
 }
 
 void AccessLog::log(Transport *transport, const VirtualHost *vhost) {
@@ -114,163 +137,295 @@ void AccessLog::log(Transport *transport, const VirtualHost *vhost) {
   FILE *threadLog = threadData->log;
   if (threadLog) {
     threadData->bytesWritten +=
-      writeLog(transport, vhost, threadLog, m_defaultFormat.c_str());
+      writeLog(transport, vhost, threadLog, m_defaultFields);
     threadData->prevBytesWritten =
       Logger::checkDropCache(threadData->bytesWritten,
                              threadData->prevBytesWritten,
                              threadLog);
   }
-  if (Logger::UseCronolog) {
-    for (uint i = 0; i < m_cronOutput.size(); ++i) {
-      Cronolog &cronOutput = *m_cronOutput[i];
-      FILE *outFile = cronOutput.getOutputFile();
-      if (!outFile) continue;
-      const char *format = m_files[i].format.c_str();
-      int bytes = writeLog(transport, vhost, outFile, format);
-      cronOutput.m_bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
-      cronOutput.m_prevBytesWritten = Logger::checkDropCache(
-        cronOutput.m_bytesWritten.load(std::memory_order_relaxed),
-        cronOutput.m_prevBytesWritten,
-        outFile);
+  if (m_async) {
+    // held across the push so stop() cannot drain the rings in between;
+    // once the log is stopped, late lines are written directly
+    ReadLock lock(m_closeLock);
+    if (!m_stopped.load(std::memory_order_acquire)) {
+      logAsync(transport, vhost, threadData);
+      return;
     }
+  }
+  for (uint i = 0; i < m_fields.size(); ++i) {
+    FILE *outFile = getOutputFile(i);
+    if (!outFile) continue;
+    onWritten(i, outFile, writeLog(transport, vhost, outFile, m_fields[i]));
+  }
+}
+
+FILE *AccessLog::getOutputFile(int i) {
+  if (Logger::UseCronolog) {
+    return m_cronOutput[i]->getOutputFile();
+  }
+  return m_output[i].log;
+}
+
+void AccessLog::onWritten(int i, FILE *outFile, int bytes) {
+  if (Logger::UseCronolog) {
+    Cronolog &cronOutput = *m_cronOutput[i];
+    cronOutput.m_bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+    cronOutput.m_prevBytesWritten = Logger::checkDropCache(
+      cronOutput.m_bytesWritten.load(std::memory_order_relaxed),
+      cronOutput.m_prevBytesWritten,
+      outFile);
   } else {
-    for (uint i = 0; i < m_output.size(); ++i) {
-      LogFileData& output = m_output[i];
-      FILE *outFile = output.log;
-      if (!outFile) continue;
-      const char *format = m_files[i].format.c_str();
-      int bytes = writeLog(transport, vhost, outFile, format);
-      output.bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
-      if (m_files[i].file[0] != '|') {
-        output.prevBytesWritten =
-          Logger::checkDropCache(output.bytesWritten,
-                                 output.prevBytesWritten,
-                                 outFile);
-      }
+    LogFileData& output = m_output[i];
+    output.bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+    if (m_files[i].file[0] != '|') {
+      output.prevBytesWritten =
+        Logger::checkDropCache(output.bytesWritten,
+                               output.prevBytesWritten,
+                               outFile);
     }
   }
 }
 
 int AccessLog::writeLog(Transport *transport, const VirtualHost *vhost,
-                        FILE *outFile, const char *format) {
-   char c;
-   std::ostringstream out;
-   while ((c = *format++)) {
-     if (c != '%') {
-       out << c;
-       continue;
-     }
-
-     if (parseConditions(format, transport->getResponseCode())) {
-       string arg = parseArgument(format);
-       if (!genField(out, format, transport, vhost, arg)) {
-         out << "-";
-       }
-     } else {
-       skipField(format);
-       out << "-";
-     }
-   }
-   out << endl;
-   string output = out.str();
-   int nbytes = fprintf(outFile, "%s", output.c_str());
-   fflush(outFile);
-   return nbytes;
+                        FILE *outFile, const LogFormat &format) {
+  string line;
+  formatLine(line, format, transport, vhost);
+  int nbytes = fwrite(line.data(), 1, line.size(), outFile);
+  fflush(outFile);
+  return nbytes;
 }
 
-bool AccessLog::parseConditions(const char* &format, int code) {
-  bool wantMatch = true;
-  if (*format == '!') {
-    wantMatch = false;
-    format++;
-  } else if (!isdigit(*format)) {
-    // No conditions
-    return true;
+///////////////////////////////////////////////////////////////////////////////
+// asynchronous logging
+
+void AccessLog::logAsync(Transport *transport, const VirtualHost *vhost,
+                         ThreadData *threadData) {
+  if (!threadData->ring) {
+    threadData->ring =
+      LogRingPtr(new LogRing(RuntimeOption::AccessLogRingSize));
+    Lock lock(m_ringLock);
+    m_rings.push_back(threadData->ring);
+  }
+  LogRing &ring = *threadData->ring;
+  for (uint i = 0; i < m_fields.size(); ++i) {
+    string line;
+    formatLine(line, m_fields[i], transport, vhost);
+    // formatting is done here, so the writer only has to copy bytes out
+    if (!ring.write(i, line)) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+        ServerStats::Log("accesslog.dropped", 1);
+      }
+    }
   }
-  char buf[4];
-  buf[3] = '\0';
-
-  bool matched = false;
-  while(isdigit(*format)) {
-    buf[0] = format[0];
-    buf[1] = format[1];
-    buf[2] = format[2];
-    int c = atoi(buf);
-    if (c == code) {
-      matched = true;
+}
+
+/**
+ * Writes out lines[i..] with as few writev() calls as we can, finishing
+ * whatever a short write leaves behind. Returns the number of bytes written.
+ */
+static int write_lines(int fd, const vector<string*> &lines) {
+  int total = 0;
+  for (size_t i = 0; i < lines.size(); ) {
+    struct iovec iov[64];
+    int n = 0;
+    ssize_t size = 0;
+    while (n < 64 && i + n < lines.size()) {
+      const string &line = *lines[i + n];
+      iov[n].iov_base = (void*)line.data();
+      iov[n].iov_len = line.size();
+      size += line.size();
+      n++;
+    }
+    ssize_t written = writev(fd, iov, n);
+    if (written < 0) {
+      if (errno == EINTR) continue;
       break;
     }
-    format+=4;
+    total += written;
+    for (int j = 0; j < n && written < size; j++) {
+      if (written >= (ssize_t)iov[j].iov_len) {
+        written -= iov[j].iov_len;
+        size -= iov[j].iov_len;
+        continue;
+      }
+      const char *p = (const char *)iov[j].iov_base + written;
+      size_t left = iov[j].iov_len - written;
+      size -= iov[j].iov_len;
+      written = 0;
+      while (left > 0) {
+        ssize_t w = write(fd, p, left);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return total;
+        total += w;
+        p += w;
+        left -= w;
+      }
+    }
+    i += n;
+  }
+  return total;
+}
+
+int AccessLog::flushRings() {
+  vector<LogRingPtr> rings;
+  {
+    Lock lock(m_ringLock);
+    rings = m_rings;
+  }
+
+  vector<vector<LogLine> > pending(m_fields.size());
+  int count = 0;
+  for (uint i = 0; i < rings.size(); i++) {
+    LogRing &ring = *rings[i];
+    // only take what is there now, so one busy thread cannot stall us
+    for (size_t n = ring.sizeGuess(); n > 0; n--) {
+      LogLine *line = ring.frontPtr();
+      if (!line) break;
+      pending[line->file].push_back(LogLine(line->file, line->line));
+      ring.popFront();
+      count++;
+    }
   }
-  while (!(*format == '{' || isalpha(*format))) {
-    format++;
+
+  for (uint i = 0; i < pending.size(); i++) {
+    if (pending[i].empty()) continue;
+    FILE *outFile = getOutputFile(i);
+    if (!outFile) continue;
+    vector<string*> lines;
+    lines.reserve(pending[i].size());
+    for (uint j = 0; j < pending[i].size(); j++) {
+      lines.push_back(&pending[i][j].line);
+    }
+    onWritten(i, outFile, write_lines(fileno(outFile), lines));
   }
-  return wantMatch == matched;
+
+  // rings of threads that have exited are dropped once they are empty
+  Lock lock(m_ringLock);
+  for (uint i = 0; i < m_rings.size(); ) {
+    if (m_rings[i].unique() && m_rings[i]->isEmpty()) {
+      m_rings[i] = m_rings.back();
+      m_rings.pop_back();
+    } else {
+      i++;
+    }
+  }
+  return count;
 }
 
-string AccessLog::parseArgument(const char* &format) {
-  if (*format != '{') return string();
-  format++;
-  const char *start = format;
-  while (*format != '}') { format++; }
-  string res(start, format - start);
-  format++;
-  return res;
+void AccessLog::flushLoop() {
+  while (true) {
+    bool stopped = m_stopped.load(std::memory_order_acquire);
+    if (flushRings() > 0) continue;
+    if (stopped) break;
+    usleep(RuntimeOption::AccessLogFlushInterval * 1000);
+  }
 }
 
-void AccessLog::skipField(const char* &format) {
-  // Skip argument
-  if (*format == '{') {
-    while (*format != '}') { format++; }
-    format++;
+///////////////////////////////////////////////////////////////////////////////
+// formatting
+
+void AccessLog::CompileFormat(const char *format, LogFormat &fields) {
+  fields.clear();
+  fields.push_back(LogField());
+  char c;
+  while ((c = *format++)) {
+    if (c != '%') {
+      fields.back().text += c;
+      continue;
+    }
+
+    if (*format == '%') {
+      fields.back().text += *format++;
+      continue;
+    }
+
+    LogField &field = fields.back();
+    // conditions: "!" and/or a comma separated list of status codes
+    if (*format == '!') {
+      field.negated = true;
+      format++;
+    }
+    while (isdigit(format[0]) && isdigit(format[1]) && isdigit(format[2])) {
+      field.codes.push_back((format[0] - '0') * 100 +
+                            (format[1] - '0') * 10 + (format[2] - '0'));
+      format += 3;
+      if (*format == ',') format++;
+    }
+    while (*format && *format != '{' && !isalpha(*format)) format++;
+    if (*format == '{') {
+      const char *start = ++format;
+      while (*format && *format != '}') format++;
+      field.arg.assign(start, format - start);
+      if (*format) format++;
+    }
+    while (*format && !isalpha(*format)) format++;
+    if (!*format) break;
+    field.type = *format++;
+    fields.push_back(LogField());
+  }
+}
+
+void AccessLog::formatLine(string &out, const LogFormat &format,
+                           Transport *transport, const VirtualHost *vhost) {
+  int code = transport->getResponseCode();
+  for (LogFormat::const_iterator it = format.begin(); it != format.end();
+       ++it) {
+    out += it->text;
+    if (!it->type) continue;
+    bool matched = it->codes.empty() ||
+      (std::find(it->codes.begin(), it->codes.end(), code) !=
+       it->codes.end()) != it->negated;
+    if (!matched || !genField(out, it->type, it->arg, transport, vhost)) {
+      out += '-';
+    }
   }
-  // Find control letter
-  while (!isalpha(*format)) { format++; }
-  // Skip it
-  format++;
+  out += '\n';
 }
 
-static void escape_data(std::ostringstream &out, const char *s, int len)
+static void escape_data(string &out, const char *s, int len)
 {
   static const char digits[] = "0123456789abcdef";
 
   for (int i = 0; i < len; i++) {
     unsigned char uc = *s++;
     switch (uc) {
-      case '"':  out << "\\\""; break;
-      case '\\': out << "\\\\"; break;
-      case '\b': out << "\\b";  break;
-      case '\f': out << "\\f";  break;
-      case '\n': out << "\\n";  break;
-      case '\r': out << "\\r";  break;
-      case '\t': out << "\\t";  break;
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b";  break;
+      case '\f': out += "\\f";  break;
+      case '\n': out += "\\n";  break;
+      case '\r': out += "\\r";  break;
+      case '\t': out += "\\t";  break;
       default:
         if (uc >= ' ' && (uc & 127) == uc) {
-          out << (char)uc;
+          out += (char)uc;
         } else {
-          out << "\\x" << digits[(uc >> 4) & 15] << digits[(uc >> 0) & 15];
+          out += "\\x";
+          out += digits[(uc >> 4) & 15];
+          out += digits[(uc >> 0) & 15];
         }
         break;
     }
   }
 }
 
-bool AccessLog::genField(std::ostringstream &out, const char* &format,
-                         Transport *transport, const VirtualHost *vhost,
-                         const string &arg) {
+static void append_int(string &out, int64 n) {
+  char buf[24];
+  out.append(buf, snprintf(buf, sizeof(buf), "%lld", (long long)n));
+}
+
+bool AccessLog::genField(string &out, char type, const string &arg,
+                         Transport *transport, const VirtualHost *vhost) {
   int responseSize = transport->getResponseSize();
   int code = transport->getResponseCode();
 
-  while (!isalpha(*format)) { format++; }
-  char type = *format;
-  format++;
-
   switch (type) {
   case 'b':
     if (responseSize == 0) return false;
     // Fall through
   case 'B':
-    out << responseSize;
+    append_int(out, responseSize);
     break;
   case 'C':
     if (arg.empty()) {
@@ -285,18 +440,18 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
     {
       struct timespec now;
       gettime(CLOCK_MONOTONIC, &now);
-      out << gettime_diff_us(transport->getWallTime(), now);
+      append_int(out, gettime_diff_us(transport->getWallTime(), now));
     }
     break;
   case 'd':
     {
       struct timespec now;
       gettime(CLOCK_THREAD_CPUTIME_ID, &now);
-      out << gettime_diff_us(transport->getCpuTime(), now);
+      append_int(out, gettime_diff_us(transport->getCpuTime(), now));
     }
     break;
   case 'h':
-    out << transport->getRemoteHost();
+    out += transport->getRemoteHost();
     break;
   case 'i':
     if (arg.empty()) return false;
@@ -306,9 +461,9 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
 
       if (vhost && vhost->hasLogFilter() &&
           strcasecmp(arg.c_str(), "Referer") == 0) {
-        out << vhost->filterUrl(header);
+        out += vhost->filterUrl(header);
       } else {
-        out << header;
+        out += header;
       }
     }
     break;
@@ -317,7 +472,7 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
     {
       String note = ServerNote::Get(arg);
       if (note.isNull()) return false;
-      out << note.c_str();
+      out += note.c_str();
     }
     break;
   case 'r':
@@ -330,28 +485,30 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
       default: break;
       }
       if (!method) return false;
-      out << method << " ";
+      out += method;
+      out += ' ';
 
       const char *url = transport->getUrl();
       if (vhost && vhost->hasLogFilter()) {
-        out << vhost->filterUrl(url);
+        out += vhost->filterUrl(url);
       } else {
-        out << url;
+        out += url;
       }
 
       string httpVersion = transport->getHTTPVersion();
-      out << " HTTP/" << httpVersion;
+      out += " HTTP/";
+      out += httpVersion;
     }
     break;
   case 's':
-    out << code;
+    append_int(out, code);
     break;
   case 'S':
     // %S is not defined in Apache, we grab it here
     {
       const std::string &info (transport->getResponseInfo());
       if (info.empty()) return false;
-      out << info;
+      out += info;
     }
     break;
   case 't':
@@ -368,17 +525,17 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
       time(&rawtime);
       timeinfo = localtime(&rawtime);
       strftime(buf, 256, format, timeinfo);
-      out << buf;
+      out += buf;
     }
     break;
   case 'T':
-    out << TimeStamp::Current() - m_fGetThreadData()->startTime;
+    append_int(out, TimeStamp::Current() - m_fGetThreadData()->startTime);
     break;
   case 'U':
     {
       String b, q;
       RequestURI::splitURL(transport->getUrl(), b, q);
-      out << b;
+      out.append(b.data(), b.size());
     }
     break;
   case 'v':
@@ -386,26 +543,26 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
       string host = transport->getHeader("Host");
       const string &sname = VirtualHost::GetCurrent()->serverName(host);
       if (sname.empty() || RuntimeOption::ForceServerNameToHeader) {
-        out << host;
+        out += host;
       } else {
-        out << sname;
+        out += sname;
       }
     }
     break;
   case 'Y':
     {
       int64 now = HardwareCounter::GetInstructionCount();
-      out << now - transport->getInstructions();
+      append_int(out, now - transport->getInstructions());
     }
     break;
   case 'y':
-    out << ServerStats::Get("page.inst.psp");
+    append_int(out, ServerStats::Get("page.inst.psp"));
     break;
   case 'Z':
-     out << ServerStats::Get("page.wall.psp");
+     append_int(out, ServerStats::Get("page.wall.psp"));
      break;
   case 'z':
-     out << ServerStats::Get("page.cpu.psp");
+     append_int(out, ServerStats::Get("page.cpu.psp"));
      break;
   default:
     return false;
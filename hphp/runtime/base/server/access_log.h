@@ -21,6 +21,10 @@
 #include <util/logger.h>
 #include <util/lock.h>
 #include <util/cronolog.h>
+#include <util/async_func.h>
+#include <folly/ProducerConsumerQueue.h>
+
+class TestUtil;
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -37,7 +41,20 @@ public:
 };
 
 class AccessLog {
+  friend class ::TestUtil;
 public:
+  /**
+   * A formatted line waiting in a ring for the writer thread.
+   */
+  struct LogLine {
+    LogLine() : file(0) {}
+    LogLine(int f, std::string &l) : file(f) { line.swap(l); }
+    int file; // index into files()
+    std::string line;
+  };
+  typedef folly::ProducerConsumerQueue<LogLine> LogRing;
+  typedef boost::shared_ptr<LogRing> LogRingPtr;
+
   class ThreadData {
   public:
     ThreadData() : log(nullptr), bytesWritten(0), prevBytesWritten(0) {}
@@ -45,10 +62,12 @@ public:
     int64 startTime;
     int bytesWritten;
     int prevBytesWritten;
+    LogRingPtr ring; // with AsyncAccessLog, lines this thread has formatted
   };
   typedef ThreadData* (*GetThreadDataFunc)();
   AccessLog(GetThreadDataFunc f) :
-      m_initialized(false), m_fGetThreadData(f) {}
+      m_initialized(false), m_fGetThreadData(f), m_async(false),
+      m_stopped(false), m_dropped(0), m_writer(this, &AccessLog::flushLoop) {}
   ~AccessLog();
   void init(const std::string &defaultFormat,
             std::vector<AccessLogFileData> &files,
@@ -61,15 +80,46 @@ public:
   void onNewRequest();
   std::string &defaultFormat() { return m_defaultFormat; }
   std::vector<AccessLogFileData> &files() { return m_files; }
+
+  /**
+   * Stops the writer thread, if there is one, after it has written out
+   * everything logged so far. Lines logged after this are written directly.
+   */
+  void stop();
+
+  /**
+   * Number of lines thrown away because a thread's ring was full.
+   */
+  int64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+  /**
+   * A format string compiled into fields, each preceded by literal text.
+   * The last field may only have text.
+   */
+  struct LogField {
+    LogField() : type(0), negated(false) {}
+    std::string text;
+    char type;              // the field's letter, as in "%s"
+    std::string arg;        // as in "%{Referer}i"
+    std::vector<int> codes; // as in "%!200,304s"
+    bool negated;
+  };
+  typedef std::vector<LogField> LogFormat;
+  static void CompileFormat(const char *format, LogFormat &fields);
+
 private:
-  bool parseConditions(const char* &format, int code);
-  std::string parseArgument(const char* &format);
-  bool genField(std::ostringstream &out, const char* &format,
-                Transport *transport, const VirtualHost *vhost,
-                const std::string &arg);
-  void skipField(const char* &format);
+  bool genField(std::string &out, char type, const std::string &arg,
+                Transport *transport, const VirtualHost *vhost);
+  void formatLine(std::string &out, const LogFormat &format,
+                  Transport *transport, const VirtualHost *vhost);
   int writeLog(Transport *transport, const VirtualHost *vhost,
-               FILE *outFile, const char *format);
+               FILE *outFile, const LogFormat &format);
+  void logAsync(Transport *transport, const VirtualHost *vhost,
+                ThreadData *threadData);
+  FILE *getOutputFile(int i);
+  void onWritten(int i, FILE *outFile, int bytes);
+  int flushRings();
+  void flushLoop();
 
   std::vector<LogFileData> m_output;
   std::vector<CronologPtr> m_cronOutput;
@@ -77,6 +127,18 @@ private:
   GetThreadDataFunc m_fGetThreadData;
   std::string m_defaultFormat;
   std::vector<AccessLogFileData> m_files;
+  LogFormat m_defaultFields;
+  std::vector<LogFormat> m_fields; // m_files[i]'s compiled format
+
+  // With AsyncAccessLog, each request thread puts its lines in its own
+  // ring, and a single writer thread drains all the rings into the files.
+  bool m_async;
+  std::atomic<bool> m_stopped;
+  ReadWriteMutex m_closeLock; // read to push a line, write to set m_stopped
+  std::atomic<int64> m_dropped;
+  std::vector<LogRingPtr> m_rings;
+  Mutex m_ringLock;
+  AsyncFunc<AccessLog> m_writer;
 
   void openFiles(const std::string &username);
   Mutex m_lock;
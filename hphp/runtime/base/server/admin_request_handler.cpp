@@ -160,6 +160,7 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "/stats-sql:       turn on/off SQL statistics\n"
         "/stats-mutex:     turn on/off mutex statistics\n"
         "    sampling      optional, default 1000\n"
+        "/stats-latency:   turn on/off per-URL latency distributions\n"
 
         "/stats.keys:      list all available keys\n"
         "    from          optional, <timestamp>, or <-n> second ago\n"
@@ -177,6 +178,8 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "    (same as /stats.xml)\n"
         "/stats.html:      show server stats in HTML\n"
         "    (same as /stats.xml)\n"
+        "/stats.latency:   show latency percentiles of each URL in JSON\n"
+        "    url           optional, only this URL\n"
 
         "/apc-ss:          get apc size stats\n"
         "/apc-ss-flat:     get apc size stats in flat format\n"
@@ -686,6 +689,9 @@ bool AdminRequestHandler::handleStatsRequest(const std::string &cmd,
     }
     return toggle_switch(transport, LockProfiler::s_profile);
   }
+  if (cmd == "stats-latency") {
+    return toggle_switch(transport, RuntimeOption::EnableLatencyStats);
+  }
 
   if (cmd == "stats.keys") {
     int64 from = transport->getInt64Param("from");
@@ -707,6 +713,13 @@ bool AdminRequestHandler::handleStatsRequest(const std::string &cmd,
   if (cmd == "stats.html" || cmd == "stats.htm") {
     return send_report(transport, ServerStats::HTML, "text/html");
   }
+  if (cmd == "stats.latency") {
+    string out;
+    ServerStats::ReportLatency(out, transport->getParam("url"));
+    transport->addHeader("Content-Type", "application/json");
+    transport->sendString(out);
+    return true;
+  }
 
   if (cmd == "stats.xsl") {
     string xsl;
@@ -29,6 +29,7 @@
 #include <runtime/base/server/source_root_info.h>
 #include <runtime/base/server/request_uri.h>
 #include <runtime/base/server/http_protocol.h>
+#include <runtime/base/server/replay_benchmark.h>
 #include <runtime/base/time/datetime.h>
 #include <runtime/eval/debugger/debugger.h>
 #include <util/alloc.h>
@@ -46,12 +47,75 @@ HttpRequestHandler::HttpRequestHandler()
   : m_pathTranslation(true) {
 }
 
+/**
+ * Reads the decimal number at p and moves p past it. Values too big for
+ * any body saturate instead of overflowing.
+ */
+static bool parse_range_pos(const char *&p, int64 &n) {
+  if (!isdigit((unsigned char)*p)) return false;
+  n = 0;
+  for (; isdigit((unsigned char)*p); p++) {
+    if (n <= INT_MAX) n = n * 10 + (*p - '0');
+  }
+  return true;
+}
+
+int HttpRequestHandler::ParseRange(const std::string &header, int len,
+                                   int &start, int &end) {
+  if (header.compare(0, 6, "bytes=") != 0 ||
+      header.find(',') != string::npos) {
+    return 0;
+  }
+  const char *p = header.c_str() + 6;
+  int64 first, last;
+  if (*p == '-') {
+    // suffix range: the last n bytes
+    p++;
+    if (!parse_range_pos(p, last) || *p) return 0;
+    if (last == 0 || len == 0) return -1;
+    start = last >= len ? 0 : len - last;
+    end = len - 1;
+    return 1;
+  }
+  if (!parse_range_pos(p, first) || *p++ != '-') return 0;
+  last = len - 1;
+  if (*p) {
+    if (!parse_range_pos(p, last) || *p || last < first) return 0;
+    if (last >= len) last = len - 1;
+  }
+  if (first >= len) return -1;
+  start = first;
+  end = last;
+  return 1;
+}
+
+bool HttpRequestHandler::MatchETag(const std::string &header,
+                                   const std::string &etag) {
+  // the header is "*" or a list of quoted tags, some possibly weak
+  size_t pos = 0;
+  while (pos < header.size()) {
+    size_t next = header.find(',', pos);
+    if (next == string::npos) next = header.size();
+    size_t b = header.find_first_not_of(" \t", pos);
+    size_t e = header.find_last_not_of(" \t", next - 1);
+    if (b != string::npos && b < next) {
+      if (header.compare(b, 2, "W/") == 0) b += 2;
+      std::string tag = header.substr(b, e - b + 1);
+      if (tag == "*" || tag == etag) return true;
+    }
+    pos = next + 1;
+  }
+  return false;
+}
+
 void HttpRequestHandler::sendStaticContent(Transport *transport,
                                            const char *data, int len,
                                            time_t mtime,
                                            bool compressed,
                                            const std::string &cmd,
-                                           const char *ext) {
+                                           const char *ext,
+                                           const std::string &etag
+                                           /* = "" */) {
   assert(ext);
   assert(cmd.rfind('.') != string::npos);
   assert(strcmp(ext, cmd.c_str() + cmd.rfind('.') + 1) == 0);
@@ -104,7 +168,42 @@ void HttpRequestHandler::sendStaticContent(Transport *transport,
   // should not attempt to compress it.
   transport->disableCompression();
 
-  transport->sendRaw((void*)data, len, 200, compressed);
+  if (!etag.empty()) {
+    transport->addHeader("ETag", etag.c_str());
+    if (MatchETag(transport->getHeader("If-None-Match"), etag)) {
+      transport->sendRaw((void*)"", 0, 304);
+      return;
+    }
+  }
+
+  int code = 200;
+  if (!compressed) {
+    int start, end;
+    char buf[64];
+    switch (ParseRange(transport->getHeader("Range"), len, start, end)) {
+    case 1:
+      snprintf(buf, sizeof(buf), "bytes %d-%d/%d", start, end, len);
+      transport->addHeader("Content-Range", buf);
+      data += start;
+      len = end - start + 1;
+      code = 206;
+      break;
+    case -1:
+      snprintf(buf, sizeof(buf), "bytes */%d", len);
+      transport->addHeader("Content-Range", buf);
+      transport->sendRaw((void*)"", 0, 416);
+      return;
+    }
+  }
+
+  if (compressed) {
+    transport->sendRaw((void*)data, len, code, compressed);
+  } else {
+    // static content outlives the send, so it can go out by reference
+    std::vector<StringSlice> segments;
+    segments.push_back(StringSlice(data, len));
+    transport->sendRawSegments(segments, code, true);
+  }
 }
 
 void HttpRequestHandler::handleRequest(Transport *transport) {
@@ -152,8 +251,15 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
   string path = reqURI.path().data();
   string absPath = reqURI.absolutePath().data();
 
-  // determine whether we should compress response
-  bool compressed = transport->decideCompression();
+  // determine whether we should compress response; precompressed content
+  // is kept gzipped, which clients asking for lz4 may take as well
+  int coding = transport->decideCompression();
+  bool compressed = coding == CODING_GZIP ||
+    (coding == CODING_LZ4 && transport->acceptEncoding("gzip"));
+  // byte ranges are taken from the uncompressed content
+  if (compressed && !transport->getHeader("Range").empty()) {
+    compressed = false;
+  }
 
   const char *data; int len;
   const char *ext = reqURI.ext();
@@ -172,8 +278,10 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
   if (ext && strcasecmp(ext, "php") != 0) {
     if (RuntimeOption::EnableStaticContentCache) {
       bool original = compressed;
+      std::string etag;
       // check against static content cache
-      if (StaticContentCache::TheCache.find(path, data, len, compressed)) {
+      if (StaticContentCache::TheCache.find(path, data, len, compressed,
+                                            &etag)) {
         Util::ScopedMem decompressed_data;
         // (qigao) not calling stat at this point because the timestamp of
         // local cache file is not valuable, maybe misleading. This way
@@ -187,8 +295,11 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
           decompressed_data = const_cast<char*>(data);
           compressed = false;
         }
-        sendStaticContent(transport, data, len, 0, compressed, path, ext);
-        StaticContentCache::TheFileCache->adviseOutMemory();
+        sendStaticContent(transport, data, len, 0, compressed, path, ext,
+                          etag);
+        if (StaticContentCache::TheFileCache) {
+          StaticContentCache::TheFileCache->adviseOutMemory();
+        }
         ServerStats::LogPage(path, 200);
         GetAccessLog().log(transport, vhost);
         return;
@@ -198,9 +309,20 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
     if (RuntimeOption::EnableStaticContentFromDisk) {
       String translated = File::TranslatePath(String(absPath));
       if (!translated.empty()) {
+        struct stat st;
+        if (compressed && stat(translated.data(), &st) == 0) {
+          // send the precompressed copy next to the file, if there is one
+          CstrBuffer gz((translated + ".gz").data());
+          if (gz.valid()) {
+            sendStaticContent(transport, gz.data(), gz.size(), st.st_mtime,
+                              true, path, ext);
+            ServerStats::LogPage(path, 200);
+            GetAccessLog().log(transport, vhost);
+            return;
+          }
+        }
         CstrBuffer sb(translated.data());
         if (sb.valid()) {
-          struct stat st;
           st.st_mtime = 0;
           stat(translated.data(), &st);
           sendStaticContent(transport, sb.data(), sb.size(), st.st_mtime,
@@ -245,6 +367,9 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
 
   // record request for debugging purpose
   std::string tmpfile = HttpProtocol::RecordRequest(transport);
+  if (!RuntimeOption::RecordStreamFile.empty()) {
+    ReplayBenchmark::RecordRequest(transport);
+  }
 
   // main body
   hphp_session_init();
@@ -318,14 +443,18 @@ bool HttpRequestHandler::executePHPRequest(Transport *transport,
                     error, errorMsg);
 
   if (ret) {
-    String content = context->obDetachContents();
-    if (cachableDynamicContent && !content.empty()) {
-      assert(transport->getUrl());
-      string key = file + transport->getUrl();
-      DynamicContentCache::TheCache.store(key, content.data(),
-                                          content.size());
+    if (cachableDynamicContent) {
+      String content = context->obDetachContents();
+      if (!content.empty()) {
+        assert(transport->getUrl());
+        string key = file + transport->getUrl();
+        DynamicContentCache::TheCache.store(key, content.data(),
+                                            content.size());
+      }
+      transport->sendRaw((void*)content.data(), content.size());
+    } else {
+      context->obSendContents(transport);
     }
-    transport->sendRaw((void*)content.data(), content.size());
     code = transport->getResponseCode();
   } else if (error) {
     code = 500;
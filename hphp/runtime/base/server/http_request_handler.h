@@ -22,6 +22,8 @@
 #include <runtime/base/server/virtual_host.h>
 #include <runtime/base/server/access_log.h>
 
+class TestUtil;
+
 namespace HPHP {
 
 class SourceRootInfo;
@@ -29,6 +31,7 @@ class RequestURI;
 ///////////////////////////////////////////////////////////////////////////////
 
 class HttpRequestHandler : public RequestHandler {
+  friend class ::TestUtil;
 public:
   static AccessLog &GetAccessLog() { return s_accessLog; }
 
@@ -41,6 +44,20 @@ public:
   // for internal invoke of a special URL
   void disablePathTranslation() { m_pathTranslation = false;}
 
+  /**
+   * Parses a "bytes=start-end" Range header for a body of len bytes. Returns
+   * 1 with [start, end] set for a range we can send, -1 for one that cannot
+   * be satisfied, or 0 to ignore the header and send everything, as we do
+   * for malformed headers and multiple ranges.
+   */
+  static int ParseRange(const std::string &header, int len,
+                        int &start, int &end);
+  /**
+   * Whether an If-None-Match header matches etag. Weak tags match too, as
+   * the weak comparison calls for.
+   */
+  static bool MatchETag(const std::string &header, const std::string &etag);
+
 private:
   bool m_pathTranslation;
 
@@ -48,7 +65,8 @@ private:
   void sendStaticContent(Transport *transport, const char *data, int len,
                          time_t mtime, bool compressed,
                          const std::string &cmd,
-                         const char *ext);
+                         const char *ext,
+                         const std::string &etag = "");
   bool executePHPRequest(Transport *transport, RequestURI &reqURI,
                          SourceRootInfo &sourceRootInfo,
                          bool cachableDynamicContent);
@@ -86,6 +86,7 @@ HttpServer::HttpServer(void *sslCTX /* = NULL */)
     assert(SSLInit::IsInited());
     m_pageServer->enableSSL(m_sslCTX, RuntimeOption::SSLPort);
   }
+  m_pageServer->enableLoadShedding();
 
   m_adminServer = ServerPtr
     (new TypedServer<LibEventServer, AdminRequestHandler>
@@ -295,6 +296,12 @@ void HttpServer::run() {
     m_serviceThreads[i]->waitForEnd();
   }
 
+  // write out what has been logged so far; the admin server and the
+  // satellites, which log to the page server's log, are still running, so
+  // whatever they log after this is written directly
+  HttpRequestHandler::GetAccessLog().stop();
+  AdminRequestHandler::GetAccessLog().stop();
+
   hphp_process_exit();
   m_watchDog.waitForEnd();
   Logger::Info("all servers stopped");
@@ -22,6 +22,11 @@
 #include <runtime/eval/debugger/debugger.h>
 #include <util/compatibility.h>
 #include <util/logger.h>
+#include <sys/uio.h>
+
+#ifdef _EVENT_USE_OPENSSL
+#include <openssl/ssl.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 // static handler
@@ -45,6 +50,13 @@ static void on_thread_stop(int fd, short events, void *context) {
 }
 
 namespace HPHP {
+
+static const int s_shedQueueKey = ServerStats::RegisterKey("page.shed.queue");
+static const int s_shedDeadlineKey =
+  ServerStats::RegisterKey("page.shed.deadline");
+static const int s_sslHandshakeKey = ServerStats::RegisterKey("ssl.handshake");
+static const int s_sslResumedKey = ServerStats::RegisterKey("ssl.resumed");
+
 ///////////////////////////////////////////////////////////////////////////////
 // LibEventJob
 
@@ -86,6 +98,16 @@ void LibEventWorker::doJob(LibEventJobPtr job) {
   evhttp_request *request = job->request;
   assert(m_opaque);
   LibEventServer *server = (LibEventServer*)m_opaque;
+  int64 rejected = server->takeRejectedCount();
+  if (rejected) {
+    ServerStats::Log(s_shedDeadlineKey, rejected);
+  }
+  int64 handshakes, resumed;
+  server->takeSSLCounts(handshakes, resumed);
+  if (handshakes) {
+    ServerStats::Log(s_sslHandshakeKey, handshakes);
+    ServerStats::Log(s_sslResumedKey, resumed);
+  }
 
   if (m_handler == nullptr || server->supportReset()) {
     m_handler = server->createRequestHandler();
@@ -93,6 +115,10 @@ void LibEventWorker::doJob(LibEventJobPtr job) {
   }
 
   LibEventTransport transport(server, request, m_id);
+  if (server->getThreadCount() > 0) {
+    transport.setServerLoad(server->getActiveWorker() * 100 /
+                            server->getThreadCount());
+  }
 #ifdef _EVENT_USE_OPENSSL
   if (evhttp_is_connection_ssl(job->request->evcon)) {
     transport.setSSL();
@@ -132,6 +158,16 @@ void LibEventWorker::doJob(LibEventJobPtr job) {
   }
 }
 
+void LibEventWorker::abortJob(LibEventJobPtr job) {
+  job->stopTimer();
+  assert(m_opaque);
+  LibEventServer *server = (LibEventServer*)m_opaque;
+  LibEventTransport transport(server, job->request, m_id);
+  transport.sendString("Service Unavailable", 503);
+  ServerStats::Log(s_shedQueueKey, 1);
+  ServerStats::LogPage(transport.getCommand(), 503);
+}
+
 void LibEventWorker::onThreadEnter() {
   assert(m_opaque);
   LibEventServer *server = (LibEventServer*)m_opaque;
@@ -161,7 +197,10 @@ LibEventServer::LibEventServer(const std::string &address, int port,
                  RuntimeOption::ServerThreadDropCacheTimeoutSeconds,
                  RuntimeOption::ServerThreadDropStack,
                  this, RuntimeOption::ServerThreadJobLIFO),
-    m_dispatcherThread(this, &LibEventServer::dispatch) {
+    m_dispatcherThread(this, &LibEventServer::dispatch),
+    m_shedding(false), m_queueDeadline(0), m_rejected(0),
+    m_sslCTX(nullptr), m_sslAccepted(0), m_sslHits(0), m_sslHandshakes(0),
+    m_sslResumed(0) {
   m_eventBase = event_base_new();
   m_server = evhttp_new(m_eventBase);
   m_server_ssl = nullptr;
@@ -344,6 +383,7 @@ bool LibEventServer::enableSSL(void *sslCTX, int port) {
     return false;
   }
   m_port_ssl = port;
+  m_sslCTX = sslCTX;
   evhttp_set_connection_limit(m_server_ssl,
                               RuntimeOption::ServerConnectionLimit);
   evhttp_set_gencb(m_server_ssl, on_request, this);
@@ -354,6 +394,22 @@ bool LibEventServer::enableSSL(void *sslCTX, int port) {
 #endif
 }
 
+void LibEventServer::countSSLHandshakes() {
+#ifdef _EVENT_USE_OPENSSL
+  // OpenSSL's counters are only ever bumped on the event loop, which is
+  // also the only reader, so we just pass on what changed since last time
+  SSL_CTX *ctx = (SSL_CTX*)m_sslCTX;
+  int64 accepted = SSL_CTX_sess_accept_good(ctx);
+  int64 hits = SSL_CTX_sess_hits(ctx);
+  if (accepted != m_sslAccepted) {
+    m_sslHandshakes += accepted - m_sslAccepted;
+    m_sslResumed += hits - m_sslHits;
+    m_sslAccepted = accepted;
+    m_sslHits = hits;
+  }
+#endif
+}
+
 int LibEventServer::getAcceptSocketSSL() {
   const char *address = m_address.empty() ? nullptr : m_address.c_str();
   int ret = evhttp_bind_socket_backlog_fd(m_server_ssl, address,
@@ -388,15 +444,92 @@ void LibEventServer::onRequest(struct evhttp_request *request) {
     evhttp_connection_set_timeout(request->evcon,
                                   RuntimeOption::ConnectionTimeoutSeconds);
   }
+  if (m_sslCTX) countSSLHandshakes();
   if (getStatus() == RUNNING) {
-    m_dispatcher.enqueue(LibEventJobPtr(new LibEventJob(request)));
+    if (m_shedding && isHighPriority(request)) {
+      m_dispatcher.enqueuePriority(LibEventJobPtr(new LibEventJob(request)));
+    } else if (m_queueDeadline > 0 &&
+               m_dispatcher.getEstimatedWait() > m_queueDeadline) {
+      // the client would likely give up before a worker got to it
+      evhttp_send_reply(request, 503, "Service Unavailable", nullptr);
+      ++m_rejected;
+    } else {
+      m_dispatcher.enqueue(LibEventJobPtr(new LibEventJob(request)));
+    }
   } else {
     Logger::Error("throwing away one new request while shutting down");
   }
 }
 
+void LibEventServer::enableLoadShedding() {
+  m_dispatcher.setLoadShedding(RuntimeOption::ServerQueueTargetMilliSeconds,
+                               RuntimeOption::ServerQueueIntervalMilliSeconds);
+  m_queueDeadline = RuntimeOption::ServerQueueDeadlineMilliSeconds * 1000LL;
+  m_shedding = true;
+}
+
+bool LibEventServer::isHighPriority(evhttp_request *request) const {
+  const std::set<std::string> &endPoints =
+    RuntimeOption::ServerHighPriorityEndPoints;
+  if (endPoints.empty() || !request->uri) return false;
+  const char *uri = request->uri;
+  const char *query = strchr(uri, '?');
+  std::string path = query ? std::string(uri, query - uri) : uri;
+  return endPoints.find(path) != endPoints.end();
+}
+
+static void copy_body(evhttp_request *request,
+                      const std::vector<StringSlice> &body,
+                      LibEventTransport *transport) {
+  int size = 0;
+  for (unsigned int i = 0; i < body.size(); i++) {
+    size += body[i].len;
+  }
+  evbuffer *buf = request->output_buffer;
+  evbuffer_expand(buf, size);
+  for (unsigned int i = 0; i < body.size(); i++) {
+    evbuffer_add(buf, body[i].ptr, body[i].len);
+  }
+  transport->onCopyProgress(size);
+}
+
+static int send_reply_sync(evhttp_request *request, int code,
+                           const char *reason,
+                           const std::vector<StringSlice> *body,
+                           LibEventTransport *transport) {
+#ifdef EVHTTP_SYNC_SEND_IOV
+  if (body) {
+    // write the body from its own memory, only what the socket doesn't
+    // take right away gets copied for the event loop to finish
+    std::vector<iovec> iov(body->size());
+    int size = 0;
+    for (unsigned int i = 0; i < body->size(); i++) {
+      iov[i].iov_base = (void*)(*body)[i].ptr;
+      iov[i].iov_len = (*body)[i].len;
+      size += (*body)[i].len;
+    }
+    int ncopied = 0;
+    int nwritten = evhttp_send_reply_sync_begin_iov(request, code, reason,
+                                                    iov.data(), iov.size(),
+                                                    &ncopied);
+    transport->onCopyProgress(ncopied);
+    if (nwritten > 0) {
+      transport->onZeroCopyProgress(size - ncopied);
+    }
+    return nwritten;
+  }
+#else
+  if (body) {
+    copy_body(request, *body, transport);
+  }
+#endif
+  return evhttp_send_reply_sync_begin(request, code, reason, nullptr);
+}
+
 void LibEventServer::onResponse(int worker, evhttp_request *request,
-                                int code, LibEventTransport *transport) {
+                                int code, LibEventTransport *transport,
+                                const std::vector<StringSlice> *body
+                                /* = nullptr */) {
   int nwritten = 0;
   bool skip_sync = false;
 
@@ -416,14 +549,20 @@ void LibEventServer::onResponse(int worker, evhttp_request *request,
     timespec begin, end;
     gettime(CLOCK_MONOTONIC, &begin);
 #ifdef EVHTTP_SYNC_SEND_REPORT_TOTAL_LEN
+    if (body) {
+      copy_body(request, *body, transport);
+    }
     nwritten = evhttp_send_reply_sync(request, code, reason, nullptr, &totalSize);
 #else
-    nwritten = evhttp_send_reply_sync_begin(request, code, reason, nullptr);
+    nwritten = send_reply_sync(request, code, reason, body, transport);
 #endif
     gettime(CLOCK_MONOTONIC, &end);
     int64 delay = gettime_diff_us(begin, end);
     transport->onFlushBegin(totalSize);
     transport->onFlushProgress(nwritten, delay);
+  } else if (body) {
+    // the event loop sends this later, after the caller has freed the body
+    copy_body(request, *body, transport);
   }
   m_responseQueue.enqueue(worker, request, code, nwritten);
 }
@@ -17,6 +17,7 @@
 #ifndef __HTTP_SERVER_LIB_EVENT_SERVER_H__
 #define __HTTP_SERVER_LIB_EVENT_SERVER_H__
 
+#include <atomic>
 #include <runtime/base/server/server.h>
 #include <runtime/base/server/libevent_transport.h>
 #include <runtime/base/timeout_thread.h>
@@ -60,6 +61,7 @@ struct LibEventWorker
    * Request handler called by LibEventServer.
    */
   virtual void doJob(LibEventJobPtr job);
+  virtual void abortJob(LibEventJobPtr job);
 
   /**
    * Called when thread enters and exits.
@@ -153,10 +155,13 @@ public:
   void onChunkedRead();
 
   /**
-   * Called by LibEventTransport when a response is fully prepared.
+   * Called by LibEventTransport when a response is fully prepared. A body
+   * passed in here, rather than in the request's output buffer, is owned
+   * by the caller and is only valid for the duration of the call.
    */
   void onResponse(int worker, evhttp_request *request, int code,
-                  LibEventTransport* transport);
+                  LibEventTransport* transport,
+                  const std::vector<StringSlice> *body = nullptr);
   void onChunkedResponse(int worker, evhttp_request *request, int code,
                          evbuffer *chunk, bool firstChunk);
   void onChunkedResponseEnd(int worker, evhttp_request *request);
@@ -168,6 +173,22 @@ public:
    */
   virtual bool enableSSL(void *sslCTX, int port);
 
+  virtual void enableLoadShedding();
+
+  /**
+   * How many requests the event loop turned away since the last call.
+   */
+  int64 takeRejectedCount() { return m_rejected.exchange(0); }
+
+  /**
+   * How many SSL handshakes completed since the last call, and how many of
+   * those resumed an earlier session.
+   */
+  void takeSSLCounts(int64 &handshakes, int64 &resumed) {
+    handshakes = m_sslHandshakes.exchange(0);
+    resumed = m_sslResumed.exchange(0);
+  }
+
   // Whether the server may reset the request handler, e.g., the RPC server.
   virtual bool supportReset() { return false; }
 
@@ -196,6 +217,20 @@ private:
 
   PendingResponseQueue m_responseQueue;
 
+  bool m_shedding;
+  int64 m_queueDeadline;            // in microseconds, 0 for none
+  std::atomic<int64> m_rejected;
+
+  void *m_sslCTX;
+  int64 m_sslAccepted;              // SSL_CTX counters the event loop last saw
+  int64 m_sslHits;
+  std::atomic<int64> m_sslHandshakes;
+  std::atomic<int64> m_sslResumed;
+
+  void countSSLHandshakes();
+
+  bool isHighPriority(evhttp_request *request) const;
+
   // dispatcher thread runs this function
   void dispatch();
 
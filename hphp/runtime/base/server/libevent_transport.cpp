@@ -269,6 +269,7 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
     assert(m_method != HEAD);
     evbuffer *chunk = evbuffer_new();
     evbuffer_add(chunk, data, size);
+    onCopyProgress(size);
     /*
      * Chunked replies are sent async, so there is no way to know the
      * time it took to flush the response, but tracking the bytes sent is
@@ -280,6 +281,7 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
   } else {
     if (m_method != HEAD) {
       evbuffer_add(m_request->output_buffer, data, size);
+      onCopyProgress(size);
     } else if (!evhttp_find_header(m_request->output_headers,
                                    "Content-Length")) {
       char buf[11];
@@ -292,6 +294,27 @@ void LibEventTransport::sendImpl(const void *data, int size, int code,
   m_sendStarted = true;
 }
 
+void LibEventTransport::sendSegmentsImpl(
+  const std::vector<StringSlice> &segments, int size, int code) {
+  assert(!m_sendEnded);
+  assert(!m_sendStarted);
+
+  // the server writes the segments out by reference when it can, so they
+  // are not copied into the request's output buffer here
+  const std::vector<StringSlice> *body = nullptr;
+  if (m_method != HEAD) {
+    body = &segments;
+  } else if (!evhttp_find_header(m_request->output_headers,
+                                 "Content-Length")) {
+    char buf[11];
+    snprintf(buf, sizeof(buf), "%d", size);
+    addHeaderImpl("Content-Length", buf);
+  }
+  m_server->onResponse(m_workerId, m_request, code, this, body);
+  m_sendEnded = true;
+  m_sendStarted = true;
+}
+
 void LibEventTransport::onSendEndImpl() {
   if (m_chunkedEncoding) {
     m_server->onChunkedResponseEnd(m_workerId, m_request);
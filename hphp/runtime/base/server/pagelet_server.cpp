@@ -19,6 +19,7 @@
 #include <runtime/base/server/http_request_handler.h>
 #include <runtime/base/server/upload.h>
 #include <runtime/base/server/job_queue_vm_stack.h>
+#include <runtime/base/server/server_stats.h>
 #include <runtime/base/util/string_buffer.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/resource_data.h>
@@ -38,7 +39,7 @@ public:
   PageletTransport(CStrRef url, CArrRef headers, CStrRef postData,
                    CStrRef remoteHost, const set<string> &rfc1867UploadedFiles,
                    CArrRef files)
-    : m_refCount(0), m_done(false), m_code(0) {
+    : m_refCount(0), m_owner(nullptr), m_done(false), m_code(0) {
 
     gettime(CLOCK_MONOTONIC, &m_queueTime);
     m_threadType = PageletThread;
@@ -211,8 +212,13 @@ public:
   }
 
   timespec getStartTimer() const { return m_queueTime; }
+
+  // the request that started this task, for fair queueing
+  const void *getOwner() const { return m_owner; }
+  void setOwner(const void *owner) { m_owner = owner; }
 private:
   int m_refCount;
+  const void *m_owner;
 
   string m_url;
   HeaderMap m_requestHeaders;
@@ -237,6 +243,10 @@ struct PageletWorker
 {
   virtual void doJob(PageletTransport *job) {
     try {
+      timespec now;
+      gettime(CLOCK_MONOTONIC, &now);
+      ServerStats::LogLatency("queue:pagelet",
+                              gettime_diff_us(job->getStartTimer(), now));
       job->onRequestStart(job->getStartTimer());
       HttpRequestHandler().handleRequest(job);
       job->decRefCount();
@@ -321,8 +331,11 @@ Object PageletServer::TaskStart(CStrRef url, CArrRef headers,
   Object ret(task);
   PageletTransport *job = task->getJob();
   job->incRefCount(); // paired with worker's decRefCount()
+  // tasks of one request take turns with other requests' tasks, so a page
+  // fanning out many pagelets cannot starve everybody else's
+  job->setOwner(g_context->getTransport());
   assert(s_dispatcher);
-  s_dispatcher->enqueue(job);
+  s_dispatcher->enqueue(job, job->getOwner());
 
   return ret;
 }
@@ -342,7 +355,12 @@ int64 PageletServer::TaskStatus(CObjRef task) {
 String PageletServer::TaskResult(CObjRef task, Array &headers, int &code,
                                  int64 timeout_ms) {
   PageletTask *ptask = task.getTyped<PageletTask>();
-  return ptask->getJob()->getResults(headers, code, timeout_ms);
+  PageletTransport *job = ptask->getJob();
+  if (!job->isDone()) {
+    // the caller is blocked on this one, so run it before its siblings
+    s_dispatcher->promote(job, job->getOwner());
+  }
+  return job->getResults(headers, code, timeout_ms);
 }
 
 void PageletServer::AddToPipeline(const string &s) {
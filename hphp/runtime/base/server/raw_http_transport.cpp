@@ -0,0 +1,179 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/server/raw_http_transport.h>
+#include <runtime/base/server/http_protocol.h>
+#include <fstream>
+#include <iterator>
+
+using folly::StringPiece;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+RawHttpTransport::RawHttpTransport()
+  : m_method(UnknownMethod), m_extendedMethod(nullptr), m_postData(nullptr),
+    m_postSize(0), m_remoteHost("127.0.0.1"), m_remotePort(0), m_code(0) {
+}
+
+bool RawHttpTransport::readFile(const char *filename) {
+  std::ifstream fin(filename, std::ios::in | std::ios::binary);
+  if (!fin) return false;
+  std::string data((std::istreambuf_iterator<char>(fin)),
+                   std::istreambuf_iterator<char>());
+  return parse(data);
+}
+
+bool RawHttpTransport::parse(std::string &data) {
+  m_request.swap(data);
+  m_parser.reset();
+  m_method = UnknownMethod;
+  m_extendedMethod = nullptr;
+  m_dechunked.clear();
+  if (m_parser.parse(m_request.data(), m_request.size()) !=
+      HttpParser::Done) {
+    return false;
+  }
+
+  const char *body = m_request.data() + m_parser.headSize();
+  int rest = m_request.size() - m_parser.headSize();
+  if (m_parser.chunked()) {
+    int consumed;
+    if (HttpParser::Dechunk(body, rest, m_dechunked, consumed) !=
+        HttpParser::Done) {
+      return false;
+    }
+    m_postData = m_dechunked.data();
+    m_postSize = m_dechunked.size();
+  } else {
+    int64 length = m_parser.contentLength();
+    if (length > rest) return false;
+    m_postData = body;
+    m_postSize = length < 0 ? 0 : length;
+  }
+
+  // The method and the URL are each followed by a space in the buffer,
+  // which we overwrite so they can be handed out as C strings.
+  char *buf = &m_request[0];
+  StringPiece method = m_parser.method();
+  StringPiece url = m_parser.url();
+  buf[method.end() - m_request.data()] = '\0';
+  buf[url.end() - m_request.data()] = '\0';
+
+  if (method == "GET") {
+    m_method = GET;
+  } else if (method == "HEAD") {
+    m_method = HEAD;
+  } else if (method == "POST") {
+    m_method = POST;
+  } else {
+    // same as LibEventTransport: anything else is a POST with an
+    // extended method name
+    m_method = POST;
+    m_extendedMethod = method.begin();
+  }
+  return true;
+}
+
+const char *RawHttpTransport::getUrl() {
+  return m_parser.url().begin();
+}
+
+const char *RawHttpTransport::getRemoteHost() {
+  return m_remoteHost.c_str();
+}
+
+uint16 RawHttpTransport::getRemotePort() {
+  return m_remotePort;
+}
+
+const void *RawHttpTransport::getPostData(int &size) {
+  size = m_postSize;
+  return m_postData;
+}
+
+Transport::Method RawHttpTransport::getMethod() {
+  return m_method;
+}
+
+const char *RawHttpTransport::getExtendedMethod() {
+  return m_extendedMethod;
+}
+
+std::string RawHttpTransport::getHTTPVersion() const {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "%d.%d",
+           m_parser.versionMajor(), m_parser.versionMinor());
+  return buf;
+}
+
+int RawHttpTransport::getRequestSize() const {
+  return m_request.size();
+}
+
+std::string RawHttpTransport::getHeader(const char *name) {
+  assert(name);
+  return m_parser.getHeader(name).str();
+}
+
+void RawHttpTransport::getHeaders(HeaderMap &headers) {
+  const std::vector<HttpParser::Header> &parsed = m_parser.headers();
+  for (unsigned int i = 0; i < parsed.size(); i++) {
+    headers[parsed[i].name.str()].push_back(parsed[i].value.str());
+  }
+}
+
+void RawHttpTransport::addHeaderImpl(const char *name, const char *value) {
+  assert(name && value);
+  m_responseHeaders[name].push_back(value);
+}
+
+void RawHttpTransport::removeHeaderImpl(const char *name) {
+  assert(name);
+  m_responseHeaders.erase(name);
+}
+
+void RawHttpTransport::sendImpl(const void *data, int size, int code,
+                                bool chunked) {
+  if (!m_response.empty()) {
+    // a later chunk of a chunked response
+    m_response.append((const char *)data, size);
+    return;
+  }
+  m_code = code;
+
+  m_response = "HTTP/1.1 ";
+  m_response += boost::lexical_cast<string>(code);
+  m_response += " ";
+  m_response += HttpProtocol::GetReasonString(code);
+  m_response += "\r\n";
+
+  for (HeaderMap::const_iterator iter = m_responseHeaders.begin();
+       iter != m_responseHeaders.end(); ++iter) {
+    for (unsigned int i = 0; i < iter->second.size(); i++) {
+      m_response += iter->first;
+      m_response += ": ";
+      m_response += iter->second[i];
+      m_response += "\r\n";
+    }
+  }
+
+  m_response += "\r\n";
+  m_response.append((const char *)data, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,92 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_RAW_HTTP_TRANSPORT_H__
+#define __HPHP_RAW_HTTP_TRANSPORT_H__
+
+#include <runtime/base/server/transport.h>
+#include <util/http_parser.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A request taken straight off the wire, e.g. a captured "GET / HTTP/1.1"
+ * with its headers and body, which replay mode can feed to a handler
+ * without converting it into an hdf file first. The URL, method and headers
+ * are served out of the request buffer itself; only getHeaders() and a
+ * chunked body make copies.
+ */
+class RawHttpTransport : public Transport {
+public:
+  RawHttpTransport();
+
+  /**
+   * Takes over data, which has to hold one whole request. Returns false if
+   * it doesn't.
+   */
+  bool parse(std::string &data);
+  bool readFile(const char *filename);
+
+  void setRemoteHost(const std::string &host, uint16 port) {
+    m_remoteHost = host;
+    m_remotePort = port;
+  }
+
+  /**
+   * Implementing Transport...
+   */
+  virtual const char *getUrl();
+  virtual const char *getRemoteHost();
+  virtual uint16 getRemotePort();
+  virtual const void *getPostData(int &size);
+  virtual Method getMethod();
+  virtual const char *getExtendedMethod();
+  virtual std::string getHTTPVersion() const;
+  virtual int getRequestSize() const;
+  virtual std::string getHeader(const char *name);
+  virtual void getHeaders(HeaderMap &headers);
+  virtual void addHeaderImpl(const char *name, const char *value);
+  virtual void removeHeaderImpl(const char *name);
+  virtual void sendImpl(const void *data, int size, int code, bool chunked);
+
+  int getResponseCode() const { return m_code;}
+  /**
+   * The status line and headers, followed by every chunk sent so far.
+   */
+  const std::string &getResponse() const { return m_response;}
+
+private:
+  std::string m_request;
+  HttpParser m_parser;
+  Method m_method;
+  const char *m_extendedMethod;
+  const char *m_postData;
+  int m_postSize;
+  std::string m_dechunked;
+
+  std::string m_remoteHost;
+  uint16 m_remotePort;
+  HeaderMap m_responseHeaders;
+
+  int m_code;
+  std::string m_response;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_RAW_HTTP_TRANSPORT_H__
@@ -0,0 +1,272 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <runtime/base/server/replay_benchmark.h>
+#include <runtime/base/server/replay_transport.h>
+#include <runtime/base/server/raw_http_transport.h>
+#include <runtime/base/server/http_request_handler.h>
+#include <runtime/base/memory/memory_manager.h>
+#include <runtime/base/runtime_option.h>
+#include <util/async_func.h>
+#include <util/compatibility.h>
+#include <util/timer.h>
+#include <util/lock.h>
+#include <util/logger.h>
+#include <math.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+// recording
+
+static Mutex s_streamMutex;
+static FILE *s_stream = nullptr;
+static std::atomic<int> s_streamCount(0);
+
+void ReplayBenchmark::RecordRequest(Transport *transport) {
+  int64 now = Timer::GetCurrentTimeMicros();
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%" PRId64 "_%d", now, s_streamCount++);
+  std::string name(buf);
+
+  // one top level node per request, so the file stays valid hdf as it grows
+  Hdf hdf;
+  Hdf record = hdf[name];
+  ReplayTransport rt;
+  rt.recordInput(transport, record);
+  record["time"] = now;
+
+  Lock lock(s_streamMutex);
+  if (!s_stream) {
+    s_stream = fopen(RuntimeOption::RecordStreamFile.c_str(), "a");
+    if (!s_stream) {
+      Logger::Error("Unable to open %s for recording requests",
+                    RuntimeOption::RecordStreamFile.c_str());
+      return;
+    }
+  }
+  fputs(hdf.toString(), s_stream);
+  fflush(s_stream);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loading
+
+ReplayBenchmark::ReplayBenchmark()
+  : m_next(0), m_elapsed(0), m_threads(0), m_speed(0) {
+}
+
+void ReplayBenchmark::add(int64 time, const std::string &hdf) {
+  Request request;
+  request.time = time;
+  request.hdf = hdf;
+  m_requests.push_back(request);
+}
+
+bool ReplayBenchmark::load(const char *filename) {
+  RawHttpTransport raw;
+  if (raw.readFile(filename)) {
+    Hdf hdf;
+    ReplayTransport rt;
+    rt.recordInput(&raw, hdf);
+    add(0, hdf.toString());
+    return true;
+  }
+
+  Hdf hdf;
+  try {
+    hdf.open(filename);
+  } catch (const Exception &e) {
+    Logger::Error("Unable to read %s: %s", filename, e.what());
+    return false;
+  }
+  if (hdf["url"].exists()) {
+    add(0, hdf.toString());
+    return true;
+  }
+  bool found = false;
+  for (Hdf record = hdf.firstChild(); record.exists();
+       record = record.next()) {
+    if (record["url"].exists()) {
+      add(record["time"].getInt64(0), record.toString());
+      found = true;
+    }
+  }
+  if (!found) {
+    Logger::Error("No requests found in %s", filename);
+  }
+  return found;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// running
+
+/**
+ * A request's memory is gone by the time the handler returns, so we look
+ * at it when the response goes out.
+ */
+class BenchmarkTransport : public ReplayTransport {
+public:
+  BenchmarkTransport() : m_memory(0) {}
+
+  virtual void sendImpl(const void *data, int size, int code, bool chunked) {
+    MemoryManager *mm = MemoryManager::TheMemoryManager();
+    m_memory = std::max(m_memory, mm->getStats(true).peakUsage);
+    ReplayTransport::sendImpl(data, size, code, chunked);
+  }
+
+  int64 getMemory() const { return m_memory; }
+
+private:
+  int64 m_memory;
+};
+
+void ReplayBenchmark::run(int threads, int count, double speed) {
+  assert(threads > 0 && count > 0);
+  std::stable_sort(m_requests.begin(), m_requests.end(),
+                   [](const Request &r1, const Request &r2) {
+                     return r1.time < r2.time;
+                   });
+  if (!m_requests.empty()) {
+    int64 first = m_requests.front().time;
+    for (unsigned int i = 0; i < m_requests.size(); i++) {
+      m_requests[i].time -= first;
+    }
+  }
+
+  m_results.clear();
+  m_results.resize(m_requests.size() * count);
+  m_next = 0;
+  m_threads = threads;
+  m_speed = speed;
+
+  std::vector<AsyncFunc<ReplayBenchmark>*> workers;
+  gettime(CLOCK_MONOTONIC, &m_start);
+  for (int i = 0; i < threads; i++) {
+    workers.push_back(new AsyncFunc<ReplayBenchmark>
+                      (this, &ReplayBenchmark::worker));
+    workers.back()->start();
+  }
+  for (int i = 0; i < threads; i++) {
+    workers[i]->waitForEnd();
+    delete workers[i];
+  }
+  timespec end;
+  gettime(CLOCK_MONOTONIC, &end);
+  m_elapsed = gettime_diff_us(m_start, end);
+}
+
+RequestHandler *ReplayBenchmark::createRequestHandler() {
+  return new HttpRequestHandler();
+}
+
+void ReplayBenchmark::worker() {
+  RequestHandler *handler = createRequestHandler();
+  int total = m_results.size();
+  int size = m_requests.size();
+  // each round of the stream starts right after the previous one's last
+  int64 round = size ? m_requests.back().time + 1 : 0;
+
+  for (int i = m_next++; i < total; i = m_next++) {
+    const Request &request = m_requests[i % size];
+    timespec start;
+    if (m_speed > 0) {
+      int64 due = (int64)((round * (i / size) + request.time) / m_speed);
+      gettime(CLOCK_MONOTONIC, &start);
+      int64 early = due - gettime_diff_us(m_start, start);
+      if (early > 0) usleep(early);
+    }
+
+    Hdf hdf;
+    hdf.fromString(request.hdf.c_str());
+    BenchmarkTransport transport;
+    transport.replayInput(hdf);
+
+    gettime(CLOCK_MONOTONIC, &start);
+    transport.onRequestStart(start);
+    try {
+      handler->handleRequest(&transport);
+    } catch (const std::exception &e) {
+      Logger::Error("Exception replaying %s: %s", transport.getUrl(),
+                    e.what());
+    }
+    timespec end;
+    gettime(CLOCK_MONOTONIC, &end);
+
+    Result &result = m_results[i];
+    result.latency = gettime_diff_us(start, end);
+    result.memory = transport.getMemory();
+    result.code = transport.getResponseCode();
+  }
+  delete handler;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reporting
+
+static int64 percentile(const std::vector<int64> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  int index = (int)ceil(sorted.size() * p / 100) - 1;
+  return sorted[std::max(index, 0)];
+}
+
+static void print_percentiles(std::ostringstream &out, const char *name,
+                              std::vector<int64> &values) {
+  std::sort(values.begin(), values.end());
+  out << name
+      << ": p50 " << percentile(values, 50)
+      << ", p90 " << percentile(values, 90)
+      << ", p99 " << percentile(values, 99)
+      << ", max " << percentile(values, 100) << "\n";
+}
+
+std::string ReplayBenchmark::report() const {
+  std::ostringstream out;
+  int total = m_results.size();
+  int errors = 0;
+  std::vector<int64> latencies, memory;
+  for (int i = 0; i < total; i++) {
+    if (m_results[i].code != 200) errors++;
+    latencies.push_back(m_results[i].latency);
+    memory.push_back(m_results[i].memory);
+  }
+
+  double seconds = m_elapsed / 1000000.0;
+  out << total << " requests on " << m_threads << " threads in "
+      << seconds << "s: " << (seconds > 0 ? total / seconds : 0)
+      << " requests/s, " << errors << " not 200\n";
+  print_percentiles(out, "latency (us)", latencies);
+  print_percentiles(out, "memory (bytes)", memory);
+
+  // Requests are numbered in the order they started, so the median of each
+  // tenth of them shows how the server got faster as the JIT warmed up.
+  out << "warmup, median latency (us) by tenth of the run:";
+  for (int tenth = 0; tenth < 10; tenth++) {
+    int begin = (int64)total * tenth / 10;
+    int end = (int64)total * (tenth + 1) / 10;
+    if (begin == end) continue;
+    std::vector<int64> part;
+    for (int i = begin; i < end; i++) {
+      part.push_back(m_results[i].latency);
+    }
+    std::sort(part.begin(), part.end());
+    out << " " << percentile(part, 50);
+  }
+  out << "\n";
+  return out.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,97 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_REPLAY_BENCHMARK_H__
+#define __HPHP_REPLAY_BENCHMARK_H__
+
+#include <runtime/base/server/transport.h>
+#include <atomic>
+
+class TestUtil;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+class RequestHandler;
+
+/**
+ * Load testing with real traffic: a server with Debug.RecordStreamFile set
+ * appends every PHP request it gets to that file, and "-m bench" plays the
+ * file back on this process's own request handlers with as many threads as
+ * asked for, then reports throughput, latency percentiles, how latency
+ * settles as the JIT warms up, and how much memory requests took.
+ */
+class ReplayBenchmark {
+  friend class ::TestUtil;
+public:
+  /**
+   * Appends transport's request to RuntimeOption::RecordStreamFile, along
+   * with when it came in.
+   */
+  static void RecordRequest(Transport *transport);
+
+  ReplayBenchmark();
+  virtual ~ReplayBenchmark() {}
+
+  /**
+   * Adds the requests in filename: a stream written by RecordRequest(), a
+   * single request captured with Debug.RecordInput or a raw HTTP request.
+   * Returns false if it's none of these.
+   */
+  bool load(const char *filename);
+
+  /**
+   * Plays all loaded requests count times over on threads threads. With a
+   * speed of 0 each thread goes as fast as it can. Otherwise requests start
+   * when they came in when recorded, sped up by that factor.
+   */
+  void run(int threads, int count, double speed);
+
+  std::string report() const;
+
+protected:
+  /**
+   * What each thread plays the requests on, HttpRequestHandler by default.
+   */
+  virtual RequestHandler *createRequestHandler();
+
+private:
+  struct Request {
+    int64 time;        // when it came in, in microseconds
+    std::string hdf;   // as ReplayTransport records it
+  };
+  struct Result {
+    int64 latency;     // in microseconds
+    int64 memory;      // peak bytes in use
+    int code;
+  };
+
+  std::vector<Request> m_requests;
+  std::vector<Result> m_results;
+  std::atomic<int> m_next;
+  timespec m_start;
+  int64 m_elapsed;
+  int m_threads;
+  double m_speed;
+
+  void add(int64 time, const std::string &hdf);
+  void worker();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_REPLAY_BENCHMARK_H__
@@ -24,9 +24,13 @@ namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 void ReplayTransport::recordInput(Transport* transport, const char *filename) {
-  assert(transport);
-
   Hdf hdf;
+  recordInput(transport, hdf);
+  hdf.write(filename);
+}
+
+void ReplayTransport::recordInput(Transport* transport, Hdf hdf) {
+  assert(transport);
 
   char buf[32];
   snprintf(buf, sizeof(buf), "%u", Process::GetProcessId());
@@ -62,8 +66,6 @@ void ReplayTransport::recordInput(Transport* transport, const char *filename) {
   } else {
     hdf["post"] = "";
   }
-
-  hdf.write(filename);
 }
 
 void ReplayTransport::replayInput(const char *filename) {
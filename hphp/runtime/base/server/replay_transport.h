@@ -35,6 +35,7 @@ public:
   ReplayTransport() : m_code(0) {}
 
   void recordInput(Transport* transport, const char *filename);
+  void recordInput(Transport* transport, Hdf hdf);
   void replayInput(const char *filename);
   void replayInput(Hdf hdf);
 
@@ -23,6 +23,7 @@
 #include <runtime/base/server/access_log.h>
 #include <runtime/base/server/source_root_info.h>
 #include <runtime/base/server/request_uri.h>
+#include <runtime/base/shared/shared_variant.h>
 #include <runtime/ext/ext_json.h>
 #include <util/process.h>
 
@@ -264,10 +265,19 @@ bool RPCRequestHandler::executePHPFunction(Transport *transport,
       switch (output) {
         case 0: {
           assert(m_returnEncodeType == Json ||
-                 m_returnEncodeType == Serialize);
+                 m_returnEncodeType == Serialize ||
+                 m_returnEncodeType == Shared);
           try {
-            response = (m_returnEncodeType == Json) ? f_json_encode(funcRet)
-                                                    : f_serialize(funcRet);
+            if (m_returnEncodeType == Shared) {
+              SharedVariant *result = SharedVariant::Create(funcRet, false);
+              if (!transport->setSharedResult(result)) {
+                result->decRef();
+                response = f_serialize(funcRet);
+              }
+            } else {
+              response = (m_returnEncodeType == Json) ? f_json_encode(funcRet)
+                                                      : f_serialize(funcRet);
+            }
           } catch (...) {
             serializeFailed = true;
           }
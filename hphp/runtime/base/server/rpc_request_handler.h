@@ -33,6 +33,7 @@ public:
   enum ReturnEncodeType {
     Json      = 1,
     Serialize = 2,
+    Shared    = 3, // SharedVariant, for in-process transports
   };
 
   RPCRequestHandler(bool info = true);
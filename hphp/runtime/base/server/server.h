@@ -180,6 +180,12 @@ public:
    */
   virtual bool enableSSL(void *sslCTX, int port) = 0;
 
+  /**
+   * Turn away requests when the queue backs up, as configured by the
+   * Server.Queue* options. Only the page server does this.
+   */
+  virtual void enableLoadShedding() {}
+
 protected:
   std::string m_address;
   int m_port;
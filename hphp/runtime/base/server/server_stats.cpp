@@ -602,6 +602,47 @@ Mutex ServerStats::s_lock;
 vector<ServerStats*> ServerStats::s_loggers;
 bool ServerStats::s_profile_network = false;
 IMPLEMENT_THREAD_LOCAL_NO_CHECK(ServerStats, ServerStats::s_logger);
+ReadWriteMutex ServerStats::s_latencyLock;
+hphp_string_map<LatencyHistogram*> ServerStats::s_latencies;
+LatencyHistogram *ServerStats::s_latencyOverflow = nullptr;
+
+struct ServerStats::KeyRegistry {
+  ReadWriteMutex m_lock;
+  hphp_string_map<int> m_ids;
+  vector<string> m_names;
+};
+
+ServerStats::KeyRegistry &ServerStats::GetKeyRegistry() {
+  // keys may be registered by other files' static initializers
+  static KeyRegistry registry;
+  return registry;
+}
+
+int ServerStats::RegisterKey(const string &name) {
+  KeyRegistry &registry = GetKeyRegistry();
+  {
+    ReadLock lock(registry.m_lock, false);
+    hphp_string_map<int>::const_iterator iter = registry.m_ids.find(name);
+    if (iter != registry.m_ids.end()) {
+      return iter->second;
+    }
+  }
+  WriteLock lock(registry.m_lock, false);
+  hphp_string_map<int>::const_iterator iter = registry.m_ids.find(name);
+  if (iter != registry.m_ids.end()) {
+    return iter->second;
+  }
+  int key = registry.m_names.size();
+  registry.m_names.push_back(name);
+  registry.m_ids[name] = key;
+  return key;
+}
+
+void ServerStats::Log(int key, int64 value) {
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+    ServerStats::s_logger->log(key, value);
+  }
+}
 
 void ServerStats::LogPage(const string &url, int code) {
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
@@ -611,7 +652,8 @@ void ServerStats::LogPage(const string &url, int code) {
 
 void ServerStats::Log(const string &name, int64 value) {
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
-    ServerStats::s_logger->log(name, value);
+    ServerStats *logger = ServerStats::s_logger.getNoCheck();
+    logger->log(logger->getKey(name), value);
   }
 }
 
@@ -654,12 +696,86 @@ void ServerStats::Reset() {
 }
 
 void ServerStats::Clear() {
-  Lock lock(s_lock, false);
-  for (unsigned int i = 0; i < s_loggers.size(); i++) {
-    s_loggers[i]->clear();
+  {
+    Lock lock(s_lock, false);
+    for (unsigned int i = 0; i < s_loggers.size(); i++) {
+      s_loggers[i]->clear();
+    }
+  }
+  ReadLock lock(s_latencyLock, false);
+  for (hphp_string_map<LatencyHistogram*>::const_iterator iter =
+         s_latencies.begin(); iter != s_latencies.end(); ++iter) {
+    iter->second->clear();
+  }
+}
+
+LatencyHistogram *ServerStats::GetLatencyHistogram(const string &url) {
+  {
+    ReadLock lock(s_latencyLock, false);
+    hphp_string_map<LatencyHistogram*>::const_iterator iter =
+      s_latencies.find(url);
+    if (iter != s_latencies.end()) {
+      return iter->second;
+    }
+    // past the limit, new URLs share a single distribution
+    if (s_latencyOverflow &&
+        (int)s_latencies.size() >= RuntimeOption::StatsLatencyMaxURLs) {
+      return s_latencyOverflow;
+    }
+  }
+  WriteLock lock(s_latencyLock, false);
+  bool overflow =
+    (int)s_latencies.size() >= RuntimeOption::StatsLatencyMaxURLs;
+  LatencyHistogram *&h = s_latencies[overflow ? string("*") : url];
+  if (!h) {
+    h = new LatencyHistogram();
+  }
+  if (overflow) s_latencyOverflow = h;
+  return h;
+}
+
+void ServerStats::LogLatency(const string &name, int64 us) {
+  if (RuntimeOption::EnableLatencyStats) {
+    GetLatencyHistogram(name)->record(us);
   }
 }
 
+void ServerStats::ReportLatency(string &output, const string &url) {
+  // sorted, so reports are easy to compare
+  map<string, LatencyHistogram*> latencies;
+  {
+    ReadLock lock(s_latencyLock, false);
+    for (hphp_string_map<LatencyHistogram*>::const_iterator iter =
+           s_latencies.begin(); iter != s_latencies.end(); ++iter) {
+      if (url.empty() || iter->first == url) {
+        latencies[iter->first] = iter->second;
+      }
+    }
+  }
+
+  std::ostringstream out;
+  out << "{";
+  const char *sep = "\n";
+  for (map<string, LatencyHistogram*>::const_iterator iter =
+         latencies.begin(); iter != latencies.end(); ++iter) {
+    const LatencyHistogram &h = *iter->second;
+    int64 count = h.count();
+    if (!count) continue;
+    out << sep << "  \"" << JSON::Escape(iter->first.c_str()) << "\": {"
+        << "\"count\": " << count
+        << ", \"min\": " << h.min()
+        << ", \"mean\": " << h.sum() / count
+        << ", \"p50\": " << h.percentile(50)
+        << ", \"p90\": " << h.percentile(90)
+        << ", \"p99\": " << h.percentile(99)
+        << ", \"p999\": " << h.percentile(99.9)
+        << ", \"max\": " << h.max() << "}";
+    sep = ",\n";
+  }
+  out << "\n}\n";
+  output = out.str();
+}
+
 void ServerStats::CollectSlots(list<TimeSlot*> &slots, int64 from, int64 to) {
   if (from < 0 || to <= 0) {
     time_t now = time(nullptr);
@@ -1020,16 +1136,29 @@ ServerStats::~ServerStats() {
   }
 }
 
-void ServerStats::log(const string &name, int64 value) {
-  m_values[name] += value;
+int ServerStats::getKey(const string &name) {
+  hphp_string_map<int>::const_iterator iter = m_keys.find(name);
+  if (iter != m_keys.end()) {
+    return iter->second;
+  }
+  return m_keys[name] = RegisterKey(name);
 }
 
-int64 ServerStats::get(const std::string &name) {
-  CounterMap::const_iterator iter = m_values.find(name);
-  if (iter != m_values.end()) {
-    return iter->second;
+void ServerStats::log(int key, int64 value) {
+  if (key >= (int)m_values.size()) {
+    m_values.resize(key + 1);
+    m_logged.resize(key + 1);
+  }
+  if (!m_logged[key]) {
+    m_logged[key] = true;
+    m_touched.push_back(key);
   }
-  return 0;
+  m_values[key] += value;
+}
+
+int64 ServerStats::get(const std::string &name) {
+  int key = getKey(name);
+  return key < (int)m_values.size() ? m_values[key] : 0;
 }
 
 void ServerStats::logPage(const string &url, int code) {
@@ -1053,11 +1182,17 @@ void ServerStats::logPage(const string &url, int code) {
       ts.m_time = now;
       ts.m_pages.clear();
     }
-    PageStats &ps = ts.m_pages[url + lexical_cast<string>(code)];
-    ps.m_url = url;
-    ps.m_code = code;
-    ps.m_hit++;
-    Merge(ps.m_values, m_values);
+    PageCounters &pc = ts.m_pages[url + lexical_cast<string>(code)];
+    pc.m_url = url;
+    pc.m_code = code;
+    pc.m_hit++;
+    for (unsigned int i = 0; i < m_touched.size(); i++) {
+      int key = m_touched[i];
+      if (key >= (int)pc.m_values.size()) {
+        pc.m_values.resize(key + 1);
+      }
+      pc.m_values[key] += m_values[key];
+    }
   }
 
   m_last = now;
@@ -1068,12 +1203,24 @@ void ServerStats::logPage(const string &url, int code) {
     m_max = now;
   }
 
-  m_threadStatus.m_mode = Idling;
   gettimeofday(&m_threadStatus.m_done, 0);
+  if (RuntimeOption::EnableLatencyStats &&
+      m_threadStatus.m_mode != Idling) {
+    timeval &start = m_threadStatus.m_start;
+    timeval &done = m_threadStatus.m_done;
+    GetLatencyHistogram(url)->record(
+      (done.tv_sec - start.tv_sec) * 1000000LL +
+      (done.tv_usec - start.tv_usec));
+  }
+  m_threadStatus.m_mode = Idling;
 }
 
 void ServerStats::reset() {
-  m_values.clear();
+  for (unsigned int i = 0; i < m_touched.size(); i++) {
+    m_values[m_touched[i]] = 0;
+    m_logged[m_touched[i]] = false;
+  }
+  m_touched.clear();
 }
 
 void ServerStats::clear() {
@@ -1092,15 +1239,35 @@ void ServerStats::collect(std::list<TimeSlot*> &slots, int64 from, int64 to) {
   if (from < m_min) from = m_min;
   if (to > m_max) to = m_max;
 
-  Lock lock(m_lock, false);
   list<TimeSlot*> collected;
-  for (int64 t = from; t <= to; t++) {
-    int slot = t % RuntimeOption::StatsMaxSlot;
-    if (m_slots[slot].m_time == t) {
-      collected.push_back(&m_slots[slot]);
+  {
+    Lock lock(m_lock, false);
+    KeyRegistry &registry = GetKeyRegistry();
+    ReadLock keyLock(registry.m_lock, false);
+    for (int64 t = from; t <= to; t++) {
+      const ThreadSlot &slot = m_slots[t % RuntimeOption::StatsMaxSlot];
+      if (slot.m_time != t) continue;
+
+      TimeSlot *ts = new TimeSlot();
+      ts->m_time = t;
+      for (hphp_string_map<PageCounters>::const_iterator iter =
+             slot.m_pages.begin(); iter != slot.m_pages.end(); ++iter) {
+        const PageCounters &pc = iter->second;
+        PageStats &ps = ts->m_pages[iter->first];
+        ps.m_url = pc.m_url;
+        ps.m_code = pc.m_code;
+        ps.m_hit = pc.m_hit;
+        for (unsigned int key = 0; key < pc.m_values.size(); key++) {
+          if (pc.m_values[key]) {
+            ps.m_values[registry.m_names[key]] = pc.m_values[key];
+          }
+        }
+      }
+      collected.push_back(ts);
     }
   }
   Merge(slots, collected);
+  FreeSlots(collected);
 }
 
 void ServerStats::logBytes(int64 bytes) {
@@ -23,6 +23,7 @@
 #include <time.h>
 #include <runtime/base/shared/shared_string.h>
 #include <runtime/base/types.h>
+#include <util/latency_histogram.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -44,6 +45,13 @@ public:
   };
 
 public:
+  /**
+   * Counters are kept in per-thread arrays, indexed by an id that each name
+   * is registered under the first time it is seen. Hot paths can register
+   * their names once and log by id, which saves hashing the name.
+   */
+  static int RegisterKey(const std::string &name);
+  static void Log(int key, int64 value);
   static void Log(const std::string &name, int64 value);
   static int64 Get(const std::string &name);
   static void LogPage(const std::string &url, int code);
@@ -55,6 +63,18 @@ public:
                      const std::string &url, int code,
                      const std::string &prefix);
 
+  /**
+   * Distributions of the wall time of each URL's requests, in microseconds,
+   * as JSON. Only requests made while Stats.Latency is on are included.
+   */
+  static void ReportLatency(std::string &out, const std::string &url);
+
+  /**
+   * Records a non-page distribution, e.g. how long pagelet and xbox tasks
+   * sat in their queues. Reported by ReportLatency() next to the URLs.
+   */
+  static void LogLatency(const std::string &name, int64 us);
+
   // thread status functions
   static void LogBytes(int64 bytes);
   static void StartRequest(const char *url, const char *clientIP,
@@ -90,7 +110,16 @@ private:
   static std::vector<ServerStats*> s_loggers;
   static DECLARE_THREAD_LOCAL_NO_CHECK(ServerStats, s_logger);
 
+  struct KeyRegistry;
+  static KeyRegistry &GetKeyRegistry();
+
+  static ReadWriteMutex s_latencyLock;
+  static hphp_string_map<LatencyHistogram*> s_latencies;
+  static LatencyHistogram *s_latencyOverflow; // s_latencies["*"], or null
+  static LatencyHistogram *GetLatencyHistogram(const std::string &url);
+
   typedef hphp_shared_string_map<int64> CounterMap;
+  typedef std::vector<int64> CounterArray; // indexed by key id
 
   struct PageStats {
     std::string m_url; // which page
@@ -104,6 +133,18 @@ private:
     PageStatsMap m_pages;
   };
 
+  // what each thread records, turned into PageStats only for reports
+  struct PageCounters {
+    std::string m_url;
+    int m_code;
+    int m_hit;
+    CounterArray m_values;
+  };
+  struct ThreadSlot {
+    int64 m_time;
+    hphp_string_map<PageCounters> m_pages;
+  };
+
   static void Merge(CounterMap &dest, const CounterMap &src);
   static void Merge(PageStatsMap &dest, const PageStatsMap &src);
   static void Merge(std::list<TimeSlot*> &dest,
@@ -124,13 +165,17 @@ private:
                      const std::string &prefix);
 
   Mutex m_lock;
-  std::vector<TimeSlot> m_slots;
+  std::vector<ThreadSlot> m_slots;
   int64 m_last; // previous timepoint
   int64 m_min;  // earliest timepoint
   int64 m_max;  // latest timepoint
-  CounterMap m_values;  // current page's name value pairs
+  CounterArray m_values;      // current page's values
+  std::vector<char> m_logged; // whether m_values[key] is in m_touched
+  std::vector<int> m_touched; // keys logged since the last reset()
+  hphp_string_map<int> m_keys; // this thread's copy of the key registry
 
-  void log(const std::string &name, int64 value);
+  int getKey(const std::string &name);
+  void log(int key, int64 value);
   int64 get(const std::string &name);
   void logPage(const std::string &url, int code);
   void reset();
@@ -21,6 +21,11 @@
 #include <util/process.h>
 #include <util/util.h>
 #include <util/compression.h>
+#include <util/zend/zend_string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <climits>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -31,6 +36,20 @@ FileCachePtr StaticContentCache::TheFileCache;
 StaticContentCache::StaticContentCache() : m_totalSize(0) {
 }
 
+StaticContentCache::ResourceFile::~ResourceFile() {
+  if (mapped) {
+    munmap(mapped, mappedSize);
+  }
+}
+
+static char *map_file(const char *filename, int size) {
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) return nullptr;
+  void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return p == MAP_FAILED ? nullptr : (char *)p;
+}
+
 void StaticContentCache::load() {
   Timer timer(Timer::WallTime, "loading static content");
 
@@ -82,54 +101,96 @@ void StaticContentCache::load() {
     }
     const vector<string> &out = ext2files[iter->first];
 
-    int total = 0;
+    int total = 0, mapped = 0;
     for (unsigned int i = 0; i < out.size(); i++) {
       ResourceFilePtr f(new ResourceFile());
 
-      CstrBufferPtr sb(new CstrBuffer(out[i].c_str()));
-      if (sb->valid() && sb->size() > 0) {
-        string url = out[i].substr(rootSize + 1);
-        f->file = sb;
-        m_files[url] = f;
-
-        // prepare gzipped content, skipping image and swf files
-        if (iter->second.find("image/") != 0 && iter->first != "swf") {
-          int len = sb->size();
-          char *data = gzencode(sb->data(), len, 9, CODING_GZIP);
-          if (data) {
-            if (unsigned(len) < sb->size()) {
-              f->compressed = CstrBufferPtr(new CstrBuffer(data, len));
-            } else {
-              free(data);
-            }
-          }
+      // large files are left in the page cache rather than copied to heap
+      struct stat st;
+      if (RuntimeOption::EnableStaticContentSourceMMap &&
+          stat(out[i].c_str(), &st) == 0 &&
+          st.st_size >= RuntimeOption::StaticContentMMapMinSize &&
+          st.st_size <= INT_MAX) {
+        f->mapped = map_file(out[i].c_str(), st.st_size);
+        if (f->mapped) {
+          f->mappedSize = st.st_size;
+          mapped += st.st_size;
         }
+      }
+      if (!f->mapped) {
+        CstrBufferPtr sb(new CstrBuffer(out[i].c_str()));
+        if (sb->valid()) f->file = sb;
+      }
 
-        total += sb->size();
+      const char *data;
+      int size;
+      if (f->mapped) {
+        data = f->mapped;
+        size = f->mappedSize;
+      } else if (f->file && f->file->size() > 0) {
+        data = f->file->data();
+        size = f->file->size();
+      } else {
+        continue;
       }
+
+      string url = out[i].substr(rootSize + 1);
+      m_files[url] = f;
+
+      int md5len;
+      char *md5 = string_md5(data, size, false, md5len);
+      f->etag = string("\"") + md5 + "\"";
+      free(md5);
+
+      // use the precompressed copy next to the file, if there is one,
+      // or prepare gzipped content, skipping image and swf files
+      CstrBufferPtr gz(new CstrBuffer((out[i] + ".gz").c_str()));
+      if (gz->valid() && gz->size() > 0) {
+        f->compressed = gz;
+      } else if (iter->second.find("image/") != 0 && iter->first != "swf") {
+        int len = size;
+        char *cdata = gzencode(data, len, 9, CODING_GZIP);
+        if (cdata) {
+          if (len < size) {
+            f->compressed = CstrBufferPtr(new CstrBuffer(cdata, len));
+          } else {
+            free(cdata);
+          }
+        }
+      }
+
+      total += size;
     }
-    Logger::Info("..loaded %d bytes of %s files", total, iter->first.c_str());
+    Logger::Info("..loaded %d bytes of %s files (%d bytes mapped)",
+                 total, iter->first.c_str(), mapped);
     m_totalSize += total;
   }
   Logger::Info("loaded %d bytes of static content in total", m_totalSize);
 }
 
 bool StaticContentCache::find(const std::string &name, const char *&data,
-                              int &len, bool &compressed) const {
+                              int &len, bool &compressed,
+                              std::string *etag /* = nullptr */) const {
   if (TheFileCache) {
     return (data = TheFileCache->read(name.c_str(), len, compressed));
   }
 
   StringToResourceFilePtrMap::const_iterator iter = m_files.find(name);
   if (iter != m_files.end()) {
-    if (compressed && iter->second->compressed) {
-      data = iter->second->compressed->data();
-      len = iter->second->compressed->size();
+    const ResourceFile &f = *iter->second;
+    if (compressed && f.compressed) {
+      data = f.compressed->data();
+      len = f.compressed->size();
+    } else if (f.mapped) {
+      compressed = false;
+      data = f.mapped;
+      len = f.mappedSize;
     } else {
       compressed = false;
-      data = iter->second->file->data();
-      len = iter->second->file->size();
+      data = f.file->data();
+      len = f.file->size();
     }
+    if (etag) *etag = f.etag;
     return true;
   }
   return false;
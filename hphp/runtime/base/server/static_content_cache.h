@@ -37,18 +37,26 @@ public:
   void load();
 
   /**
-   * Find a file from cache.
+   * Find a file from cache. Files loaded from the source root also come
+   * with an ETag, computed at load time. The data stays valid for as long
+   * as the cache does.
    */
   bool find(const std::string &name, const char *&data, int &len,
-            bool &compressed) const;
+            bool &compressed, std::string *etag = nullptr) const;
 
 private:
   int m_totalSize;
 
   DECLARE_BOOST_TYPES(ResourceFile);
   struct ResourceFile {
+    ResourceFile() : mapped(nullptr), mappedSize(0) {}
+    ~ResourceFile();
+
     CstrBufferPtr file;
+    char *mapped; // large files are mmap-ed instead of read into file
+    int mappedSize;
     CstrBufferPtr compressed;
+    std::string etag;
   };
 
   StringToResourceFilePtrMap m_files;
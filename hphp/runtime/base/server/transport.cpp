@@ -34,14 +34,24 @@
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+static const int s_uncompressedKey =
+  ServerStats::RegisterKey("network.uncompressed");
+static const int s_compressedKey =
+  ServerStats::RegisterKey("network.compressed");
+static const int s_copiedKey = ServerStats::RegisterKey("network.copied");
+static const int s_zeroCopyKey = ServerStats::RegisterKey("network.zerocopy");
+
 Transport::Transport()
   : m_instructions(0), m_url(nullptr), m_postData(nullptr), m_postDataParsed(false),
     m_chunkedEncoding(false), m_headerSent(false),
     m_headerCallback(null), m_headerCallbackDone(false),
     m_responseCode(-1), m_firstHeaderSet(false), m_firstHeaderLine(0),
     m_responseSize(0), m_responseTotalSize(0), m_responseSentSize(0),
-    m_flushTimeUs(0), m_sendContentType(true),
-    m_compression(true), m_compressor(nullptr), m_isSSL(false),
+    m_responseCopiedSize(0), m_responseZeroCopySize(0), m_flushTimeUs(0),
+    m_sendContentType(true),
+    m_compression(true), m_compressionMode(CODING_GZIP),
+    m_serverLoad(0),
+    m_compressor(nullptr), m_isSSL(false),
     m_compressionDecision(NotDecidedYet), m_threadType(RequestThread) {
   memset(&m_queueTime, 0, sizeof(m_queueTime));
   memset(&m_wallTime, 0, sizeof(m_wallTime));
@@ -475,13 +485,19 @@ string Transport::getCookie(const string &name) {
   return "";
 }
 
-bool Transport::decideCompression() {
+int Transport::decideCompression() {
   assert(m_compressionDecision == NotDecidedYet);
 
   if (!RuntimeOption::ForceCompressionURL.empty() &&
       getCommand() == RuntimeOption::ForceCompressionURL) {
     m_compressionDecision = HasToCompress;
-    return true;
+    return m_compressionMode;
+  }
+
+  if (RuntimeOption::EnableLZ4Compression && acceptEncoding("lz4")) {
+    m_compressionMode = CODING_LZ4;
+    m_compressionDecision = ShouldCompress;
+    return m_compressionMode;
   }
 
   if (acceptEncoding("gzip") ||
@@ -490,11 +506,11 @@ bool Transport::decideCompression() {
       (!RuntimeOption::ForceCompressionParam.empty() &&
        paramExists(RuntimeOption::ForceCompressionParam.c_str()))) {
     m_compressionDecision = ShouldCompress;
-    return true;
+    return m_compressionMode;
   }
 
   m_compressionDecision = ShouldNotCompress;
-  return false;
+  return 0;
 }
 
 std::string Transport::getHTTPVersion() const {
@@ -615,7 +631,9 @@ void Transport::prepareHeaders(bool compressed, const void *data, int size) {
   }
 
   if (compressed) {
-    addHeaderImpl("Content-Encoding", "gzip");
+    // anything compressed before it got here is gzip'ed
+    addHeaderImpl("Content-Encoding",
+                  m_compressor ? m_compressor->getEncoding() : "gzip");
     removeHeaderImpl("Content-Length");
     if (m_responseHeaders.find("Content-MD5") != m_responseHeaders.end()) {
       String response((const char *)data, size, AttachLiteral);
@@ -685,9 +703,10 @@ String Transport::prepareResponse(const void *data, int size, bool &compressed,
   // where we don't really know if next chunk will benefit from compresseion.
   if (m_chunkedEncoding || size > 1000 ||
       m_compressionDecision == HasToCompress) {
+    int level = RuntimeOption::GzipCompressionLevel;
     if (m_compressor == nullptr) {
-      m_compressor = new StreamCompressor(RuntimeOption::GzipCompressionLevel,
-                                          CODING_GZIP, true);
+      level = getCompressionLevel(size);
+      m_compressor = ResponseCompressor::Create(m_compressionMode, level);
     }
     int len = size;
     char *compressedData =
@@ -700,14 +719,30 @@ String Transport::prepareResponse(const void *data, int size, bool &compressed,
         compressed = true;
       }
     } else {
-      Logger::Error("Unable to compress response: level=%d len=%d",
-                    RuntimeOption::GzipCompressionLevel, len);
+      Logger::Error("Unable to compress response: encoding=%s level=%d len=%d",
+                    m_compressor->getEncoding(), level, len);
     }
   }
 
   return response;
 }
 
+int Transport::getCompressionLevel(int size) const {
+  int level = RuntimeOption::GzipCompressionLevel;
+  if (!RuntimeOption::AdaptiveCompressionLevel || level <= 0) {
+    return level;
+  }
+
+  // spend CPU on compression only while the server has some to spare
+  if (m_serverLoad >= 75 || size > (1 << 20)) {
+    return 1;
+  }
+  if (m_serverLoad < 50 && size < (64 << 10)) {
+    return RuntimeOption::GzipMaxCompressionLevel;
+  }
+  return level;
+}
+
 bool Transport::setHeaderCallback(CVarRef callback) {
   if (m_headerCallback) {
     // return false if a callback has already been set.
@@ -771,8 +806,8 @@ void Transport::sendRawLocked(void *data, int size, int code /* = 200 */,
 
   ServerStats::LogBytes(size);
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
-    ServerStats::Log("network.uncompressed", size);
-    ServerStats::Log("network.compressed", response.size());
+    ServerStats::Log(s_uncompressedKey, size);
+    ServerStats::Log(s_compressedKey, response.size());
   }
 }
 
@@ -784,11 +819,86 @@ void Transport::sendRaw(void *data, int size, int code /* = 200 */,
   sendRawLocked(data, size, code, compressed, chunked, codeInfo);
 }
 
+static String join_segments(const std::vector<StringSlice> &segments,
+                            int size) {
+  String joined(size, ReserveString);
+  char *p = joined.mutableSlice().ptr;
+  for (unsigned int i = 0; i < segments.size(); i++) {
+    memcpy(p, segments[i].ptr, segments[i].len);
+    p += segments[i].len;
+  }
+  return joined.setSize(size);
+}
+
+void Transport::sendRawSegments(const std::vector<StringSlice> &segments,
+                                int code /* = 200 */,
+                                bool byReference /* = false */) {
+  if (segments.empty()) {
+    sendRaw((void*)"", 0, code);
+    return;
+  }
+  if (segments.size() == 1 && !byReference) {
+    sendRaw((void*)segments[0].ptr, segments[0].len, code);
+    return;
+  }
+
+  int size = 0;
+  for (unsigned int i = 0; i < segments.size(); i++) {
+    size += segments[i].len;
+  }
+
+  if (!m_headerCallbackDone && !m_headerCallback.isNull()) {
+    m_headerCallbackDone = true;
+    call_user_func0(m_headerCallback);
+  }
+  if (m_compressionDecision == NotDecidedYet) {
+    decideCompression();
+  }
+  if (m_chunkedEncoding || RuntimeOption::ForceChunkedEncoding ||
+      (isCompressionEnabled() &&
+       m_compressionDecision != ShouldNotCompress)) {
+    // the compressor and chunk writer work on contiguous data
+    String joined = join_segments(segments, size);
+    sendRaw((void*)joined.data(), size, code);
+    return;
+  }
+
+  ServerStatsHelper ssh("send");
+  if (m_responseCode < 0) {
+    m_responseCode = code;
+    m_responseCodeInfo = "";
+  }
+  if (!m_headerSent) {
+    prepareHeaders(false, nullptr, size);
+    m_headerSent = true;
+  }
+
+  m_responseSize += size;
+  ServerStats::SetThreadMode(ServerStats::Writing);
+  sendSegmentsImpl(segments, size, m_responseCode);
+  ServerStats::SetThreadMode(ServerStats::Processing);
+
+  ServerStats::LogBytes(size);
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+    ServerStats::Log(s_uncompressedKey, size);
+    ServerStats::Log(s_compressedKey, size);
+  }
+}
+
+void Transport::sendSegmentsImpl(const std::vector<StringSlice> &segments,
+                                 int size, int code) {
+  String joined = join_segments(segments, size);
+  sendImpl(joined.data(), size, code, false);
+}
+
 void Transport::onSendEnd() {
   if (m_compressor && m_chunkedEncoding) {
     bool compressed = false;
     String response = prepareResponse("", 0, compressed, true);
-    sendImpl(response.data(), response.size(), m_responseCode, true);
+    // an empty chunk would end the response early
+    if (!response.empty()) {
+      sendImpl(response.data(), response.size(), m_responseCode, true);
+    }
   }
   onSendEndImpl();
 }
@@ -811,6 +921,20 @@ void Transport::onChunkedProgress(int writtenSize) {
   m_chunksSentSizes.push_back(writtenSize);
 }
 
+void Transport::onCopyProgress(int copiedSize) {
+  m_responseCopiedSize += copiedSize;
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+    ServerStats::Log(s_copiedKey, copiedSize);
+  }
+}
+
+void Transport::onZeroCopyProgress(int sentSize) {
+  m_responseZeroCopySize += sentSize;
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
+    ServerStats::Log(s_zeroCopyKey, sentSize);
+  }
+}
+
 void Transport::getChunkSentSizes(Array &ret) {
   for (unsigned int i = 0; i < m_chunksSentSizes.size(); i++) {
     ret.append(m_chunksSentSizes[i]);
@@ -27,6 +27,8 @@
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
+class SharedVariant;
+
 /**
  * For storing headers and cookies.
  */
@@ -195,6 +197,14 @@ public:
   virtual void sendImpl(const void *data, int size, int code,
                         bool chunked) = 0;
 
+  /**
+   * Send back a whole, unchunked response held in several pieces. By
+   * default they are joined and passed to sendImpl(). The pieces are freed
+   * once this returns, so whatever is not sent by then must be copied.
+   */
+  virtual void sendSegmentsImpl(const std::vector<StringSlice> &segments,
+                                int size, int code);
+
   /**
    * Override to implement more send end logic.
    */
@@ -279,9 +289,16 @@ public:
   std::string getCookie(const std::string &name);
 
   /**
-   * Test whether client is okay to accept compressed response.
+   * Decide whether and how to compress the response. Returns the coding
+   * chosen, CODING_GZIP or CODING_LZ4, or 0 to send it uncompressed.
    */
-  bool decideCompression();
+  int decideCompression();
+
+  /**
+   * How busy the server handling this request is, as the percentage of its
+   * threads at work. Lower compression levels are picked as it goes up.
+   */
+  void setServerLoad(int percent) { m_serverLoad = percent; }
 
   /**
    * Sending back a response.
@@ -302,6 +319,21 @@ public:
   virtual void sendRaw(void *data, int size, int code = 200,
                        bool compressed = false, bool chunked = false,
                        const char *codeInfo = nullptr);
+  /**
+   * Send a response made of the given pieces, such as the segments of an
+   * output buffer, without joining them when the response is going out
+   * uncompressed and unchunked. A single piece goes straight to sendRaw(),
+   * unless byReference says it stays put until the send is over, as static
+   * content does, and can be written out from its own memory as well.
+   */
+  void sendRawSegments(const std::vector<StringSlice> &segments,
+                       int code = 200, bool byReference = false);
+  /**
+   * In-process transports can take a return value as a SharedVariant instead
+   * of encoded bytes. On success the transport owns the reference; the
+   * response still has to be ended by sending it.
+   */
+  virtual bool setSharedResult(SharedVariant *result) { return false; }
 private:
   void sendStringLocked(const char *data, int code = 200,
                         bool compressed = false, bool chunked = false,
@@ -332,12 +364,16 @@ public:
 
   int getResponseTotalSize() const { return m_responseTotalSize; }
   int getResponseSentSize() const { return m_responseSentSize; }
+  int getResponseCopiedSize() const { return m_responseCopiedSize; }
+  int getResponseZeroCopySize() const { return m_responseZeroCopySize; }
   int64 getFlushTime() const { return m_flushTimeUs; }
   int getLastChunkSentSize();
   void getChunkSentSizes(Array &ret);
   void onFlushBegin(int totalSize) { m_responseTotalSize = totalSize; }
   void onFlushProgress(int writtenSize, int64 delayUs);
   void onChunkedProgress(int writtenSize);
+  void onCopyProgress(int copiedSize);
+  void onZeroCopyProgress(int sentSize);
 
   void setThreadType(ThreadType type) { m_threadType = type;}
   ThreadType getThreadType() const { return m_threadType;}
@@ -389,6 +425,8 @@ protected:
   int m_responseSize;
   int m_responseTotalSize; // including added headers
   int m_responseSentSize;
+  int m_responseCopiedSize; // body bytes copied into the network layer
+  int m_responseZeroCopySize; // body bytes written from their own memory
   int64 m_flushTimeUs;
 
   std::vector<int> m_chunksSentSizes;
@@ -396,7 +434,9 @@ protected:
   std::string m_mimeType;
   bool m_sendContentType;
   bool m_compression;
-  StreamCompressor *m_compressor;
+  int m_compressionMode; // CODING_GZIP or CODING_LZ4
+  int m_serverLoad;      // percentage of the server's threads busy
+  ResponseCompressor *m_compressor;
 
   bool m_isSSL;
 
@@ -419,6 +459,7 @@ protected:
 
   String prepareResponse(const void *data, int size, bool &compressed,
                          bool last);
+  int getCompressionLevel(int size) const;
   bool moveUploadedFileHelper(CStrRef filename, CStrRef destination);
 
 private:
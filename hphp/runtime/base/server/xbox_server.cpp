@@ -20,6 +20,8 @@
 #include <runtime/base/server/satellite_server.h>
 #include <runtime/base/util/libevent_http_client.h>
 #include <runtime/base/server/job_queue_vm_stack.h>
+#include <runtime/base/server/server_stats.h>
+#include <runtime/base/shared/shared_variant.h>
 #include <runtime/ext/ext_json.h>
 #include <util/job_queue.h>
 #include <util/lock.h>
@@ -32,7 +34,8 @@ namespace HPHP {
 class XboxTransport : public Transport, public Synchronizable {
 public:
   XboxTransport(CStrRef message, CStrRef reqInitDoc = "")
-      : m_refCount(0), m_done(false), m_code(0) {
+      : m_refCount(0), m_owner(nullptr), m_done(false), m_code(0),
+        m_sharedResult(nullptr) {
     gettime(CLOCK_MONOTONIC, &m_queueTime);
 
     m_message.append(message.data(), message.size());
@@ -40,6 +43,12 @@ public:
     disableCompression(); // so we don't have to decompress during sendImpl()
   }
 
+  ~XboxTransport() {
+    if (m_sharedResult) {
+      m_sharedResult->decRef();
+    }
+  }
+
   timespec getStartTimer() const { return m_queueTime; }
 
   /**
@@ -90,13 +99,22 @@ public:
     m_done = true;
     notify();
   }
+  virtual bool setSharedResult(SharedVariant *result) {
+    assert(!m_sharedResult);
+    m_sharedResult = result;
+    return true;
+  }
 
   // task interface
   bool isDone() {
     return m_done;
   }
 
-  String getResults(int &code, int timeout_ms = 0) {
+  /**
+   * The return value of a 200, decoded into this request, or the error
+   * message for any other code.
+   */
+  Variant getResults(int &code, int timeout_ms = 0) {
     {
       Lock lock(this);
       while (!m_done) {
@@ -113,8 +131,14 @@ public:
       }
     }
 
-    String response(m_response.c_str(), m_response.size(), CopyString);
     code = m_code;
+    if (code == 200 && m_sharedResult) {
+      return m_sharedResult->toLocal();
+    }
+    String response(m_response.c_str(), m_response.size(), CopyString);
+    if (code == 200) {
+      return f_unserialize(response);
+    }
     return response;
   }
 
@@ -130,8 +154,13 @@ public:
   }
 
   void setHost(const std::string &host) { m_host = host;}
+
+  // the request that started this task, for fair queueing
+  const void *getOwner() const { return m_owner; }
+  void setOwner(const void *owner) { m_owner = owner; }
 private:
   int m_refCount;
+  const void *m_owner;
 
   string m_message;
 
@@ -140,6 +169,7 @@ private:
   int m_code;
   string m_host;
   string m_reqInitDoc;
+  SharedVariant *m_sharedResult; // return value, instead of m_response
 };
 
 class XboxRequestHandler: public RPCRequestHandler {
@@ -169,6 +199,10 @@ struct XboxWorker
                        !s_xbox_prev_req_init_doc->empty();
       *s_xbox_prev_req_init_doc = reqInitDoc;
 
+      timespec now;
+      gettime(CLOCK_MONOTONIC, &now);
+      ServerStats::LogLatency("queue:xbox",
+                              gettime_diff_us(job->getStartTimer(), now));
       job->onRequestStart(job->getStartTimer());
       createRequestHandler(needReset)->handleRequest(job);
       job->decRefCount();
@@ -177,13 +211,19 @@ struct XboxWorker
     }
   }
 private:
+  static RPCRequestHandler::ReturnEncodeType GetReturnEncodeType() {
+    // return values stay in memory, so they don't need to be serialized
+    return RuntimeOption::XboxSharedResults ?
+      RPCRequestHandler::Shared : RPCRequestHandler::Serialize;
+  }
+
   RequestHandler *createRequestHandler(bool needReset = false) {
     if (!*s_xbox_server_info) {
       *s_xbox_server_info = XboxServerInfoPtr(new XboxServerInfo());
     }
     if (RuntimeOption::XboxServerLogInfo) XboxRequestHandler::Info = true;
     s_xbox_request_handler->setServerInfo(*s_xbox_server_info);
-    s_xbox_request_handler->setReturnEncodeType(RPCRequestHandler::Serialize);
+    s_xbox_request_handler->setReturnEncodeType(GetReturnEncodeType());
     if (needReset ||
         s_xbox_request_handler->needReset() ||
         s_xbox_request_handler->incRequest() >
@@ -191,7 +231,7 @@ private:
       Logger::Verbose("resetting xbox request handler");
       s_xbox_request_handler.destroy();
       s_xbox_request_handler->setServerInfo(*s_xbox_server_info);
-      s_xbox_request_handler->setReturnEncodeType(RPCRequestHandler::Serialize);
+      s_xbox_request_handler->setReturnEncodeType(GetReturnEncodeType());
       s_xbox_request_handler->incRequest();
     }
     return s_xbox_request_handler.get();
@@ -262,13 +302,19 @@ bool XboxServer::SendMessage(CStrRef message, Variant &ret, int timeout_ms,
     }
 
     int code = 0;
-    String response = job->getResults(code, timeout_ms);
+    Variant response = job->getResults(code, timeout_ms);
+    if (code > 0) {
+      timespec now;
+      gettime(CLOCK_MONOTONIC, &now);
+      ServerStats::LogLatency("xbox:send",
+                              gettime_diff_us(job->getStartTimer(), now));
+    }
     job->decRefCount(); // i'm done with this job
 
     if (code > 0) {
       ret.set("code", code);
       if (code == 200) {
-        ret.set("response", f_unserialize(response));
+        ret.set("response", response);
       } else {
         ret.set("error", response);
       }
@@ -411,8 +457,9 @@ Object XboxServer::TaskStart(CStrRef msg, CStrRef reqInitDoc /* = "" */) {
   if (transport) {
     job->setHost(transport->getHeader("Host"));
   }
+  job->setOwner(transport);
   assert(s_dispatcher);
-  s_dispatcher->enqueue(job);
+  s_dispatcher->enqueue(job, job->getOwner());
 
   return ret;
 }
@@ -425,13 +472,13 @@ bool XboxServer::TaskStatus(CObjRef task) {
 int XboxServer::TaskResult(CObjRef task, int timeout_ms, Variant &ret) {
   XboxTask *ptask = task.getTyped<XboxTask>();
 
-  int code = 0;
-  String response = ptask->getJob()->getResults(code, timeout_ms);
-  if (code == 200) {
-    ret = f_unserialize(response);
-  } else {
-    ret = response;
+  XboxTransport *job = ptask->getJob();
+  if (!job->isDone()) {
+    // the caller is blocked on this one, so run it before its siblings
+    s_dispatcher->promote(job, job->getOwner());
   }
+  int code = 0;
+  ret = job->getResults(code, timeout_ms);
   return code;
 }
 
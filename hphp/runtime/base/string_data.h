@@ -385,6 +385,8 @@ public:
   static StringData *GetStaticString(const std::string &str);
   static StringData *GetStaticString(const char *str);
   static StringData *GetStaticString(char c);
+  // the static string equal to str if there already is one, or nullptr
+  static StringData *LookupStaticString(const StringData *str);
   static size_t GetStaticStringCount();
 
   /**
@@ -3767,6 +3767,28 @@ void Variant::unserialize(VariableUnserializer *uns) {
       throw Exception("Unknown type '%c'", type);
     }
     break;
+  case 'k':
+    if (uns->getType() == VariableUnserializer::APCSerialize) {
+      String v;
+      v.unserialize(uns);
+      uns->addKey(v);
+      operator=(v);
+    } else {
+      throw Exception("Unknown type '%c'", type);
+    }
+    break;
+  case 't':
+    if (uns->getType() == VariableUnserializer::APCSerialize) {
+      int64 id = uns->readInt();
+      StringData *sd = uns->getKey(id);
+      if (sd == nullptr) {
+        throw Exception("Key id %ld out of range", id);
+      }
+      operator=(sd);
+    } else {
+      throw Exception("Unknown type '%c'", type);
+    }
+    break;
   case 'a':
     {
       Array v = Array::Create();
@@ -27,12 +27,16 @@
 #include <runtime/base/taint/taint_observer.h>
 #include <runtime/ext/ext_json.h>
 
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
+
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
 
 StringBuffer::StringBuffer(int initialSize /* = 63 */)
   : m_initialCap(initialSize), m_maxBytes(kDefaultOutputLimit),
-    m_len(0) {
+    m_len(0), m_segmentSize(0), m_segmentsLen(0) {
   assert(initialSize > 0);
   m_str = NEW(StringData)(initialSize);
   MutableSlice s = m_str->mutableSlice();
@@ -50,6 +54,9 @@ StringBuffer::~StringBuffer() {
 
 const char *StringBuffer::data() const {
   TAINT_OBSERVER_REGISTER_ACCESSED(m_taint_data);
+  if (UNLIKELY(!m_segments.empty())) {
+    const_cast<StringBuffer*>(this)->flatten();
+  }
   if (m_buffer && m_len) {
     m_buffer[m_len] = '\0'; // fixup
     return m_buffer;
@@ -58,6 +65,9 @@ const char *StringBuffer::data() const {
 }
 
 const char *StringBuffer::dataIgnoreTaint() const {
+  if (UNLIKELY(!m_segments.empty())) {
+    const_cast<StringBuffer*>(this)->flatten();
+  }
   if (m_buffer && m_len) {
     m_buffer[m_len] = '\0'; // fixup
     return m_buffer;
@@ -66,6 +76,9 @@ const char *StringBuffer::dataIgnoreTaint() const {
 }
 
 char StringBuffer::charAt(int pos) const {
+  if (UNLIKELY(!m_segments.empty())) {
+    const_cast<StringBuffer*>(this)->flatten();
+  }
   assert(pos >= 0 && pos < m_len);
   if (m_buffer && pos >= 0 && pos < m_len) {
     return m_buffer[pos];
@@ -79,6 +92,7 @@ String StringBuffer::detachImpl() {
   m_taint_data.unsetTaint(TAINT_BIT_ALL);
 #endif
 
+  if (!m_segments.empty()) flatten();
   if (m_buffer && m_len) {
     assert(m_str && m_str->getCount() == 0);
     m_buffer[m_len] = '\0'; // fixup
@@ -114,6 +128,8 @@ void StringBuffer::absorb(StringBuffer &buf) {
     m_buffer = buf.m_buffer;
     m_len = buf.m_len;
     m_cap = buf.m_cap;
+    m_segments.swap(buf.m_segments);
+    std::swap(m_segmentsLen, buf.m_segmentsLen);
 
     buf.m_str = str;
     if (str) {
@@ -134,6 +150,8 @@ void StringBuffer::absorb(StringBuffer &buf) {
 
 void StringBuffer::reset() {
   m_len = 0;
+  m_segments.clear();
+  m_segmentsLen = 0;
 #ifdef TAINTED
   m_taint_data.unsetTaint(TAINT_BIT_ALL);
 #endif
@@ -147,9 +165,13 @@ void StringBuffer::release() {
   m_str = 0;
   m_buffer = 0;
   m_len = m_cap = 0;
+  m_segments.clear();
+  m_segmentsLen = 0;
 }
 
 void StringBuffer::resize(int size) {
+  if (size < m_segmentsLen) flatten();
+  size -= m_segmentsLen;
   assert(size >= 0 && size < m_cap);
   if (size >= 0 && size < m_cap) {
     m_len = size;
@@ -244,6 +266,49 @@ void StringBuffer::appendHelper(const char *s, int len) {
   (((us & 0xf) << 12)      | (((us >> 4) & 0xf) << 8) |   \
   (((us >> 8) & 0xf) << 4) | ((us >> 12) & 0xf))          \
 
+/**
+ * Printable ASCII that appendJsonEscape() copies through unchanged no matter
+ * which options are set.
+ */
+static inline bool json_plain_char(unsigned char c) {
+  if (c < ' ' || c >= 128) return false;
+  switch (c) {
+  case '"': case '\\': case '/': case '<': case '>':
+  case '&': case '\'': case '@': case '%':
+    return false;
+  default:
+    return true;
+  }
+}
+
+/**
+ * Length of the run of json_plain_char() bytes at the start of s.
+ */
+static int json_plain_run(const char *s, int len) {
+  int i = 0;
+#ifdef __x86_64__
+  const __m128i ctrl = _mm_set1_epi8(' ' - 1);
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+    // signed compare also rejects bytes >= 128
+    __m128i bad = _mm_cmpgt_epi8(ctrl, v);
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('@')));
+    bad = _mm_or_si128(bad, _mm_cmpeq_epi8(v, _mm_set1_epi8('%')));
+    int mask = _mm_movemask_epi8(bad);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+#endif
+  while (i < len && json_plain_char(s[i])) i++;
+  return i;
+}
+
 void StringBuffer::appendJsonEscape(const char *s, int len, int options) {
   if (len == 0) {
     append("\"\"", 2);
@@ -255,6 +320,14 @@ void StringBuffer::appendJsonEscape(const char *s, int len, int options) {
 
     UTF8To16Decoder decoder(s, len, options & k_JSON_FB_LOOSE);
     for (;;) {
+      int pos = decoder.position();
+      if (pos >= 0 && pos < len) {
+        int run = json_plain_run(s + pos, len - pos);
+        if (run) {
+          append(s + pos, run);
+          decoder.skip(run);
+        }
+      }
       int c = decoder.decode();
       if (c == UTF8_END) {
         append('"');
@@ -420,6 +493,24 @@ void StringBuffer::growBy(int spaceRequired) {
     new_size = minSize;
   }
 
+  if (m_segmentSize && m_len && m_cap >= m_segmentSize) {
+    if (m_maxBytes > 0 &&
+        (long)m_segmentsLen + m_len + spaceRequired > m_maxBytes) {
+      throw StringBufferLimitException(m_maxBytes, detach());
+    }
+    // seal the full buffer and continue in a new one
+    m_buffer[m_len] = 0;
+    m_str->setSize(m_len);
+    m_segments.push_back(String(m_str));
+    m_segmentsLen += m_len;
+    m_str = NEW(StringData)(std::max(m_segmentSize, spaceRequired));
+    MutableSlice s = m_str->mutableSlice();
+    m_buffer = s.ptr;
+    m_cap = s.len;
+    m_len = 0;
+    return;
+  }
+
   if (m_maxBytes > 0 && new_size > m_maxBytes) {
     if (minSize > m_maxBytes) {
       throw StringBufferLimitException(m_maxBytes, detach());
@@ -435,6 +526,36 @@ void StringBuffer::growBy(int spaceRequired) {
   m_cap = s.len;
 }
 
+void StringBuffer::flatten() {
+  int total = size();
+  StringData *str = NEW(StringData)(total);
+  MutableSlice s = str->mutableSlice();
+  char *p = s.ptr;
+  for (unsigned int i = 0; i < m_segments.size(); i++) {
+    memcpy(p, m_segments[i].data(), m_segments[i].size());
+    p += m_segments[i].size();
+  }
+  if (m_len) memcpy(p, m_buffer, m_len);
+  m_segments.clear();
+  m_segmentsLen = 0;
+
+  if (m_str) {
+    m_buffer[m_len] = 0; // appease StringData::checkSane()
+    DELETE(StringData)(m_str);
+  }
+  m_str = str;
+  m_buffer = s.ptr;
+  m_cap = s.len;
+  m_len = total;
+}
+
+void StringBuffer::getSegments(std::vector<StringSlice> &segments) const {
+  for (unsigned int i = 0; i < m_segments.size(); i++) {
+    segments.push_back(m_segments[i].slice());
+  }
+  if (m_len) segments.push_back(StringSlice(m_buffer, m_len));
+}
+
 CstrBuffer::CstrBuffer(int cap)
   : m_buffer((char*)Util::safe_malloc(cap + 1)), m_len(0), m_cap(cap) {
   assert(unsigned(cap) <= kMaxCap);
@@ -54,10 +54,25 @@ public:
     m_maxBytes = maxBytes > 0 ? maxBytes : kDefaultOutputLimit;
   }
 
+  /**
+   * Segmented mode: once the buffer holds segmentSize bytes it is sealed and
+   * appending continues into a fresh one, so large outputs are not copied
+   * each time the buffer doubles. The segments are joined only when
+   * contiguous data is asked for; getSegments() hands them out as they are.
+   * TAINTED builds stay contiguous: the taint observer is handed the whole
+   * buffer on every append, which would join the segments each time.
+   */
+  void setSegmentSize(int segmentSize) {
+#ifndef TAINTED
+    m_segmentSize = segmentSize;
+#endif
+  }
+  void getSegments(std::vector<StringSlice> &segments) const;
+
   bool valid() const { return m_buffer != nullptr;}
-  bool empty() const { return m_len == 0;}
-  int size() const { return m_len;}
-  int length() const { return m_len;}
+  bool empty() const { return size() == 0;}
+  int size() const { return m_segmentsLen + m_len;}
+  int length() const { return size();}
   const char *data() const;
 private:
   // This method is only used internally for particular operations which do
@@ -185,11 +200,15 @@ private:
   int m_maxBytes;
   int m_cap;
   int m_len;
+  int m_segmentSize;               // 0 unless in segmented mode
+  int m_segmentsLen;               // bytes in m_segments
+  std::vector<String> m_segments;  // sealed segments, oldest first
 #ifdef TAINTED
   TaintData m_taint_data;
 #endif
 
   void growBy(int spaceRequired);
+  void flatten();
 };
 
 /**
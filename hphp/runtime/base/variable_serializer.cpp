@@ -36,13 +36,16 @@ namespace HPHP {
 static StaticString s_JsonSerializable("JsonSerializable");
 static StaticString s_jsonSerialize("jsonSerialize");
 
+// beyond this many distinct keys in one value, new keys are written plainly
+static const int kMaxInternedKeys = 64 * 1024;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 VariableSerializer::VariableSerializer(Type type, int option /* = 0 */,
                                        int maxRecur /* = 3 */)
   : m_type(type), m_option(option), m_buf(nullptr), m_indent(0),
     m_valueCount(0), m_referenced(false), m_refCount(1), m_maxCount(maxRecur),
-    m_levelDebugger(0) {
+    m_levelDebugger(0), m_flushSize(0), m_keyIds(nullptr) {
   m_maxLevelDebugger = g_context->getDebuggerPrintLevel();
   if (type == Serialize || type == APCSerialize || type == DebuggerSerialize) {
     m_arrayIds = new PointerCounterMap();
@@ -99,6 +102,32 @@ String VariableSerializer::serializeValue(CVarRef v, bool limit) {
   return m_buf->detach();
 }
 
+void VariableSerializer::serializeToOutput(CVarRef v, int flushSize,
+                                           bool limit) {
+  StringBuffer buf(flushSize + 1024);
+  m_buf = &buf;
+  if (limit) {
+    // Nothing is written until the whole value is known to fit, so going
+    // over the limit leaves no partial output behind. The buffer can't grow
+    // past the limit anyway.
+    buf.setOutputLimit(RuntimeOption::SerializationSizeLimit);
+    m_flushSize = 0;
+  } else {
+    m_flushSize = flushSize;
+  }
+  m_valueCount = 1;
+  write(v);
+  flushToOutput();
+  m_flushSize = 0;
+}
+
+void VariableSerializer::flushToOutput() {
+  if (!m_buf->empty()) {
+    g_context->write(m_buf->data(), m_buf->size());
+    m_buf->clear();
+  }
+}
+
 String VariableSerializer::serializeWithLimit(CVarRef v, int limit) {
   if (m_type == Serialize || m_type == JSON || m_type == APCSerialize ||
       m_type == DebuggerSerialize) {
@@ -664,12 +693,45 @@ void VariableSerializer::writePropertyKey(CStrRef prop) {
   }
 }
 
+/*
+ * Arrays of records repeat the same keys over and over, so in APCSerialize
+ * the first occurrence of a key is written as k:<len>:"<key>"; and every
+ * later one as t:<n>; with n counting k: entries from 0. The unserializer
+ * builds the same table and shares one StringData among all the copies.
+ */
+void VariableSerializer::writeInternedKey(CStrRef key) {
+  if (!m_keyIds) m_keyIds = new StringDataIdMap();
+  StringDataIdMap::const_iterator it = m_keyIds->find(key.get());
+  if (it != m_keyIds->end()) {
+    m_buf->append("t:");
+    m_buf->append(it->second);
+    m_buf->append(';');
+    return;
+  }
+  if ((int)m_keys.size() < kMaxInternedKeys) {
+    (*m_keyIds)[key.get()] = m_keys.size();
+    m_keys.push_back(key);
+    m_buf->append("k:");
+  } else {
+    m_buf->append("s:");
+  }
+  m_buf->append(key.size());
+  m_buf->append(":\"");
+  m_buf->append(key.data(), key.size());
+  m_buf->append("\";");
+}
+
 /* key MUST be a non-reference string or int */
 void VariableSerializer::writeArrayKey(Variant key) {
   Variant::TypedValueAccessor tva = key.getTypedAccessor();
   bool skey = Variant::IsString(tva);
   if (skey && m_type == APCSerialize) {
-    write(Variant::GetAsString(tva));
+    CStrRef s = Variant::GetAsString(tva);
+    if (s->isStatic()) {
+      write(s);
+    } else {
+      writeInternedKey(s);
+    }
     return;
   }
   ArrayInfo &info = m_arrayInfos.back();
@@ -775,6 +837,10 @@ void VariableSerializer::writeArrayValue(CVarRef value) {
 
   ArrayInfo &info = m_arrayInfos.back();
   info.first_element = false;
+
+  if (m_flushSize && m_buf->size() >= m_flushSize) {
+    flushToOutput();
+  }
 }
 
 void VariableSerializer::writeArrayFooter() {
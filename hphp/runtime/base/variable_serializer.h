@@ -56,6 +56,7 @@ public:
   VariableSerializer(Type type, int option = 0, int maxRecur = 3);
   ~VariableSerializer() {
     if (m_arrayIds) delete m_arrayIds;
+    if (m_keyIds) delete m_keyIds;
   }
 
   /**
@@ -64,6 +65,13 @@ public:
   String serialize(CVarRef v, bool ret);
   String serializeValue(CVarRef v, bool limit);
 
+  // Serialize straight to the current output, handing the buffered text
+  // over whenever an array element leaves more than flushSize bytes in it,
+  // so large values are never materialized as a single string. With limit,
+  // the value is held to SerializationSizeLimit as in serialize(), and only
+  // written once it is complete, so a value over the limit writes nothing.
+  void serializeToOutput(CVarRef v, int flushSize, bool limit);
+
   // Serialize with limit size of output, always return the serialized string.
   // It does not work with Serialize, JSON, APCSerialize, DebuggerSerialize.
   String serializeWithLimit(CVarRef v, int limit);
@@ -124,6 +132,16 @@ private:
   int m_maxCount;                // for max recursive levels
   int m_levelDebugger;           // keep track of levels for DebuggerSerialize
   int m_maxLevelDebugger;        // for max level of DebuggerSerialize
+  int m_flushSize;               // serializeToOutput() chunk size, or 0
+
+  // APCSerialize writes each distinct non-static array key once, and
+  // refers back to it by index after that
+  typedef hphp_hash_map<const StringData*, int, string_data_hash,
+                        string_data_same> StringDataIdMap;
+  StringDataIdMap *m_keyIds;     // key -> index into m_keys
+  std::vector<String> m_keys;    // keeps the interned keys alive
+
+  void flushToOutput();
 
   struct ArrayInfo {
     bool is_object;     // nested arrays or objects
@@ -134,6 +152,7 @@ private:
   std::vector<ArrayInfo> m_arrayInfos;
 
   void writePropertyKey(CStrRef prop);
+  void writeInternedKey(CStrRef key);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -17,6 +17,7 @@
 #include <runtime/base/variable_unserializer.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/zend/zend_strtod.h>
+#include <runtime/base/runtime_option.h>
 
 
 namespace HPHP {
@@ -28,7 +29,19 @@ Variant VariableUnserializer::unserialize() {
   return v;
 }
 
+// at most this many distinct keys are remembered per unserialize call
+static const size_t kMaxSharedKeys = 4096;
+
 Variant VariableUnserializer::unserializeKey() {
+  if (m_end - m_buf > 2 && m_buf[0] == 's' && m_buf[1] == ':') {
+    m_buf += 2;
+    String key = unserializeStringKey();
+    char sep = readChar();
+    if (sep != ';') {
+      throw Exception("Expected ';' but got '%c'", sep);
+    }
+    return key;
+  }
   m_key = true;
   Variant v;
   v.unserialize(this);
@@ -36,6 +49,56 @@ Variant VariableUnserializer::unserializeKey() {
   return v;
 }
 
+/*
+ * Parses the rest of s:<len>:"<key>" like String::unserialize() does. Rows
+ * of the same shape repeat their keys, so each distinct key is allocated
+ * only once per call, and not at all when it is already a static string.
+ */
+String VariableUnserializer::unserializeStringKey() {
+  int64 size = readInt();
+  if (size >= RuntimeOption::MaxSerializedStringSize) {
+    throw Exception("Size of serialized string (%d) exceeds max", int(size));
+  }
+  if (size < 0) {
+    throw Exception("Size of serialized string (%d) must not be negative",
+                    int(size));
+  }
+  char ch = readChar();
+  if (ch != ':') {
+    throw Exception("Expected ':' but got '%c'", ch);
+  }
+  ch = readChar();
+  if (ch != '"') {
+    throw Exception("Expected '\"' but got '%c'", ch);
+  }
+  if (size > m_end - m_buf) {
+    throw Exception("Unexpected end of buffer during unserialization");
+  }
+
+  String key;
+  {
+    StackStringData probe(m_buf, size, AttachLiteral);
+    KeySet::const_iterator it = m_keySet.find(&probe);
+    if (it != m_keySet.end()) {
+      key = const_cast<StringData*>(*it);
+    } else {
+      StringData *sd = StringData::LookupStaticString(&probe);
+      key = sd ? sd : NEW(StringData)(m_buf, size, CopyString);
+      if (m_keySet.size() < kMaxSharedKeys) {
+        m_keySet.insert(key.get());
+        if (!sd) m_keyStrings.push_back(key);
+      }
+    }
+  }
+  m_buf += size;
+
+  ch = readChar();
+  if (ch != '"') {
+    throw Exception("Expected '\"' but got '%c'", ch);
+  }
+  return key;
+}
+
 int64 VariableUnserializer::readInt() {
   check();
   char *newBuf;
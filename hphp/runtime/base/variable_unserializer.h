@@ -18,6 +18,7 @@
 #define __HPHP_VARIABLE_UNSERIALIZER_H__
 
 #include <runtime/base/types.h>
+#include <runtime/base/type_string.h>
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -56,6 +57,12 @@ public:
     if (id <= 0  || id > (int)m_refs.size()) return nullptr;
     return m_refs[id-1];
   }
+  // interned array keys of the APCSerialize format
+  void addKey(CStrRef key) { m_keys.push_back(key); }
+  StringData *getKey(int64 id) {
+    if (id < 0 || id >= (int64)m_keys.size()) return nullptr;
+    return m_keys[id].get();
+  }
   int64 readInt();
   double readDouble();
   char readChar() {
@@ -76,9 +83,17 @@ public:
   const char *m_end;
   std::vector<Variant*> m_refs;
   std::list<Variant> m_vars;
+  std::vector<String> m_keys;
+  // string keys seen so far, so repeats share one StringData
+  typedef hphp_hash_set<const StringData*, string_data_hash,
+                        string_data_same> KeySet;
+  KeySet m_keySet;
+  std::vector<String> m_keyStrings; // owns the non-static members of m_keySet
   bool m_key;
   bool m_unknownSerializable;
 
+  String unserializeStringKey();
+
   void check() {
     if (m_buf >= m_end) {
       throw Exception("Unexpected end of buffer during unserialization");
@@ -38,6 +38,19 @@ public:
   UTF8To16Decoder(const char *utf8, int length, bool loose);
   int decode();
 
+  /**
+   * Byte offset of the next undecoded character, or -1 while the second
+   * half of a surrogate pair is still pending. Callers that consume plain
+   * ASCII runs directly use skip() to step over them.
+   */
+  int position() const {
+    return m_low_surrogate ? -1 : m_decode.the_index;
+  }
+  void skip(int n) {
+    m_decode.the_index += n;
+    m_decode.the_char += n;
+  }
+
 private:
   json_utf8_decode m_decode;
   int m_loose; // Faceook: json_utf8_loose
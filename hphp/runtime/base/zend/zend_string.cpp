@@ -23,6 +23,10 @@
 #include <math.h>
 #include <monetary.h>
 
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
+
 #include <runtime/base/bstring.h>
 #include <runtime/base/util/exceptions.h>
 #include <runtime/base/complex_types.h>
@@ -51,6 +55,49 @@
 #define PHP_QPRINT_MAXL 75
 
 namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+// SIMD helpers
+//
+// SSE2 is part of the x86_64 baseline, so these need no runtime CPU
+// dispatch; other targets use the scalar loops that follow each one.
+
+#ifdef __x86_64__
+/*
+ * Bitmask of the bytes in a 16-byte block equal to any of a, b, c or d.
+ */
+static inline unsigned simd_match4(__m128i block, __m128i a, __m128i b,
+                                   __m128i c, __m128i d) {
+  __m128i m = _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(block, a), _mm_cmpeq_epi8(block, b)),
+    _mm_or_si128(_mm_cmpeq_epi8(block, c), _mm_cmpeq_epi8(block, d)));
+  return _mm_movemask_epi8(m);
+}
+#endif
+
+/*
+ * Returns the first byte in [p, end) equal to a, b, c or d, or end.
+ */
+static const char *find_first_of4(const char *p, const char *end,
+                                  char a, char b, char c, char d) {
+#ifdef __x86_64__
+  __m128i va = _mm_set1_epi8(a);
+  __m128i vb = _mm_set1_epi8(b);
+  __m128i vc = _mm_set1_epi8(c);
+  __m128i vd = _mm_set1_epi8(d);
+  for (; end - p >= 16; p += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)p);
+    unsigned mask = simd_match4(block, va, vb, vc, vd);
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; p < end; p++) {
+    if (*p == a || *p == b || *p == c || *p == d) break;
+  }
+  return p;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // helpers
 
@@ -286,11 +333,56 @@ int string_natural_cmp(char const *a, size_t a_len,
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifdef __x86_64__
+/*
+ * Checks whether tocase behaves like plain ASCII tolower (returns 1) or
+ * toupper (returns 2) on the ASCII range in the current locale, so
+ * that ASCII blocks can be converted 16 bytes at a time.
+ */
+static int ascii_case_mode(int (*tocase)(int)) {
+  bool lower = true, upper = true;
+  for (int c = 0; c < 128 && (lower || upper); c++) {
+    int mapped = tocase(c);
+    if (mapped != (c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c)) {
+      lower = false;
+    }
+    if (mapped != (c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c)) {
+      upper = false;
+    }
+  }
+  return lower ? 1 : upper ? 2 : 0;
+}
+#endif
+
 char *string_to_case(const char *s, int len, int (*tocase)(int)) {
   assert(s);
   assert(tocase);
   char *ret = (char *)malloc(len + 1);
-  for (int i = 0; i < len; i++) {
+  int i = 0;
+#ifdef __x86_64__
+  // Probing tocase costs 128 calls; only worth it for longer strings.
+  int mode = len >= 128 ? ascii_case_mode(tocase) : 0;
+  if (mode) {
+    __m128i lo = _mm_set1_epi8((mode == 1 ? 'A' : 'a') - 1);
+    __m128i hi = _mm_set1_epi8((mode == 1 ? 'Z' : 'z') + 1);
+    __m128i flip = _mm_set1_epi8('a' - 'A');
+    for (; i + 16 <= len; i += 16) {
+      __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+      if (_mm_movemask_epi8(block)) {
+        // Non-ASCII bytes are locale dependent; leave them to tocase.
+        for (int j = i; j < i + 16; j++) {
+          ret[j] = tocase(s[j]);
+        }
+        continue;
+      }
+      __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(block, lo),
+                                      _mm_cmpgt_epi8(hi, block));
+      block = _mm_xor_si128(block, _mm_and_si128(inRange, flip));
+      _mm_storeu_si128((__m128i *)(ret + i), block);
+    }
+  }
+#endif
+  for (; i < len; i++) {
     ret[i] = tocase(s[i]);
   }
   ret[len] = '\0';
@@ -534,6 +626,28 @@ const char *string_memnstr(const char *haystack, const char *needle,
   const char *p = haystack;
   char ne = needle[needle_len-1];
 
+#ifdef __x86_64__
+  if (needle_len > 1) {
+    // Test 16 candidate positions at once against the first and last
+    // needle bytes, and only memcmp the positions where both match.
+    __m128i first = _mm_set1_epi8(*needle);
+    __m128i last = _mm_set1_epi8(ne);
+    for (; end - p >= needle_len + 15; p += 16) {
+      __m128i b0 = _mm_loadu_si128((const __m128i *)p);
+      __m128i b1 = _mm_loadu_si128((const __m128i *)(p + needle_len - 1));
+      unsigned mask = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(b0, first), _mm_cmpeq_epi8(b1, last)));
+      while (mask) {
+        int bit = __builtin_ctz(mask);
+        if (!memcmp(p + bit + 1, needle + 1, needle_len - 2)) {
+          return p + bit;
+        }
+        mask &= mask - 1;
+      }
+    }
+  }
+#endif
+
   end -= needle_len;
   while (p <= end) {
     if ((p = (char *)memchr(p, *needle, (end-p+1))) && ne == p[needle_len-1]) {
@@ -1057,8 +1171,15 @@ char *string_strip_tags(const char *s, int &len, const char *allow,
   assert(allow);
 
   char *ret = string_duplicate(s, len);
+  // Everything before the first '<' or NUL is output as-is and leaves
+  // the state machine in its initial state, so skip straight to it.
+  int skip = find_first_of4(s, s + len, '<', '\0', '<', '\0') - s;
+  if (skip == len) {
+    return ret;
+  }
   char *sallow = string_duplicate(allow, allow_len);
-  len = strip_tags_impl(ret, len, nullptr, sallow, allow_len, false);
+  len = skip + strip_tags_impl(ret + skip, len - skip, nullptr,
+                               sallow, allow_len, false);
   free(sallow);
   return ret;
 }
@@ -1312,6 +1433,13 @@ char *string_addslashes(const char *str, int &length) {
   char *target = new_str;
 
   while (source < end) {
+    // Bulk-copy the run of bytes that need no escaping.
+    const char *special = find_first_of4(source, end, '\0', '\'', '\"', '\\');
+    memcpy(target, source, special - source);
+    target += special - source;
+    source = special;
+    if (source == end) break;
+
     switch (*source) {
     case '\0':
       *target++ = '\\';
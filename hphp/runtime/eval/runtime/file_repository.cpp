@@ -19,6 +19,7 @@
 #include <runtime/base/zend/zend_string.h>
 #include <util/process.h>
 #include <util/trace.h>
+#include <util/util.h>
 #include <runtime/base/stat_cache.h>
 #include <runtime/base/server/source_root_info.h>
 
@@ -91,6 +92,8 @@ ReadWriteMutex FileRepository::s_md5Lock(RankFileMd5);
 ParsedFilesMap FileRepository::s_files;
 Md5FileMap FileRepository::s_md5Files;
 UnitMd5Map FileRepository::s_unitMd5Map;
+ReadWriteMutex FileRepository::s_sharedLock;
+SharedUnitMap FileRepository::s_sharedUnits;
 
 static class FileDumpInitializer {
   public: FileDumpInitializer() {
@@ -123,7 +126,17 @@ void FileRepository::onDelete(PhpFile *f) {
   assert(f->getRef() == 0);
   if (md5Enabled()) {
     WriteLock lock(s_md5Lock);
-    s_md5Files.erase(f->getMd5());
+    Md5FileMap::iterator it = s_md5Files.find(f->getMd5());
+    if (it != s_md5Files.end() && it->second == f) {
+      s_md5Files.erase(it);
+    }
+  }
+  if (RuntimeOption::SandboxShareUnits && !f->getRelPath().empty()) {
+    WriteLock lock(s_sharedLock);
+    SharedUnitMap::iterator it = s_sharedUnits.find(f->unit());
+    if (it != s_sharedUnits.end() && it->second.m_phpFile == f) {
+      s_sharedUnits.erase(it);
+    }
   }
   delete f;
 }
@@ -169,6 +182,7 @@ PhpFile *FileRepository::checkoutFile(StringData *rname,
   bool isNew = s_files.insert(acc, n);
   assert(isNew || acc->second); // We don't leave null entries around.
   bool isChanged = !isNew && acc->second->isChanged(s);
+  bool reused = false;
 
   if (isNew || isChanged) {
     if (!readFile(n, s, fileInfo)) {
@@ -179,6 +193,9 @@ PhpFile *FileRepository::checkoutFile(StringData *rname,
       return nullptr;
     }
     ret = fileInfo.m_phpFile;
+    // A PhpFile found by md5 is already registered (possibly under
+    // another sandbox's path) and owns a cache id.
+    reused = ret != nullptr;
     if (isChanged && ret == acc->second->getPhpFile()) {
       // The file changed but had the same contents.
       if (debug && md5Enabled()) {
@@ -216,11 +233,15 @@ PhpFile *FileRepository::checkoutFile(StringData *rname,
   if (isNew) {
     acc->second = new PhpFileWrapper(s, ret);
     ret->incRef();
-    ret->setId(VM::Transl::TargetCache::allocBit());
+    if (!reused) {
+      ret->setId(VM::Transl::TargetCache::allocBit());
+    }
   } else {
     PhpFile *f = acc->second->getPhpFile();
     if (f != ret) {
-      ret->setId(f->getId());
+      if (!reused) {
+        ret->setId(f->getId());
+      }
       tx64->invalidateFile(f); // f has changed
     }
     f->decRefAndDelete();
@@ -285,6 +306,60 @@ String FileRepository::translateFileName(StringData *file) {
   return file;
 }
 
+PhpFile *FileRepository::registerSharedUnit(PhpFile *f) {
+  if (!RuntimeOption::SandboxShareUnits || f->getRelPath().empty()) return f;
+  VM::Unit *unit = f->unit();
+  WriteLock lock(s_sharedLock);
+  SharedUnitInfo &info = s_sharedUnits[unit];
+  info.m_phpFile = f;
+  info.m_relPath = f->getRelPath();
+  SandboxPaths &paths = info.m_paths[f->getSrcRoot()];
+  paths.m_file = unit->filepathRef();
+  paths.m_dir = unit->dirpathRef();
+  return f;
+}
+
+const SandboxPaths *FileRepository::sandboxPaths(const VM::Unit *unit) {
+  // The returned entry stays valid while the unit is in use: it is only
+  // erased when the unit's PhpFile is deleted.
+  const string &srcRoot = SourceRootInfo::GetCurrentSourceRoot();
+  if (srcRoot.empty()) return nullptr;
+  string relPath;
+  {
+    ReadLock lock(s_sharedLock);
+    SharedUnitMap::const_iterator it = s_sharedUnits.find(unit);
+    if (it == s_sharedUnits.end()) return nullptr;
+    const SharedUnitInfo &info = it->second;
+    hphp_hash_map<string, SandboxPaths, string_hash>::const_iterator pit =
+      info.m_paths.find(srcRoot);
+    if (pit != info.m_paths.end()) return &pit->second;
+    relPath = info.m_relPath;
+  }
+  // First time this unit runs under this root.
+  string file = srcRoot + relPath;
+  StringData *sfile = StringData::GetStaticString(file);
+  StringData *sdir = StringData::GetStaticString(Util::safe_dirname(file));
+  WriteLock lock(s_sharedLock);
+  SharedUnitMap::iterator it = s_sharedUnits.find(unit);
+  if (it == s_sharedUnits.end()) return nullptr;
+  SandboxPaths &paths = it->second.m_paths[srcRoot];
+  paths.m_file = sfile;
+  paths.m_dir = sdir;
+  return &paths;
+}
+
+CStrRef FileRepository::unitFilePath(const VM::Unit *unit) {
+  if (LIKELY(!RuntimeOption::SandboxShareUnits)) return unit->filepathRef();
+  const SandboxPaths *paths = sandboxPaths(unit);
+  return paths ? paths->m_file : unit->filepathRef();
+}
+
+CStrRef FileRepository::unitDirPath(const VM::Unit *unit) {
+  if (LIKELY(!RuntimeOption::SandboxShareUnits)) return unit->dirpathRef();
+  const SandboxPaths *paths = sandboxPaths(unit);
+  return paths ? paths->m_dir : unit->dirpathRef();
+}
+
 string FileRepository::unitMd5(const string& fileMd5) {
   // Incorporate relevant options into the unit md5 (there will be more)
   char* md5str;
@@ -306,11 +381,28 @@ void FileRepository::setFileInfo(const StringData *name,
                                  bool fromRepo) {
   int md5len;
   char* md5str;
+
+  fileInfo.m_srcRoot = SourceRootInfo::GetCurrentSourceRoot();
+  int srcRootLen = fileInfo.m_srcRoot.size();
+  if (srcRootLen) {
+    if (!strncmp(name->data(), fileInfo.m_srcRoot.c_str(), srcRootLen)) {
+      fileInfo.m_relPath = string(name->data() + srcRootLen);
+    }
+  }
+
   // Incorporate the path into the md5 that is used as the key for file
   // repository lookups.  This assures that even if two PHP files have
   // identical content, separate units exist for them (so that
-  // Unit::filepath() and Unit::dirpath() work correctly).
-  string s = md5 + '\0' + name->data();
+  // Unit::filepath() and Unit::dirpath() work correctly).  When sandboxes
+  // share units, only the path relative to the source root is used, so
+  // the same file checked out in several sandboxes maps to one unit; the
+  // path dependent bits are fixed up by unitFilePath() and unitDirPath().
+  string s = md5 + '\0';
+  if (RuntimeOption::SandboxShareUnits && !fileInfo.m_relPath.empty()) {
+    s += fileInfo.m_relPath;
+  } else {
+    s += name->data();
+  }
   md5str = string_md5(s.c_str(), s.size(), false, md5len);
   fileInfo.m_md5 = string(md5str, md5len);
   free(md5str);
@@ -321,14 +413,6 @@ void FileRepository::setFileInfo(const StringData *name,
     fileInfo.m_unitMd5 = unitMd5(md5);
   }
 
-  fileInfo.m_srcRoot = SourceRootInfo::GetCurrentSourceRoot();
-  int srcRootLen = fileInfo.m_srcRoot.size();
-  if (srcRootLen) {
-    if (!strncmp(name->data(), fileInfo.m_srcRoot.c_str(), srcRootLen)) {
-      fileInfo.m_relPath = string(name->data() + srcRootLen);
-    }
-  }
-
   ReadLock lock(s_md5Lock);
   Md5FileMap::iterator it = s_md5Files.find(fileInfo.m_md5);
   if (it != s_md5Files.end()) {
@@ -424,7 +508,7 @@ PhpFile *FileRepository::readHhbc(const std::string &name,
   if (u != nullptr) {
     PhpFile *p = new PhpFile(name, fileInfo.m_srcRoot, fileInfo.m_relPath,
                              fileInfo.m_md5, u);
-    return p;
+    return registerSharedUnit(p);
   }
 
   return nullptr;
@@ -438,7 +522,7 @@ PhpFile *FileRepository::parseFile(const std::string &name,
                                     md5, name.c_str());
   PhpFile *p = new PhpFile(name, fileInfo.m_srcRoot, fileInfo.m_relPath,
                            fileInfo.m_md5, unit);
-  return p;
+  return registerSharedUnit(p);
 }
 
 bool FileRepository::fileStat(const string &name, struct stat *s) {
@@ -122,6 +122,25 @@ typedef RankedCHM<const StringData*, HPHP::Eval::PhpFileWrapper*,
                   StringDataHashCompare, RankFileRepo> ParsedFilesMap;
 typedef hphp_hash_map<std::string, PhpFile*, string_hash> Md5FileMap;
 
+/**
+ * A unit shared by sandboxes (Sandbox.ShareUnits) remembers its path
+ * relative to the source root, and the file and directory it has under
+ * each root that ran it, so each root's paths are built only once.
+ */
+struct SandboxPaths {
+  String m_file;
+  String m_dir;
+};
+
+struct SharedUnitInfo {
+  PhpFile *m_phpFile;
+  std::string m_relPath;
+  hphp_hash_map<std::string, SandboxPaths, string_hash> m_paths;
+};
+
+typedef hphp_hash_map<const VM::Unit*, SharedUnitInfo,
+                      pointer_hash<VM::Unit> > SharedUnitMap;
+
 /**
  * FileRepository is global.
  */
@@ -156,6 +175,14 @@ public:
   static PhpFile *readHhbc(const std::string &name, const FileInfo &fileInfo);
   static PhpFile *parseFile(const std::string &name, const FileInfo &fileInfo);
   static String translateFileName(StringData *file);
+  /**
+   * The file and directory of a unit as seen by the current request.
+   * These differ from Unit::filepath() and Unit::dirpath() only for a
+   * unit shared by sandboxes (Sandbox.ShareUnits) that runs under a
+   * root other than the one it was parsed in.
+   */
+  static CStrRef unitFilePath(const VM::Unit *unit);
+  static CStrRef unitDirPath(const VM::Unit *unit);
   static void enableIntercepts();
   static void onDelete(PhpFile *f);
   static void forEachUnit(VM::UnitVisitor& uit);
@@ -165,6 +192,11 @@ private:
   static UnitMd5Map s_unitMd5Map;
   static ReadWriteMutex s_md5Lock;
   static Md5FileMap s_md5Files;
+  static ReadWriteMutex s_sharedLock;
+  static SharedUnitMap s_sharedUnits;
+
+  static PhpFile *registerSharedUnit(PhpFile *f);
+  static const SandboxPaths *sandboxPaths(const VM::Unit *unit);
 
   static bool fileStat(const std::string &name, struct stat *s);
   static std::set<std::string> s_names;
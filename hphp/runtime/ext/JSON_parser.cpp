@@ -36,6 +36,10 @@ SOFTWARE.
 
 #include <system/lib/systemlib.h>
 
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
+
 #define MAX_LENGTH_OF_LONG 20
 static const char long_min_digits[] = "9223372036854775808";
 
@@ -430,9 +434,8 @@ static void utf16_to_utf8(StringBuffer &buf, unsigned short utf16) {
   }
 }
 
-static void object_set(Variant &var, StringBuffer &key, CVarRef value,
+static void object_set(Variant &var, CStrRef data, CVarRef value,
                        int assoc) {
-  String data = key.detach();
   if (!assoc) {
     // We know it is stdClass, and everything is public (and dynamic).
     if (data.empty()) {
@@ -445,9 +448,8 @@ static void object_set(Variant &var, StringBuffer &key, CVarRef value,
   }
 }
 
-static void object_set(Variant &var, StringBuffer &key, RefResult value,
+static void object_set(Variant &var, CStrRef data, RefResult value,
                        int assoc) {
-  String data = key.detach();
   if (!assoc) {
     // We know it is stdClass, and everything is public (and dynamic).
     if (data.empty()) {
@@ -469,8 +471,336 @@ static void attach_zval(json_parser *json, int up, int cur, StringBuffer &key,
   if (up_mode == MODE_ARRAY) {
     root.append(ref(child));
   } else if (up_mode == MODE_OBJECT) {
-    object_set(root, key, ref(child), assoc);
+    object_set(root, key.detach(), ref(child), assoc);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fast path for strict JSON.
+//
+// A recursive descent parser working directly on the UTF-8 bytes. String
+// contents are copied in bulk, scanning 16 bytes at a time for the bytes
+// that end a plain run, and values are built directly rather than through
+// the PDA stack. It accepts exactly what the state machine accepts and
+// produces the same values; on anything else, including the loose dialect,
+// it gives up and the state machine decides.
+
+namespace {
+
+/**
+ * First byte at or after p that is a quote, a backslash, a control
+ * character or not ASCII.
+ */
+inline const char *json_scan_plain(const char *p, const char *end) {
+#ifdef __x86_64__
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    // signed compare also catches bytes >= 0x80
+    __m128i hit = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                               _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                            _mm_cmpeq_epi8(v, bslash)));
+    int mask = _mm_movemask_epi8(hit);
+    if (mask) return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end) {
+    unsigned char c = *p;
+    if (c < ' ' || c >= 0x80 || c == '"' || c == '\\') break;
+    p++;
   }
+  return p;
+}
+
+/**
+ * Length of the multi-byte UTF-8 character at p, or 0 if UTF8To16Decoder
+ * would reject it.
+ */
+inline int json_utf8_char_len(const char *p, const char *end) {
+  const unsigned char *s = (const unsigned char *)p;
+  int avail = end - p;
+  unsigned char c = s[0];
+  int n, r;
+  if ((c & 0xE0) == 0xC0) {
+    n = 2; r = c & 0x1F;
+  } else if ((c & 0xF0) == 0xE0) {
+    n = 3; r = c & 0x0F;
+  } else if ((c & 0xF8) == 0xF0) {
+    n = 4; r = c & 0x07;
+  } else {
+    return 0;
+  }
+  if (avail < n) return 0;
+  for (int i = 1; i < n; i++) {
+    if ((s[i] & 0xC0) != 0x80) return 0;
+    r = (r << 6) | (s[i] & 0x3F);
+  }
+  switch (n) {
+  case 2: return r >= 128 ? 2 : 0;
+  case 3: return r >= 2048 && (r < 55296 || r > 57343) ? 3 : 0;
+  default: return r >= 65536 && r <= 1114111 ? 4 : 0;
+  }
+}
+
+class JsonFastParser {
+public:
+  JsonFastParser(const char *p, int length, bool assoc)
+    : m_p(p), m_end(p + length), m_assoc(assoc), m_depth(0),
+      m_buf(127), m_num(32) {}
+
+  bool parseDocument(Variant &z);
+
+private:
+  const char *m_p;
+  const char *m_end;
+  bool m_assoc;
+  int m_depth;
+  StringBuffer m_buf; // strings with escapes
+  StringBuffer m_num; // numbers strtoll()/strtod() have to see
+
+  void skipSpace() {
+    while (m_p < m_end &&
+           (*m_p == ' ' || *m_p == '\n' || *m_p == '\r' || *m_p == '\t')) {
+      m_p++;
+    }
+  }
+  bool parseLiteral(const char *lit, int len) {
+    if (m_end - m_p < len || memcmp(m_p, lit, len)) return false;
+    m_p += len;
+    return true;
+  }
+  bool parseValue(Variant &v);
+  bool parseObject(Variant &v);
+  bool parseArray(Variant &v);
+  bool parseString(String &s);
+  bool parseNumber(Variant &v);
+};
+
+bool JsonFastParser::parseDocument(Variant &z) {
+  skipSpace();
+  // the state machine only takes a container or a string at the top
+  if (m_p == m_end || (*m_p != '{' && *m_p != '[' && *m_p != '"')) {
+    return false;
+  }
+  Variant v;
+  if (!parseValue(v)) return false;
+  skipSpace();
+  if (m_p != m_end) return false;
+  z = v;
+  return true;
+}
+
+bool JsonFastParser::parseValue(Variant &v) {
+  if (m_p == m_end) return false;
+  switch (*m_p) {
+  case '{': return parseObject(v);
+  case '[': return parseArray(v);
+  case '"':
+    {
+      String s;
+      m_p++;
+      if (!parseString(s)) return false;
+      v = s;
+      return true;
+    }
+  case 't':
+    if (!parseLiteral("true", 4)) return false;
+    v = true;
+    return true;
+  case 'f':
+    if (!parseLiteral("false", 5)) return false;
+    v = false;
+    return true;
+  case 'n':
+    if (!parseLiteral("null", 4)) return false;
+    v = null;
+    return true;
+  default:
+    return parseNumber(v);
+  }
+}
+
+bool JsonFastParser::parseObject(Variant &v) {
+  if (++m_depth >= JSON_PARSER_MAX_DEPTH) return false;
+  m_p++;
+  Variant obj;
+  if (!m_assoc) {
+    obj = SystemLib::AllocStdClassObject();
+  } else {
+    obj = Array::Create();
+  }
+  skipSpace();
+  if (m_p < m_end && *m_p == '}') {
+    m_p++;
+  } else {
+    for (;;) {
+      if (m_p == m_end || *m_p != '"') return false;
+      m_p++;
+      String key;
+      if (!parseString(key)) return false;
+      skipSpace();
+      if (m_p == m_end || *m_p != ':') return false;
+      m_p++;
+      skipSpace();
+      Variant value;
+      if (!parseValue(value)) return false;
+      object_set(obj, key, value, m_assoc);
+      skipSpace();
+      if (m_p == m_end) return false;
+      if (*m_p == '}') {
+        m_p++;
+        break;
+      }
+      if (*m_p != ',') return false;
+      m_p++;
+      skipSpace();
+    }
+  }
+  m_depth--;
+  v = obj;
+  return true;
+}
+
+bool JsonFastParser::parseArray(Variant &v) {
+  if (++m_depth >= JSON_PARSER_MAX_DEPTH) return false;
+  m_p++;
+  Array arr = Array::Create();
+  skipSpace();
+  if (m_p < m_end && *m_p == ']') {
+    m_p++;
+  } else {
+    for (;;) {
+      Variant elem;
+      if (!parseValue(elem)) return false;
+      arr.append(elem);
+      skipSpace();
+      if (m_p == m_end) return false;
+      if (*m_p == ']') {
+        m_p++;
+        break;
+      }
+      if (*m_p != ',') return false;
+      m_p++;
+      skipSpace();
+    }
+  }
+  m_depth--;
+  v = arr;
+  return true;
+}
+
+/**
+ * Called just past the opening quote. Strings without escapes are copied
+ * straight out of the input; the rest are unescaped into m_buf exactly the
+ * way the state machine does it, surrogate pairs included.
+ */
+bool JsonFastParser::parseString(String &s) {
+  const char *start = m_p;
+  const char *p = m_p;
+  bool escaped = false;
+  for (;;) {
+    p = json_scan_plain(p, m_end);
+    if (p == m_end) return false;
+    unsigned char c = *p;
+    if (c == '"') break;
+    if (c >= 0x80) {
+      int n = json_utf8_char_len(p, m_end);
+      if (!n) return false;
+      p += n;
+      continue;
+    }
+    if (c != '\\' || m_end - p < 2) return false;
+    if (!escaped) {
+      escaped = true;
+      m_buf.reset();
+    }
+    m_buf.append(start, p - start);
+    switch (p[1]) {
+    case '"': case '\\': case '/': m_buf.append(p[1]); break;
+    case 'b': m_buf.append('\b'); break;
+    case 'f': m_buf.append('\f'); break;
+    case 'n': m_buf.append('\n'); break;
+    case 'r': m_buf.append('\r'); break;
+    case 't': m_buf.append('\t'); break;
+    case 'u':
+      {
+        if (m_end - p < 6) return false;
+        int utf16 = 0;
+        for (int i = 2; i < 6; i++) {
+          int h = dehexchar(p[i]);
+          if (h < 0) return false;
+          utf16 = (utf16 << 4) | h;
+        }
+        utf16_to_utf8(m_buf, utf16);
+        p += 4;
+      }
+      break;
+    default:
+      return false;
+    }
+    p += 2;
+    start = p;
+  }
+  if (escaped) {
+    m_buf.append(start, p - start);
+    s = m_buf.detach();
+  } else {
+    s = String(start, p - start, CopyString);
+  }
+  m_p = p + 1;
+  return true;
+}
+
+bool JsonFastParser::parseNumber(Variant &v) {
+  const char *start = m_p;
+  const char *p = m_p;
+  bool isDouble = false;
+  if (*p == '-') p++;
+  if (p == m_end) return false;
+  bool leadingZero = (*p == '0');
+  if (leadingZero) {
+    p++;
+  } else if (*p >= '1' && *p <= '9') {
+    while (p < m_end && *p >= '0' && *p <= '9') p++;
+  } else {
+    return false;
+  }
+  // the state machine takes "1." and "0.e1" but not "0e1"
+  bool exponent = !leadingZero;
+  if (p < m_end && *p == '.') {
+    isDouble = exponent = true;
+    p++;
+    while (p < m_end && *p >= '0' && *p <= '9') p++;
+  }
+  if (exponent && p < m_end && (*p == 'e' || *p == 'E')) {
+    isDouble = true;
+    p++;
+    if (p < m_end && (*p == '+' || *p == '-')) p++;
+    if (p == m_end || *p < '0' || *p > '9') return false;
+    while (p < m_end && *p >= '0' && *p <= '9') p++;
+  }
+  m_p = p;
+
+  int len = p - start;
+  if (!isDouble && len < MAX_LENGTH_OF_LONG - 1) {
+    // cannot overflow, no need for the text
+    const char *q = start;
+    bool neg = (*q == '-');
+    if (neg) q++;
+    int64 n = 0;
+    while (q < p) n = n * 10 + (*q++ - '0');
+    v = neg ? -n : n;
+    return true;
+  }
+  m_num.reset();
+  m_num.append(start, len);
+  json_create_zval(v, m_num, isDouble ? KindOfDouble : KindOfInt64);
+  return true;
+}
+
 }
 
 #define SWAP_BUFFERS(from, to) do { \
@@ -493,6 +823,11 @@ bool JSON_parser(Variant &z, const char *p, int length, bool assoc/*<fb>*/,
   int b;  /* the next character */
   int c;  /* the next character class */
   int s;  /* the next state */
+  if (!loose) {
+    JsonFastParser fast(p, length, assoc);
+    if (fast.parseDocument(z)) return true;
+  }
+
   json_parser *the_json = s_json_parser.get(); /* the parser state */
   JsonParserCleaner cleaner(the_json);
   int the_state = 0;
@@ -620,7 +955,7 @@ bool JSON_parser(Variant &z, const char *p, int length, bool assoc/*<fb>*/,
           Variant mval;
           json_create_zval(mval, *buf, type);
           Variant &top = JSON(the_zstack)[JSON(the_top)];
-          object_set(top, *key, mval, assoc);
+          object_set(top, key->detach(), mval, assoc);
           buf->reset();
           JSON_RESET_TYPE();
         }
@@ -716,7 +1051,7 @@ bool JSON_parser(Variant &z, const char *p, int length, bool assoc/*<fb>*/,
                 push(the_json, MODE_KEY)) {
               if (type != -1) {
                 Variant &top = JSON(the_zstack)[JSON(the_top)];
-                object_set(top, *key, mval, assoc);
+                object_set(top, key->detach(), mval, assoc);
               }
               the_state = 29;
             }
@@ -35,6 +35,9 @@
 #include <runtime/vm/backup_gc.h>
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
 #include <runtime/eval/runtime/file_repository.h>
 
 #include <util/parser/parser.h>
@@ -1177,6 +1180,16 @@ bool f_fb_utf8ize(VRefParam input) {
   // Preflight to avoid allocation if the entire input is valid.
   int32_t srcPosBytes;
   for (srcPosBytes = 0; srcPosBytes < srcLenBytes; /* U8_NEXT increments */) {
+#ifdef __x86_64__
+    // Skip blocks of 16 non-NUL ASCII bytes.
+    while (srcLenBytes - srcPosBytes >= 16) {
+      __m128i block = _mm_loadu_si128((const __m128i *)(srcBuf + srcPosBytes));
+      __m128i nul = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+      if (_mm_movemask_epi8(_mm_or_si128(block, nul))) break;
+      srcPosBytes += 16;
+    }
+    if (srcPosBytes == srcLenBytes) break;
+#endif
     // This is lame, but gcc doesn't optimize U8_NEXT very well
     if (srcBuf[srcPosBytes] > 0 && srcBuf[srcPosBytes] <= 0x7f) {
       srcPosBytes++; // U8_NEXT would increment this
@@ -35,6 +35,10 @@ const int64 k_JSON_PRETTY_PRINT  = 1<<7;
 const int64 k_JSON_FB_LOOSE      = 1<<20;
 const int64 k_JSON_FB_UNLIMITED  = 1<<21;
 const int64 k_JSON_FB_EXTRA_ESCAPES = 1<<22;
+const int64 k_JSON_FB_STREAM     = 1<<23;
+
+// how much encoded text JSON_FB_STREAM buffers before writing it out
+static const int kJsonStreamChunkSize = 64 * 1024;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -45,6 +49,12 @@ String f_json_encode(CVarRef value, CVarRef options /* = 0 */) {
   }
 
   VariableSerializer vs(VariableSerializer::JSON, json_options);
+  if (json_options & k_JSON_FB_STREAM) {
+    // written to the output as it is produced; nothing is returned
+    vs.serializeToOutput(value, kJsonStreamChunkSize,
+                         !(json_options & k_JSON_FB_UNLIMITED));
+    return empty_string;
+  }
   return vs.serializeValue(value, !(json_options & k_JSON_FB_UNLIMITED));
 }
 
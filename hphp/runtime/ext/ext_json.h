@@ -37,6 +37,7 @@ extern const int64 k_JSON_UNESCAPED_SLASHES;
 extern const int64 k_JSON_PRETTY_PRINT;
 extern const int64 k_JSON_FB_LOOSE;
 extern const int64 k_JSON_FB_LOOSE;
+extern const int64 k_JSON_FB_STREAM;
 ///////////////////////////////////////////////////////////////////////////////
 }
 
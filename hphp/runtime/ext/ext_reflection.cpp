@@ -22,6 +22,7 @@
 #include <runtime/base/source_info.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/string_util.h>
+#include <runtime/eval/runtime/file_repository.h>
 #include <runtime/vm/translator/translator-inline.h>
 
 #include <system/lib/systemlib.h>
@@ -439,7 +440,8 @@ static void set_method_info(Array &ret, const VM::Func* func) {
   ret.set(s_class, VarNR(func->cls() ? func->cls()->name() :
                          func->preClass()->name()));
   set_function_info(ret, func);
-  set_source_info(ret, func->unit()->filepath()->data(),
+  set_source_info(ret,
+                  Eval::FileRepository::unitFilePath(func->unit()).data(),
                   func->line1(), func->line2());
 }
 
@@ -841,7 +843,8 @@ Array f_hphp_get_class_info(CVarRef name) {
 
     { // source info
       const VM::PreClass* pcls = cls->preClass();
-      set_source_info(ret, pcls->unit()->filepath()->data(),
+      set_source_info(ret,
+                      Eval::FileRepository::unitFilePath(pcls->unit()).data(),
                       pcls->line1(), pcls->line2());
       set_doc_comment(ret, pcls->docComment());
     }
@@ -884,7 +887,8 @@ Array f_hphp_get_function_info(CStrRef name) {
 
     // setting parameters and static variables
     set_function_info(ret, func);
-    set_source_info(ret, func->unit()->filepath()->data(),
+    set_source_info(ret,
+                    Eval::FileRepository::unitFilePath(func->unit()).data(),
                     func->line1(), func->line2());
     return ret;
   }
@@ -1485,8 +1485,7 @@ CStrRef VMExecutionContext::getContainingFileName() {
     ar = getPrevVMState(ar);
     if (ar == nullptr) return empty_string;
   }
-  Unit* unit = ar->m_func->unit();
-  return unit->filepathRef();
+  return Eval::FileRepository::unitFilePath(ar->m_func->unit());
 }
 
 int VMExecutionContext::getLine() {
@@ -1525,9 +1524,9 @@ Array VMExecutionContext::getCallerInfo() {
       Unit* unit = ar->m_func->unit();
       int lineNumber;
       if ((lineNumber = unit->getLineNumber(pc)) != -1) {
-        assert(!unit->filepath()->size() ||
-               unit->filepath()->data()[0] == '/');
-        result.set(s_file, unit->filepath()->data(), true);
+        CStrRef file = Eval::FileRepository::unitFilePath(unit);
+        assert(!file.size() || file.data()[0] == '/');
+        result.set(s_file, file, true);
         result.set(s_line, lineNumber);
         return result;
       }
@@ -2371,7 +2370,7 @@ Array VMExecutionContext::debugBacktrace(bool skip /* = false */,
     if (!fp->m_func->isBuiltin()) {
       Unit *unit = fp->m_func->unit();
       assert(unit);
-      const char* filename = unit->filepath()->data();
+      const char* filename = Eval::FileRepository::unitFilePath(unit).data();
       assert(filename);
       Offset off = pc;
       Array frame = Array::Create();
@@ -2397,7 +2396,7 @@ Array VMExecutionContext::debugBacktrace(bool skip /* = false */,
     if (prevFp && !prevFp->m_func->isBuiltin()) {
       Unit* unit = prevFp->m_func->unit();
       assert(unit);
-      const char *filename = unit->filepath()->data();
+      const char *filename = Eval::FileRepository::unitFilePath(unit).data();
       assert(filename);
       frame.set(String(s_file), filename, true);
       frame.set(String(s_line),
@@ -2434,8 +2433,7 @@ Array VMExecutionContext::debugBacktrace(bool skip /* = false */,
     Array args = Array::Create();
     if (funcname == s_include) {
       if (depth) {
-        args.append(String(const_cast<StringData*>(
-                             fp->m_func->unit()->filepath())));
+        args.append(Eval::FileRepository::unitFilePath(fp->m_func->unit()));
         frame.set(String(s_args), args, true);
       }
     } else if (RuntimeOption::RepoAuthoritative) {
@@ -2702,7 +2700,8 @@ HPHP::Eval::PhpFile* VMExecutionContext::lookupIncludeRoot(StringData* path,
   if ((flags & InclOpRelative)) {
     namespace fs = boost::filesystem;
     if (!unit) unit = getFP()->m_func->unit();
-    fs::path currentUnit(unit->filepath()->data());
+    CStrRef unitPath = Eval::FileRepository::unitFilePath(unit);
+    fs::path currentUnit(unitPath.data());
     fs::path currentDir(currentUnit.branch_path());
     absPath = currentDir.string() + '/';
     TRACE(2, "lookupIncludeRoot(%s): relative -> %s\n",
@@ -3842,13 +3841,21 @@ inline void OPTBLD_INLINE VMExecutionContext::iopFalse(PC& pc) {
 
 inline void OPTBLD_INLINE VMExecutionContext::iopFile(PC& pc) {
   NEXT();
-  const StringData* s = m_fp->m_func->unit()->filepath();
+  Unit* u = m_fp->m_func->unit();
+  const StringData* s = u->filepath();
+  if (UNLIKELY(RuntimeOption::SandboxShareUnits)) {
+    s = Eval::FileRepository::unitFilePath(u).get();
+  }
   m_stack.pushStaticString(const_cast<StringData*>(s));
 }
 
 inline void OPTBLD_INLINE VMExecutionContext::iopDir(PC& pc) {
   NEXT();
-  const StringData* s = m_fp->m_func->unit()->dirpath();
+  Unit* u = m_fp->m_func->unit();
+  const StringData* s = u->dirpath();
+  if (UNLIKELY(RuntimeOption::SandboxShareUnits)) {
+    s = Eval::FileRepository::unitDirPath(u).get();
+  }
   m_stack.pushStaticString(const_cast<StringData*>(s));
 }
 
@@ -6563,7 +6570,10 @@ inline void OPTBLD_INLINE inclOp(VMExecutionContext *ec, PC &pc,
 
   Unit* u = flags & (InclOpDocRoot|InclOpRelative) ?
     ec->evalIncludeRoot(path.get(), flags, &initial) :
-    ec->evalInclude(path.get(), ec->m_fp->m_func->unit()->filepath(), &initial);
+    ec->evalInclude(path.get(),
+                    Eval::FileRepository::unitFilePath(
+                      ec->m_fp->m_func->unit()).get(),
+                    &initial);
   ec->m_stack.popC();
   if (u == nullptr) {
     ((flags & InclOpFatal) ?
@@ -81,9 +81,9 @@ Repo::Repo()
     RP_OPS
 #undef RP_OP
     m_dbc(nullptr), m_localReadable(false), m_localWritable(false),
-    m_evalRepoId(-1), m_txDepth(0), m_rollback(false), m_beginStmt(*this),
-    m_rollbackStmt(*this), m_commitStmt(*this), m_urp(*this), m_pcrp(*this),
-    m_frp(*this) {
+    m_prevAttached(false), m_evalRepoId(-1), m_txDepth(0), m_rollback(false),
+    m_beginStmt(*this), m_rollbackStmt(*this), m_commitStmt(*this),
+    m_urp(*this), m_pcrp(*this), m_frp(*this) {
 #define RP_OP(c, o) \
   m_##o[RepoIdLocal] = &m_##o##Local; \
   m_##o[RepoIdCentral] = &m_##o##Central;
@@ -183,8 +183,11 @@ bool Repo::findFile(const char *path, const string &root, MD5& md5) {
 }
 
 bool Repo::insertMd5(UnitOrigin unitOrigin, UnitEmitter* ue, RepoTxn& txn) {
-  const StringData* path = ue->getFilepath();
-  const MD5& md5 = ue->md5();
+  return insertMd5(unitOrigin, ue->getFilepath(), ue->md5(), txn);
+}
+
+bool Repo::insertMd5(UnitOrigin unitOrigin, const StringData* path,
+                     const MD5& md5, RepoTxn& txn) {
   int repoId = repoIdForNewUnit(unitOrigin);
   if (repoId == RepoIdInvalid) {
     return true;
@@ -216,12 +219,182 @@ void Repo::commitMd5(UnitOrigin unitOrigin, UnitEmitter* ue) {
   }
 }
 
+void Repo::InsertUnitDepsStmt::insert(RepoTxn& txn, const MD5& md5,
+                                      const MD5& deps) {
+  if (!prepared()) {
+    std::stringstream ssInsert;
+    ssInsert << "INSERT OR REPLACE INTO "
+             << m_repo.table(m_repoId, "UnitDeps")
+             << " VALUES(@md5, @deps);";
+    txn.prepare(*this, ssInsert.str());
+  }
+  RepoTxnQuery query(txn, *this);
+  query.bindMd5("@md5", md5);
+  query.bindMd5("@deps", deps);
+  query.exec();
+}
+
+bool Repo::insertUnitDeps(UnitOrigin unitOrigin, const MD5& md5,
+                          const MD5& deps, RepoTxn& txn) {
+  int repoId = repoIdForNewUnit(unitOrigin);
+  if (repoId == RepoIdInvalid) {
+    return true;
+  }
+  try {
+    insertUnitDeps(repoId).insert(txn, md5, deps);
+    return false;
+  } catch(RepoExc& re) {
+    TRACE(3, "Failed to commit deps for 0x%016llx%016llx to '%s': %s\n",
+              md5.q[0], md5.q[1], repoName(repoId).c_str(),
+              re.msg().c_str());
+    return true;
+  }
+}
+
+bool Repo::attachPrevious(const char* path) {
+  assert(!m_prevAttached);
+  std::string repoPath = insertSchema(path);
+  struct stat buf;
+  if (stat(repoPath.c_str(), &buf) != 0) {
+    return false;
+  }
+  try {
+    std::stringstream ssAttach;
+    ssAttach << "ATTACH DATABASE '" << repoPath << "' as prev;";
+    exec(ssAttach.str());
+  } catch (RepoExc& re) {
+    return false;
+  }
+  // A repo written with a different schema has none of our tables, and
+  // nothing can be reused from it.
+  try {
+    RepoTxn txn(*this);
+    std::stringstream ssSelect;
+    ssSelect << "SELECT COUNT(*) FROM " << prevTable("UnitDeps") << ";";
+    RepoStmt stmt(*this);
+    stmt.prepare(ssSelect.str());
+    RepoTxnQuery query(txn, stmt);
+    query.step();
+    txn.commit();
+  } catch (RepoExc& re) {
+    TRACE(1, "Previous repo '%s' has a different schema\n", repoPath.c_str());
+    exec("DETACH DATABASE prev;");
+    return false;
+  }
+  m_prevAttached = true;
+  TRACE(1, "Previous repo: '%s'\n", repoPath.c_str());
+  return true;
+}
+
+bool Repo::findPrevUnit(const MD5& md5, const MD5& deps) {
+  if (!m_prevAttached) return false;
+  try {
+    RepoTxn txn(*this);
+    std::stringstream ssSelect;
+    ssSelect << "SELECT u.unitSn FROM " << prevTable("UnitDeps") << " AS d, "
+             << prevTable("Unit") << " AS u WHERE d.md5 == @md5"
+             << " AND d.deps == @deps AND u.md5 == d.md5;";
+    RepoStmt stmt(*this);
+    txn.prepare(stmt, ssSelect.str());
+    RepoTxnQuery query(txn, stmt);
+    query.bindMd5("@md5", md5);
+    query.bindMd5("@deps", deps);
+    query.step();
+    bool found = query.row();
+    txn.commit();
+    return found;
+  } catch (RepoExc& re) {
+    return false;
+  }
+}
+
+/*
+ * Every table holding per-unit data, with its columns other than the
+ * leading unitSn.  This has to match the createSchema() methods of the
+ * repo proxies.
+ */
+static const struct {
+  const char* table;
+  const char* columns;
+} s_unitTables[] = {
+  { "UnitLitstr",     "litstrId, litstr" },
+  { "UnitArray",      "arrayId, array" },
+  { "UnitPreConst",   "name, value, preConstId" },
+  { "UnitMergeables", "mergeableIx, mergeableKind, mergeableId,"
+                      " mergeableValue" },
+  { "UnitSourceLoc",  "pastOffset, line0, char0, line1, char1" },
+  { "PreClass",       "preClassId, name, hoistable, extraData" },
+  { "Func",           "funcSn, preClassId, name, top, extraData" },
+};
+
+bool Repo::copyPrevUnit(UnitOrigin unitOrigin, const MD5& md5,
+                        RepoTxn& txn) {
+  int repoId = repoIdForNewUnit(unitOrigin);
+  if (repoId == RepoIdInvalid || !m_prevAttached) {
+    return true;
+  }
+  try {
+    int64 oldSn;
+    {
+      std::stringstream ssSelect;
+      ssSelect << "SELECT unitSn FROM " << prevTable("Unit")
+               << " WHERE md5 == @md5;";
+      RepoStmt stmt(*this);
+      txn.prepare(stmt, ssSelect.str());
+      RepoTxnQuery query(txn, stmt);
+      query.bindMd5("@md5", md5);
+      query.step();
+      if (!query.row()) return true;
+      query.getInt64(0, oldSn);
+    }
+    int64 newSn;
+    {
+      std::stringstream ssInsert;
+      ssInsert << "INSERT INTO " << table(repoId, "Unit")
+               << " SELECT NULL, md5, bc, bc_meta, mainReturn, mergeable,"
+               << " lines FROM " << prevTable("Unit")
+               << " WHERE unitSn == @unitSn;";
+      RepoStmt stmt(*this);
+      txn.prepare(stmt, ssInsert.str());
+      RepoTxnQuery query(txn, stmt);
+      query.bindInt64("@unitSn", oldSn);
+      query.exec();
+      newSn = query.getInsertedRowid();
+    }
+    for (size_t i = 0; i < sizeof(s_unitTables) / sizeof(s_unitTables[0]);
+         i++) {
+      std::stringstream ssInsert;
+      ssInsert << "INSERT INTO " << table(repoId, s_unitTables[i].table)
+               << " SELECT @newSn, " << s_unitTables[i].columns
+               << " FROM " << prevTable(s_unitTables[i].table)
+               << " WHERE unitSn == @unitSn;";
+      RepoStmt stmt(*this);
+      txn.prepare(stmt, ssInsert.str());
+      RepoTxnQuery query(txn, stmt);
+      query.bindInt64("@newSn", newSn);
+      query.bindInt64("@unitSn", oldSn);
+      query.exec();
+    }
+    return false;
+  } catch (RepoExc& re) {
+    TRACE(3, "Failed to copy 0x%016llx%016llx from previous repo: %s\n",
+             md5.q[0], md5.q[1], re.msg().c_str());
+    return true;
+  }
+}
+
 std::string Repo::table(int repoId, const char* tablePrefix) {
   std::stringstream ss;
   ss << dbName(repoId) << "." << tablePrefix << "_" << kSchemaId;
   return ss.str();
 }
 
+std::string Repo::prevTable(const char* tablePrefix) {
+  std::stringstream ss;
+  ss << "prev." << tablePrefix << "_" << kSchemaId;
+  return ss.str();
+}
+
 void Repo::exec(const std::string& sQuery) {
   RepoStmt stmt(*this);
   stmt.prepare(sQuery);
@@ -672,6 +845,12 @@ bool Repo::createSchema(int repoId) {
                << "(path TEXT, md5 BLOB, UNIQUE(path, md5));";
       txn.exec(ssCreate.str());
     }
+    {
+      std::stringstream ssCreate;
+      ssCreate << "CREATE TABLE " << table(repoId, "UnitDeps")
+               << "(md5 BLOB PRIMARY KEY, deps BLOB);";
+      txn.exec(ssCreate.str());
+    }
     m_urp.createSchema(repoId, txn);
     m_pcrp.createSchema(repoId, txn);
     m_frp.createSchema(repoId, txn);
@@ -78,13 +78,32 @@ class Repo : public RepoProxy {
   Unit* loadUnit(const std::string& name, const MD5& md5);
   bool findFile(const char* path, const std::string& root, MD5& md5);
   bool insertMd5(UnitOrigin unitOrigin, UnitEmitter* ue, RepoTxn& txn);
+  bool insertMd5(UnitOrigin unitOrigin, const StringData* path,
+                 const MD5& md5, RepoTxn& txn);
   void commitMd5(UnitOrigin unitOrigin, UnitEmitter *ue);
 
+  /*
+   * Incremental compilation support.  Each unit written by the offline
+   * compiler can be stored with a fingerprint of the analysis results it
+   * was emitted against.  attachPrevious() makes a repo produced by an
+   * earlier run (with the same schema) available; units whose md5 and
+   * fingerprint both match can then be copied over instead of being
+   * emitted again.
+   */
+  bool insertUnitDeps(UnitOrigin unitOrigin, const MD5& md5,
+                      const MD5& deps, RepoTxn& txn); // nothrow
+  bool attachPrevious(const char* path);
+  bool hasPrevious() const { return m_prevAttached; }
+  bool findPrevUnit(const MD5& md5, const MD5& deps);
+  bool copyPrevUnit(UnitOrigin unitOrigin, const MD5& md5,
+                    RepoTxn& txn); // nothrow
+
 #define RP_IOP(o) RP_OP(Insert##o, insert##o)
 #define RP_GOP(o) RP_OP(Get##o, get##o)
 #define RP_OPS \
   RP_IOP(FileHash) \
-  RP_GOP(FileHash)
+  RP_GOP(FileHash) \
+  RP_IOP(UnitDeps)
   class InsertFileHashStmt : public RepoProxy::Stmt {
     public:
       InsertFileHashStmt(Repo& repo, int repoId) : Stmt(repo, repoId) {}
@@ -95,6 +114,11 @@ class Repo : public RepoProxy {
       GetFileHashStmt(Repo& repo, int repoId) : Stmt(repo, repoId) {}
       bool get(const char* path, MD5& md5);
   };
+  class InsertUnitDepsStmt : public RepoProxy::Stmt {
+    public:
+      InsertUnitDepsStmt(Repo& repo, int repoId) : Stmt(repo, repoId) {}
+      void insert(RepoTxn& txn, const MD5& md5, const MD5& deps);
+  };
 #define RP_OP(c, o) \
  public: \
   c##Stmt& o(int repoId) { return *m_##o[repoId]; } \
@@ -107,6 +131,7 @@ class Repo : public RepoProxy {
 
  public:
   std::string table(int repoId, const char* tablePrefix);
+  std::string prevTable(const char* tablePrefix);
   void exec(const std::string& sQuery);
 
   void begin();
@@ -162,6 +187,7 @@ class Repo : public RepoProxy {
   sqlite3* m_dbc; // Database connection, shared by multiple attached databases.
   bool m_localReadable;
   bool m_localWritable;
+  bool m_prevAttached;
   int m_evalRepoId;
   unsigned m_txDepth; // Transaction nesting depth.
   bool m_rollback; // If true, rollback rather than commit.
@@ -83,6 +83,12 @@ void dump() {
   STATS
 #undef STAT
 #undef O
+  uint64_t guards =
+    tl_counters[Tx_GuardEmitted] + tl_counters[Tx_GuardInferred];
+  if (guards) {
+    TRACE(1, "STAT %-50s %14.1f%%\n", "Tx_GuardInferredPercent",
+          100.0 * tl_counters[Tx_GuardInferred] / guards);
+  }
   for (int i=0; helperNames[i]; i++) {
     if (tl_helper_counters[i]) {
       TRACE(1, "STAT %-50s %15ld\n",
@@ -50,6 +50,8 @@ namespace Stats {
   STAT(TgtCache_MethodMiss) \
   STAT(TgtCache_MethodFast) \
   STAT(TgtCache_MethodBypass) \
+  STAT(TgtCache_MethodPredict) \
+  STAT(TgtCache_MethodPredictMiss) \
   STAT(TgtCache_GlobalHit) \
   STAT(TgtCache_GlobalMiss) \
   STAT(TgtCache_StaticMethodHit) \
@@ -134,6 +136,9 @@ namespace Stats {
   STAT(TC_TypePredMiss) \
   STAT(TC_TypePredUnneeded) \
   STAT(TC_TypePredOverridden) \
+  /* Guard elimination from static type inference */ \
+  STAT(Tx_GuardEmitted) \
+  STAT(Tx_GuardInferred) \
   /* Fixup */ \
   STAT(Fixup_Find) \
   STAT(Fixup_Probe) \
@@ -9094,6 +9094,39 @@ TranslatorX64::translateFPushObjMethodD(const Tracelet &t,
     }
     int arOff = vstackOffset(i, startOfActRec);
     SKTRACE(1, i.source, "ch %d\n", ch);
+
+    /*
+     * If whole-program analysis found a single class that could be
+     * receiving this call, bind the call to that class's method
+     * directly, and fall back to the method cache if the receiver
+     * turns out to be something else.
+     */
+    const Func* predFunc = nullptr;
+    if (!baseClass && i.predictedClass &&
+        g_vmContext->lookupObjMethod(predFunc, i.predictedClass, name,
+                                     false) ==
+          MethodLookup::MethodFoundWithThis &&
+        !(predFunc->attrs() & (AttrAbstract | AttrStatic))) {
+      SKTRACE(1, i.source, "predicted class %s\n",
+              i.predictedClass->name()->data());
+      emitVStackStoreImm(a, i, uintptr_t(predFunc), funcOff, sz::qword);
+      Stats::emitInc(a, Stats::TgtCache_MethodPredict);
+      {
+        ScratchReg rCls(m_regMap);
+        emitImmReg(a, int64(i.predictedClass), r(rCls));
+        a.  cmp_reg64_disp_reg64(r(rCls), ObjectData::getVMClassOffset(),
+                                 getReg(objLoc));
+      }
+      {
+        UnlikelyIfBlock mispredict(CC_NE, a, astubs);
+        Stats::emitInc(astubs, Stats::TgtCache_MethodPredictMiss);
+        EMIT_CALL(astubs, MethodCache::lookup, IMM(ch),
+                   RPLUS(rVmSp, arOff), IMM(uint64_t(name)));
+        recordReentrantStubCall(i);
+      }
+      return;
+    }
+
     EMIT_CALL(a, MethodCache::lookup, IMM(ch),
                RPLUS(rVmSp, arOff), IMM(uint64_t(name)));
     recordReentrantCall(i);
@@ -42,6 +42,7 @@
 #include "runtime/vm/translator/annotation.h"
 #include "runtime/vm/type_profile.h"
 #include "runtime/vm/runtime.h"
+#include "runtime/vm/stats.h"
 
 namespace HPHP {
 namespace VM {
@@ -1603,6 +1604,17 @@ bool Translator::applyInputMetaData(Unit::MetaHandle& metaHand,
   do {
     SKTRACE(3, ni->source, "considering MetaInfo of kind %d\n", info.m_kind);
 
+    /*
+     * Types inferred by whole-program analysis are only trusted when the
+     * repo is authoritative; otherwise the unit could have been compiled
+     * against a different version of the code it depends on.  Types the
+     * emitter derived from the unit alone stay DataTypeInferred.
+     */
+    if (info.m_kind == Unit::MetaInfo::DataTypeProgramInferred) {
+      info.m_kind = RuntimeOption::RepoAuthoritative ?
+        Unit::MetaInfo::DataTypeInferred : Unit::MetaInfo::DataTypePredicted;
+    }
+
     int arg = info.m_arg & Unit::MetaInfo::VectorArg ?
       base + (info.m_arg & ~Unit::MetaInfo::VectorArg) : info.m_arg;
 
@@ -1648,6 +1660,11 @@ bool Translator::applyInputMetaData(Unit::MetaHandle& metaHand,
         SKTRACE(1, ni->source, "MetaInfo DataTypeInferred for input %d; "
                    "newType = %d\n", arg, DataType(info.m_data));
         InputInfo& ii = inputInfos[arg];
+        if (!ii.loc.isLiteral() && !mapContains(tas.m_currentMap, ii.loc)) {
+          // First read of this location in the tracelet: this is a
+          // guard we don't have to emit.
+          Stats::inc(Stats::Tx_GuardInferred);
+        }
         ii.dontGuard = true;
         DynLocation* dl = tas.recordRead(ii, m_useHHIR, (DataType)info.m_data);
         if (dl->rtt.outerType() != info.m_data &&
@@ -1756,6 +1773,18 @@ bool Translator::applyInputMetaData(Unit::MetaHandle& metaHand,
         break;
       }
 
+      case Unit::MetaInfo::ClassPredicted: {
+        const StringData* metaName = ni->unit()->lookupLitstrId(info.m_data);
+        Class* metaCls = Unit::lookupClass(metaName);
+        if (metaCls && RuntimeOption::RepoAuthoritative &&
+            (metaCls->attrs() & AttrUnique)) {
+          SKTRACE(1, ni->source, "MetaInfo predicts class %s for input %d\n",
+                  metaName->data(), arg);
+          ni->predictedClass = metaCls;
+        }
+        break;
+      }
+
       case Unit::MetaInfo::NopOut:
         // NopOut should always be the first and only annotation
         // and was handled above.
@@ -3287,6 +3316,7 @@ breakBB:
   // Populate t.m_changes, t.intermediates, t.m_dependencies
   t.m_dependencies = tas.m_dependencies;
   t.m_resolvedDeps = tas.m_resolvedDeps;
+  Stats::inc(Stats::Tx_GuardEmitted, t.m_dependencies.size());
   t.m_changes.clear();
   LocationSet::iterator it = tas.m_changeSet.begin();
   for (; it != tas.m_changeSet.end(); ++it) {
@@ -284,6 +284,12 @@ class NormalizedInstruction {
    */
   std::vector<Class*> immVecClasses;
 
+  /*
+   * For FPushObjMethodD, the class the receiver is predicted to have
+   * when its actual class is unknown.  See MetaInfo::ClassPredicted.
+   */
+  const Class* predictedClass;
+
   unsigned checkedInputs;
   // StackOff: logical delta at *start* of this instruction to
   // stack at tracelet entry.
@@ -384,6 +390,7 @@ class NormalizedInstruction {
     outStack2(nullptr),
     outStack3(nullptr),
     deadLocs(),
+    predictedClass(nullptr),
     checkedInputs(0),
     hasConstImm(false),
     invertCond(false),
@@ -1244,10 +1244,14 @@ void Unit::prettyPrint(std::ostream& out, PrintOpts opts) const {
         const char *argKind = info.m_arg & MetaInfo::VectorArg ? "M" : "";
         switch (info.m_kind) {
           case Unit::MetaInfo::DataTypeInferred:
+          case Unit::MetaInfo::DataTypeProgramInferred:
           case Unit::MetaInfo::DataTypePredicted:
             out << " i" << argKind << arg << ":t=" << (int)info.m_data;
             if (info.m_kind == Unit::MetaInfo::DataTypePredicted) {
               out << "*";
+            } else if (info.m_kind ==
+                       Unit::MetaInfo::DataTypeProgramInferred) {
+              out << "^";
             }
             break;
           case Unit::MetaInfo::String: {
@@ -1284,6 +1288,11 @@ void Unit::prettyPrint(std::ostream& out, PrintOpts opts) const {
           case Unit::MetaInfo::NonRefCounted:
             out << " :nrc=" << info.m_data;
             break;
+          case Unit::MetaInfo::ClassPredicted: {
+            const StringData* sd = lookupLitstrId(info.m_data);
+            out << " i" << argKind << arg << ":pc?=" << sd->data();
+            break;
+          }
           case Unit::MetaInfo::None:
             assert(false);
             break;
@@ -349,6 +349,22 @@ struct Unit {
        * that cannot be reference counted at this point.
        */
       NonRefCounted,
+
+      /*
+       * At an FPushObjMethodD site whose receiver class is unknown,
+       * names the only class in the program with a method of that
+       * name.  The receiver is expected, but not proven, to be an
+       * instance of exactly this class; the translator guards on it.
+       */
+      ClassPredicted,
+
+      /*
+       * Like DataTypeInferred, but proven by whole-program analysis, so
+       * it only holds while the rest of the program is the code the unit
+       * was compiled with.  Trusted only when the repo is authoritative;
+       * otherwise the translator treats it as DataTypePredicted.
+       */
+      DataTypeProgramInferred,
     };
 
     /*
@@ -441,6 +457,10 @@ struct Unit {
     assert(m_dirpath);
     return m_dirpath;
   }
+  CStrRef dirpathRef() const {
+    assert(m_dirpath);
+    return *(String*)(&m_dirpath);
+  }
 
   MD5 md5() const { return m_md5; }
 
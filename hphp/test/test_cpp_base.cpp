@@ -19,6 +19,7 @@
 #include <util/logger.h>
 #include <runtime/base/memory/memory_manager.h>
 #include <runtime/base/builtin_functions.h>
+#include <runtime/base/util/string_buffer.h>
 #include <runtime/ext/ext_variable.h>
 #include <runtime/ext/ext_apc.h>
 #include <runtime/ext/ext_mysql.h>
@@ -40,6 +41,7 @@ bool TestCppBase::RunTests(const std::string &which) {
   bool ret = true;
   RUN_TEST(TestSmartAllocator);
   RUN_TEST(TestString);
+  RUN_TEST(TestStringBuffer);
   RUN_TEST(TestArray);
   RUN_TEST(TestObject);
   RUN_TEST(TestVariant);
@@ -217,6 +219,61 @@ bool TestCppBase::TestString() {
   return Count(true);
 }
 
+bool TestCppBase::TestStringBuffer() {
+  // segmented mode seals full buffers instead of growing them
+  {
+    StringBuffer sb(16);
+    sb.setSegmentSize(64);
+    std::string expected;
+    for (int i = 0; i < 100; i++) {
+      sb.append("0123456789", i % 11);
+      sb.append(i);
+      expected.append("0123456789", i % 11);
+      expected += String(i).c_str();
+    }
+    VERIFY(sb.size() == (int)expected.size());
+
+    std::vector<StringSlice> segments;
+    sb.getSegments(segments);
+    VERIFY(segments.size() > 1);
+    std::string joined;
+    for (unsigned int i = 0; i < segments.size(); i++) {
+      joined.append(segments[i].ptr, segments[i].len);
+    }
+    VS(String(joined), String(expected));
+
+    // contiguous access joins the segments
+    VS(String(sb.data(), sb.size(), CopyString), String(expected));
+    segments.clear();
+    sb.getSegments(segments);
+    VERIFY(segments.size() == 1);
+    sb.append('!');
+    VS(sb.detach(), String(expected + "!"));
+  }
+  {
+    StringBuffer sb(16);
+    sb.setSegmentSize(32);
+    for (int i = 0; i < 10; i++) sb.append("abcdefghij", 10);
+    sb.resize(95);
+    VS(sb.copy(), String(std::string(
+      "abcdefghijabcdefghijabcdefghijabcdefghijabcdefghij"
+      "abcdefghijabcdefghijabcdefghijabcdefghijabcde")));
+    sb.resize(5);
+    VS(sb.detach(), "abcde");
+
+    StringBuffer from(16);
+    from.setSegmentSize(32);
+    for (int i = 0; i < 10; i++) from.append("0123456789", 10);
+    StringBuffer to;
+    to.absorb(from);
+    VERIFY(from.empty());
+    VERIFY(to.size() == 100);
+    VS(to.detach().substr(90), "0123456789");
+  }
+
+  return Count(true);
+}
+
 bool TestCppBase::TestArray() {
   // Array::Create(), Array constructors and informational
   {
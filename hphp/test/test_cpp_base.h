@@ -54,6 +54,7 @@ class TestCppBase : public TestBase {
    * PHP's results.
    */
   bool TestString();
+  bool TestStringBuffer();
   bool TestArray();
   bool TestObject();
   bool TestVariant();
@@ -17,6 +17,7 @@
 #include <test/test_ext_apc.h>
 #include <runtime/ext/ext_apc.h>
 #include <runtime/ext/ext_options.h>
+#include <runtime/ext/ext_variable.h>
 #include <runtime/base/shared/shared_store_base.h>
 #include <runtime/base/runtime_option.h>
 #include <runtime/base/program_functions.h>
@@ -143,6 +144,20 @@ bool TestExtApc::test_apc_store() {
   VERIFY(tsFetched.get() != sharedString.get());
   VS(f_apc_fetch("ts"), "NewValue");
 
+  // records sharing non-static keys only spell each key out once
+  Array records;
+  for (int i = 0; i < 100; i++) {
+    Array record;
+    for (int j = 0; j < 4; j++) {
+      record.set(String("field_name_") + String(j), i * j);
+    }
+    record.set(String("name_") + String(i), i);
+    records.append(record);
+  }
+  String packed = apc_serialize(records);
+  VERIFY(packed.size() < f_serialize(records).toString().size() / 2);
+  VS(apc_unserialize(packed), records);
+
   return Count(true);
 }
 
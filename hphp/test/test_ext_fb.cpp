@@ -193,6 +193,15 @@ bool TestExtFb::test_fb_utf8ize() {
         VS(s, "test\xE0\xB0\xB1");
       }
     }
+    {
+      Variant s = "a long run of plain ascii text before hon\xE7k";
+      VERIFY(f_fb_utf8ize(ref(s)));
+      if (RuntimeOption::Utf8izeReplace) {
+        VS(s, "a long run of plain ascii text before hon\uFFFDk");
+      } else {
+        VS(s, "a long run of plain ascii text before honk");
+      }
+    }
     {
       Variant s = "\xfc";
       VERIFY(f_fb_utf8ize(ref(s)));
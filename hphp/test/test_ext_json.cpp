@@ -16,6 +16,8 @@
 
 #include <test/test_ext_json.h>
 #include <runtime/ext/ext_json.h>
+#include <runtime/ext/ext_variable.h>
+#include <runtime/base/runtime_option.h>
 #include <system/lib/systemlib.h>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -80,6 +82,43 @@ bool TestExtJson::test_json_encode() {
     "    }\n"
     "}");
 
+  VS(f_json_encode("plain text long enough to take the bulk path/<a&b>"
+                   " 'quoted' \"x\" 50% @home \xC3\xA9\t",
+                   k_JSON_HEX_TAG | k_JSON_HEX_AMP),
+     "\"plain text long enough to take the bulk path\\/\\u003Ca\\u0026b\\u003E"
+     " 'quoted' \\\"x\\\" 50% @home \\u00e9\\t\"");
+
+  Array big;
+  for (int i = 0; i < 10000; i++) {
+    big.append(CREATE_MAP2("id", i, "name", "some fairly ordinary text"));
+  }
+  g_context->obStart();
+  VS(f_json_encode(big, k_JSON_FB_STREAM), "");
+  String streamed = g_context->obCopyContents();
+  g_context->obEnd();
+  VS(streamed, f_json_encode(big));
+
+  // the size limit covers the whole stream, and nothing is written when
+  // it's exceeded
+  int64 save = RuntimeOption::SerializationSizeLimit;
+  RuntimeOption::SerializationSizeLimit = streamed.size() / 2;
+  bool limited = false;
+  g_context->obStart();
+  try {
+    f_json_encode(big, k_JSON_FB_STREAM);
+  } catch (StringBufferLimitException &e) {
+    limited = true;
+  }
+  String partial = g_context->obCopyContents();
+  g_context->obEnd();
+  VERIFY(limited);
+  VERIFY(partial.empty());
+  g_context->obStart();
+  f_json_encode(big, k_JSON_FB_STREAM | k_JSON_FB_UNLIMITED);
+  VS(g_context->obCopyContents(), streamed);
+  g_context->obEnd();
+  RuntimeOption::SerializationSizeLimit = save;
+
   return Count(true);
 }
 
@@ -133,5 +172,33 @@ bool TestExtJson::test_json_decode() {
      (CREATE_MAP1("a", CREATE_VECTOR1(CREATE_MAP1("n", "1st"))),
       CREATE_MAP1("b", CREATE_VECTOR1(CREATE_MAP1("n", "2nd")))));
 
+  VS(f_json_decode("[1.,0.e1,-0,1E+2,12345678901234567890]", true),
+     CREATE_VECTOR5(1.0, 0.0, 0, 100.0, 12345678901234567890.0));
+  VS(f_json_decode("[0e1]", true), null);
+  VS(f_json_decode("[01]",  true), null);
+  VS(f_json_decode("[-]",   true), null);
+  VS(f_json_decode("[1e]",  true), null);
+  VS(f_json_decode("[\"\\u00e9\\ud83d\\ude00\\/\\n\xC3\xA9\"]", true),
+     CREATE_VECTOR1("\xC3\xA9\xF0\x9F\x98\x80/\n\xC3\xA9"));
+  VS(f_json_decode("[\"a\tb\"]", true), null);
+  VS(f_json_decode("[\"\xC0\xAF\"]", true), null);
+  VS(f_json_decode("[\"\xED\xA0\x80\"]", true), null);
+  VS(f_json_decode("[\"\\x\"]", true), null);
+
+  // the fast path and the state machine (used for the loose dialect) agree
+  static const char *docs[] = {
+    "{\"a\":{\"b\":[1,2,{\"c\":null}],\"\":true},\"d\":-1.5e-3}",
+    " [ \"x\" , [ ] , { } , false ]\r\n",
+    "\"plain string that is long enough to be scanned in blocks\"",
+    "{\"k\\\"q\":\"\\ud83d\", \"7\":\"\\ude00\\ud83d\\ude00\"}",
+    "[9223372036854775807,9223372036854775808,-9223372036854775808]",
+  };
+  for (unsigned int i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+    VS(f_json_decode(docs[i], true),
+       f_json_decode(docs[i], true, k_JSON_FB_LOOSE));
+    VS(f_serialize(f_json_decode(docs[i])),
+       f_serialize(f_json_decode(docs[i], false, k_JSON_FB_LOOSE)));
+  }
+
   return Count(true);
 }
@@ -18,6 +18,8 @@
 #include <runtime/ext/ext_preg.h>
 #include <runtime/ext/ext_array.h>
 #include <runtime/ext/ext_string.h>
+#include <runtime/base/preg.h>
+#include <runtime/base/runtime_option.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -30,6 +32,12 @@ bool TestExtPreg::RunTests(const std::string &which) {
                          "function next_year($m) {"
                          "  return $m[1].((int)$m[2] + 1);"
                          "}"
+                         "function churn_pcre($m) {"
+                         "  for ($i = 0; $i < 40; $i++) {"
+                         "    preg_match('/churn'.$i.'/', $m[0]);"
+                         "  }"
+                         "  return strtoupper($m[0]);"
+                         "}"
                         );
 
   RUN_TEST(test_preg_grep);
@@ -94,6 +102,60 @@ bool TestExtPreg::test_preg_match() {
      "    [2] => 2008\n"
      ")\n");
 
+  // plain strings and single classes are matched without PCRE
+  VS(f_preg_match("/b.c/", "abxc"), 1);
+  VS(f_preg_match("/b\\.c/", "abxc"), 0);
+  f_preg_match("/b\\.c/", "ab.cd", ref(matches));
+  VS(matches[0], "b.c");
+  f_preg_match("/[0-9]+/", "ab 123 45", ref(matches));
+  VS(matches[0], "123");
+  f_preg_match("/[0-9]+/U", "ab 123 45", ref(matches));
+  VS(matches[0], "1");
+  f_preg_match("/[^a-z ]+/", "ab 1C3 45", ref(matches));
+  VS(matches[0], "1C3");
+  f_preg_match("/[b-d]+/i", "aBcDe", ref(matches));
+  VS(matches[0], "BcD");
+  f_preg_match("/[^b-d]+/i", "BcDeFg", ref(matches));
+  VS(matches[0], "eFg");
+  f_preg_match("/[]x-]+/", "ab-]x]c", ref(matches));
+  VS(matches[0], "-]x]");
+  f_preg_match("/\\d+/", "x42y", ref(matches));
+  VS(matches[0], "42");
+  VS(f_preg_match("/ab/", "abab", ref(matches), 0, 1), 1);
+  VS(f_preg_match("/ab/", "abab", ref(matches), 0, 3), 0);
+  VS(f_preg_replace("/o/", "0", "foo boo"), "f00 b00");
+  VS(f_preg_replace("/[aeiou]+/", "_", "queue it"), "q_ _t");
+  VS(f_preg_split("/, /", "a, b, c"), CREATE_VECTOR3("a", "b", "c"));
+
+  // a pattern with more subpatterns than fit in the inline offsets
+  String many = f_str_repeat("(a)", 40);
+  VS(f_preg_match(String("/") + many + "/", f_str_repeat("a", 41),
+                  ref(matches)), 1);
+  VS(matches[40], "a");
+
+  // the compiled pattern cache stays bounded; evicted patterns recompile
+  int cacheSize = RuntimeOption::PregCacheSize;
+  RuntimeOption::PregCacheSize = 16;
+  for (int i = 0; i < 100; i++) {
+    VS(f_preg_match(String("/x") + String(i) + "y/",
+                    String("ax") + String(i) + "yb"), 1);
+  }
+  VERIFY(preg_pcre_cache_size() <= 16);
+  VS(f_preg_match("/x0y/", "x0y"), 1);
+  if (!hhvm) {
+    // nothing runs the Treadmill here, so evicted entries are freed at once
+    VERIFY(preg_pcre_entry_count() <= 16);
+  }
+
+  // a pattern evicted while its own callback churns the cache stays usable
+  VS(f_preg_replace_callback("/[a-z]+/", "churn_pcre", "ab, cd, ef"),
+     "AB, CD, EF");
+  VERIFY(preg_pcre_cache_size() <= 16);
+  if (!hhvm) {
+    VERIFY(preg_pcre_entry_count() <= 16);
+  }
+  RuntimeOption::PregCacheSize = cacheSize;
+
   return Count(true);
 }
 
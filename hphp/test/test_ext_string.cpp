@@ -145,6 +145,8 @@ bool TestExtString::test_stripcslashes() {
 
 bool TestExtString::test_addslashes() {
   VS(f_addslashes("'\"\\\n"), "\\'\\\"\\\\\n");
+  VS(f_addslashes("0123456789abcdef0123456789'abcdef\"tail\\"),
+     "0123456789abcdef0123456789\\'abcdef\\\"tail\\\\");
   return Count(true);
 }
 
@@ -186,11 +188,17 @@ bool TestExtString::test_strrev() {
 
 bool TestExtString::test_strtolower() {
   VS(f_strtolower("ABC"), "abc");
+  String upper = f_str_repeat("ABCDEFGHIJKLMNOPQRSTUVWXYZ[@`{0123", 5);
+  String lower = f_str_repeat("abcdefghijklmnopqrstuvwxyz[@`{0123", 5);
+  VS(f_strtolower(upper), lower);
   return Count(true);
 }
 
 bool TestExtString::test_strtoupper() {
   VS(f_strtoupper("abc"), "ABC");
+  String upper = f_str_repeat("ABCDEFGHIJKLMNOPQRSTUVWXYZ[@`{0123", 5);
+  String lower = f_str_repeat("abcdefghijklmnopqrstuvwxyz[@`{0123", 5);
+  VS(f_strtoupper(lower), upper);
   return Count(true);
 }
 
@@ -215,6 +223,10 @@ bool TestExtString::test_strip_tags() {
   VS(f_strip_tags(text), "Test paragraph. Other text");
   VS(f_strip_tags(text, "<p><a>"),
      "<p>Test paragraph.</p> <a href=\"#fragment\">Other text</a>");
+  VS(f_strip_tags("no tags at all, just \"text\" > here"),
+     "no tags at all, just \"text\" > here");
+  VS(f_strip_tags("a long prefix before the tag <b>bold</b>"),
+     "a long prefix before the tag bold");
   return Count(true);
 }
 
@@ -513,6 +525,9 @@ bool TestExtString::test_htmlspecialchars_decode() {
 bool TestExtString::test_htmlspecialchars() {
   VS(f_htmlspecialchars("<a href='test'>Test</a>", k_ENT_QUOTES),
      "&lt;a href=&#039;test&#039;&gt;Test&lt;/a&gt;");
+  VS(f_htmlspecialchars("a long run of plain text before <b> & after it",
+                        k_ENT_QUOTES),
+     "a long run of plain text before &lt;b&gt; &amp; after it");
 
   VS(f_bin2hex(f_htmlspecialchars("\xA0", k_ENT_COMPAT)), "a0");
   VS(f_bin2hex(f_htmlspecialchars("\xc2\xA0", k_ENT_COMPAT, "")), "c2a0");
@@ -524,6 +539,9 @@ bool TestExtString::test_htmlspecialchars() {
   VS(f_fb_htmlspecialchars("abcdef'\"{}@gz", k_ENT_QUOTES,
                            "", Array::Create("z")),
      "abcdef&#039;&quot;&#123;&#125;&#064;g&#122;");
+  VS(f_fb_htmlspecialchars("a long run of plain text before <b> & after it",
+                           k_ENT_QUOTES, "", Array::Create()),
+     "a long run of plain text before &lt;b&gt; &amp; after it");
 
   VS(f_fb_htmlspecialchars("abcdef'\"\u00a1\uabcd", k_ENT_FB_UTF8,
                            "", Array::Create("d")),
@@ -860,6 +878,8 @@ bool TestExtString::test_strpos() {
   VS(f_strpos("abcdef abcdef", "a", 1), 7);
   VS(f_strpos("abcdef abcdef", "A", 1), false);
   VS(f_strpos("abcdef abcdef", "", 0), false);
+  VS(f_strpos("0123456789abcdef0123456789abcdef0123456789xyz", "9xy"), 41);
+  VS(f_strpos("0123456789abcdef0123456789abcdef0123456789xyz", "9xz"), false);
   return Count(true);
 }
 
@@ -385,6 +385,18 @@ bool TestExtVariable::test_unserialize() {
     Variant v2 = f_unserialize("a:3:{s:1:\"a\";s:5:\"apple\";s:1:\"b\";i:2;s:1:\"c\";a:3:{i:0;i:1;i:1;s:1:\"y\";i:2;i:3;}}");
     VS(v1, v2);
   }
+  {
+    // repeated keys are allocated once and shared
+    Variant v = f_unserialize("a:2:{i:0;a:1:{s:6:\"row_id\";i:1;}"
+                              "i:1;a:1:{s:6:\"row_id\";i:2;}}");
+    VS(v, CREATE_VECTOR2(CREATE_MAP1("row_id", 1), CREATE_MAP1("row_id", 2)));
+    ArrayIter first(v[0].toArray());
+    ArrayIter second(v[1].toArray());
+    VERIFY(first.first().getStringData() == second.first().getStringData());
+
+    VS(f_unserialize("a:1:{s:3:\"a\"b\";i:1;}"), CREATE_MAP1("a\"b", 1));
+    VS(f_unserialize("a:1:{s:9:\"row_id\";i:1;}"), false);
+  }
   return Count(true);
 }
 
@@ -18,6 +18,7 @@
 #include <runtime/ext/ext_zlib.h>
 #include <runtime/ext/ext_file.h>
 #include <runtime/ext/ext_output.h>
+#include <util/compression.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -55,6 +56,7 @@ bool TestExtZlib::RunTests(const std::string &which) {
   RUN_TEST(test_lz4compress);
   RUN_TEST(test_lz4hccompress);
   RUN_TEST(test_lz4uncompress);
+  RUN_TEST(test_response_compressor);
 
   return ret;
 }
@@ -328,3 +330,43 @@ bool TestExtZlib::test_lz4uncompress() {
 
   return Count(true);
 }
+
+bool TestExtZlib::test_response_compressor() {
+  std::string text;
+  for (int i = 0; i < 100; i++) {
+    text += "testing response compression ";
+  }
+  int half = text.size() / 2;
+  int len;
+
+  // gzip: the chunks make up one stream
+  ResponseCompressor *c = ResponseCompressor::Create(CODING_GZIP, 3);
+  VS(c->getEncoding(), "gzip");
+  len = half;
+  char *p = c->compress(text.data(), len, false);
+  String gz(p, len, CopyString);
+  free(p);
+  len = text.size() - half;
+  p = c->compress(text.data() + half, len, true);
+  gz += String(p, len, CopyString);
+  free(p);
+  delete c;
+  VS(f_gzdecode(gz), String(text));
+
+  // lz4: every chunk is an lz4compress() frame of its own
+  c = ResponseCompressor::Create(CODING_LZ4, 3);
+  VS(c->getEncoding(), "lz4");
+  len = half;
+  p = c->compress(text.data(), len, false);
+  VERIFY(len < half);
+  VS(f_lz4uncompress(String(p, len, CopyString)), String(text.substr(0, half)));
+  free(p);
+  len = 0;
+  p = c->compress("", len, true);
+  VS(len, 0);
+  free(p);
+  delete c;
+
+  VERIFY(ResponseCompressor::Create(0, 3) == nullptr);
+  return Count(true);
+}
@@ -58,6 +58,7 @@ class TestExtZlib : public TestCppExt {
   bool test_lz4compress();
   bool test_lz4hccompress();
   bool test_lz4uncompress();
+  bool test_response_compressor();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
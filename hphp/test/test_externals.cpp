@@ -18,6 +18,7 @@
 #include <runtime/base/class_info.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/ext/ext_string.h>
+#include <runtime/ext/ext_preg.h>
 #include <runtime/ext/ext_network.h>
 #include <runtime/ext/ext_soap.h>
 #include <runtime/base/program_functions.h>
@@ -157,6 +158,13 @@ Variant invokeImpl(void *extra, CArrRef params) {
     Array matches = params[0].toArray();
     return matches[1].toString() + String(matches[2].toInt32() + 1);
   }
+  if (strcasecmp(function, "churn_pcre") == 0) {
+    String match = params[0].toArray()[0].toString();
+    for (int i = 0; i < 40; i++) {
+      f_preg_match(String("/churn") + String(i) + "/", match);
+    }
+    return f_strtoupper(match);
+  }
 
   // for TestExtArray::test_array_filter
   if (strcasecmp(function, "odd") == 0) {
@@ -16,6 +16,8 @@
 
 #include <test/test_performance.h>
 #include <util/util.h>
+#include <util/http_parser.h>
+#include <runtime/base/server/transport.h>
 
 #define PERF_LOOP_COUNT "500"
 
@@ -47,6 +49,12 @@ bool TestPerformance::RunTests(const std::string &which) {
   bool ret = true;
   RUN_TEST(TestBasicOperations);
   RUN_TEST(TestMemoryUsage);
+  RUN_TEST(TestStringKernels);
+  RUN_TEST(TestJsonCodec);
+  RUN_TEST(TestPreg);
+  RUN_TEST(TestSerialization);
+  RUN_TEST(TestOutputBuffering);
+  RUN_TEST(TestHttpParser);
   RUN_TEST(TestAdHocFile);
   RUN_TEST(TestAdHoc);
   return ret;
@@ -145,6 +153,234 @@ bool TestPerformance::TestMemoryUsage() {
   return true;
 }
 
+/*
+ * String builtins backed by the vectorized kernels in zend_string.cpp,
+ * zend_html.cpp and fb_utf8ize, on short, medium and long inputs.
+ */
+bool TestPerformance::TestStringKernels() {
+  static const char *sizes[] = { "1", "8", "256" };
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    string setup = string("$s = str_repeat('Hello <b>World</b> it\\'s ', ") +
+      sizes[i] + "); $u = strtoupper($s);\n";
+    string label = string("\n\n/* x") + sizes[i] + " */";
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = strpos($s, 'missing needle'); }" + label +
+         " /* strpos */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = strtolower($u); }" + label +
+         " /* strtolower */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = addslashes($s); }" + label +
+         " /* addslashes */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = strip_tags($s); }" + label +
+         " /* strip_tags */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = htmlspecialchars($s); }" + label +
+         " /* htmlspecialchars */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = $s; fb_utf8ize($k); }" + label +
+         " /* fb_utf8ize */" PERF_END).c_str());
+  }
+  return true;
+}
+
+bool TestPerformance::TestJsonCodec() {
+  static const char *sizes[] = { "1", "10", "200" };
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    // shaped like a typical service response
+    string setup = string("$v = array();\n"
+      "for ($n = 0; $n < ") + sizes[i] + "; $n++) {\n"
+      "  $v[] = array('id' => 100000 + $n, 'score' => $n / 7,\n"
+      "               'name' => \"user $n\", 'active' => ($n % 2) == 0,\n"
+      "               'tags' => array('a', 'b/c', \"caf\\xC3\\xA9\"),\n"
+      "               'bio' => str_repeat('Lorem ipsum \"dolor\" sit. ', 4),\n"
+      "               'extra' => null);\n"
+      "}\n"
+      "$j = json_encode(array('data' => $v, 'paging' => array('n' => 1)));\n";
+    string label = string("\n\n/* x") + sizes[i] + " */";
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = json_decode($j, true); }" + label +
+         " /* json_decode assoc */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = json_decode($j); }" + label +
+         " /* json_decode objects */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = json_encode($v); }" + label +
+         " /* json_encode */" PERF_END).c_str());
+  }
+  return true;
+}
+
+bool TestPerformance::TestPreg() {
+  static const char *sizes[] = { "1", "64" };
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    string setup = string("$s = str_repeat('GET /home.php?id=42 HTTP/1.1 "
+                          "user@example.com 2012-08-01 ', ") + sizes[i] +
+      ");\n";
+    string label = string("\n\n/* x") + sizes[i] + " */";
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = preg_match('/missing/', $s); }" + label +
+         " /* literal */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = preg_match('/[^a-z0-9 .\\/?=@:-]/i', $s); }" + label +
+         " /* character class */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = preg_match_all('/(\\w+)@(\\w+)\\.com/', $s, $m); }" +
+         label + " /* captures */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = preg_replace('/\\d{4}-\\d{2}-\\d{2}/', 'DATE', $s); }" +
+         label + " /* replace */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = preg_split('/\\s+/', $s); }" + label +
+         " /* split */" PERF_END).c_str());
+  }
+  return true;
+}
+
+bool TestPerformance::TestSerialization() {
+  static const char *sizes[] = { "10", "1000" };
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    // rows with keys that are not literals, as they come back from a database
+    string setup = string("$v = array();\n"
+      "for ($n = 0; $n < ") + sizes[i] + "; $n++) {\n"
+      "  $v[] = json_decode('{\"user_id\":' . (100000 + $n) . ',"
+      "\"display_name\":\"user ' . $n . '\",\"is_active\":true,"
+      "\"created_time\":1343779200,\"score\":0.5}');\n"
+      "}\n";
+    string label = string("\n\n/* x") + sizes[i] + " */";
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ apc_store('perf', $v); $k = apc_fetch('perf'); }" + label +
+         " /* apc store + fetch */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = unserialize(serialize($v)); }" + label +
+         " /* serialize + unserialize */" PERF_END).c_str());
+
+    // session and cache payloads are read far more often than written
+    VCR((PERF_START + setup +
+         "$a = serialize(json_decode(json_encode($v), true));\n"
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = unserialize($a); }" + label +
+         " /* unserialize arrays */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "$a = json_decode(json_encode($v), true);\n"
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) "
+         "{ $k = fb_compact_unserialize(fb_compact_serialize($a)); }" +
+         label + " /* fb_compact_serialize + unserialize */" PERF_END).c_str());
+
+    VCR((PERF_START + setup +
+         "$a = json_decode(json_encode($v), true);\n"
+         "print strlen(serialize($v)) . ' serialize, ' .\n"
+         "      strlen(fb_serialize($a)) . ' fb_serialize, ' .\n"
+         "      strlen(fb_compact_serialize($a)) . ' fb_compact_serialize "
+         "bytes, ';\n" + label + " /* sizes */" PERF_END).c_str());
+  }
+  return true;
+}
+
+bool TestPerformance::TestOutputBuffering() {
+  static const char *sizes[] = { "100", "10000" };
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    string setup = string("$row = '<tr><td>' . str_repeat('x', ") + sizes[i] +
+      ") . '</td></tr>';\n";
+    string label = string("\n\n/* x") + sizes[i] + " */";
+
+    VCR((PERF_START + setup +
+         "ob_start();\n"
+         "for ($i = 0; $i < " PERF_LOOP_COUNT "; $i++) { echo $row; }\n"
+         "$k = strlen(ob_get_clean());" + label +
+         " /* echo into an output buffer */" PERF_END).c_str());
+  }
+  return true;
+}
+
+/*
+ * HttpParser on a typical browser request, by itself and then also copying
+ * the headers into a HeaderMap, as evhttp based transports end up doing.
+ */
+bool TestPerformance::TestHttpParser() {
+  static const char req[] =
+    "GET /index.php?id=12345&ref=home HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.4 "
+    "(KHTML, like Gecko) Chrome/22.0.1229.94 Safari/537.4\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.8\r\n"
+    "Accept-Encoding: gzip,deflate,sdch\r\n"
+    "Accept-Charset: ISO-8859-1,utf-8;q=0.7,*;q=0.3\r\n"
+    "Cookie: datr=abcdefghijklmnop; lu=qrstuvwxyz; c_user=1234567890\r\n"
+    "Referer: http://www.example.com/home.php\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+  const int count = 1000000;
+  int size = sizeof(req) - 1;
+  int64 total = 0;
+  HttpParser parser;
+
+  timespec start, end;
+  gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < count; i++) {
+    parser.reset();
+    parser.parse(req, size);
+    total += parser.headers().size();
+  }
+  gettime(CLOCK_MONOTONIC, &end);
+  int64 parseNs = gettime_diff_us(start, end) * 1000 / count;
+
+  gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < count; i++) {
+    parser.reset();
+    parser.parse(req, size);
+    HeaderMap headers;
+    for (unsigned int j = 0; j < parser.headers().size(); j++) {
+      const HttpParser::Header &header = parser.headers()[j];
+      headers[header.name.str()].push_back(header.value.str());
+    }
+    total += headers.size();
+  }
+  gettime(CLOCK_MONOTONIC, &end);
+  int64 copyNs = gettime_diff_us(start, end) * 1000 / count;
+
+  printf("HttpParser, %d byte request: %" PRId64 "ns, "
+         "%" PRId64 "ns with a HeaderMap (%" PRId64 " headers)\n",
+         size, parseNs, copyNs, total);
+  return true;
+}
+
 bool TestPerformance::TestAdHocFile() {
   string input;
   FILE *f = fopen("test/perf_ad_hoc.php", "r");
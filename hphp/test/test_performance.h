@@ -32,6 +32,12 @@ class TestPerformance : public TestCodeRun {
 
   bool TestBasicOperations();
   bool TestMemoryUsage();
+  bool TestStringKernels();
+  bool TestJsonCodec();
+  bool TestPreg();
+  bool TestSerialization();
+  bool TestOutputBuffering();
+  bool TestHttpParser();
   bool TestAdHocFile();
   bool TestAdHoc();
 };
@@ -0,0 +1,77 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <test/test_repo.h>
+#include <compiler/parser/parser.h>
+#include <compiler/builtin_symbols.h>
+#include <compiler/analysis/analysis_result.h>
+#include <compiler/analysis/emitter.h>
+#include <compiler/analysis/file_scope.h>
+#include <compiler/option.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool TestRepo::RunTests(const std::string &which) {
+  bool ret = true;
+  RUN_TEST(TestUnitFingerprint);
+  return ret;
+}
+
+/*
+ * Analyzes a program made of a.php (parent) and b.php (child), and returns
+ * the unit fingerprint of a.php.
+ */
+std::string TestRepo::Fingerprint(const char *parent, const char *child) {
+  WithOpt w0(Option::WholeProgram);
+
+  Type::ResetTypeHintTypes();
+  Type::InitTypeHintMap();
+  BuiltinSymbols::LoadSuperGlobals();
+
+  AnalysisResultPtr ar(new AnalysisResult());
+  Compiler::Parser::ParseString(parent, ar, "a.php");
+  Compiler::Parser::ParseString(child, ar, "b.php");
+  BuiltinSymbols::Load(ar);
+  ar->analyzeProgram();
+  ar->inferTypes();
+  ar->analyzeProgramFinal();
+  FileScopePtr fsp = ar->findFileScope("a.php");
+  if (!fsp) return "";
+  return Compiler::unitFingerprint(fsp).toString();
+}
+
+bool TestRepo::TestUnitFingerprint() {
+  const char *parent =
+    "<?php "
+    "class A { function f() { return 'A'; } } "
+    "function call_f(A $a) { return $a->f(); }";
+
+  string base = Fingerprint(parent, "<?php class B extends A {}");
+  VERIFY(!base.empty());
+
+  // A change elsewhere that a.php does not depend on keeps its unit.
+  VERIFY(Fingerprint(parent,
+                     "<?php class B extends A {} function g() {}") == base);
+
+  // Overriding A::f() in another file clears AttrNoOverride on it, so
+  // a.php must be emitted again even though neither a.php nor anything
+  // it refers to changed.
+  VERIFY(Fingerprint(parent,
+                     "<?php class B extends A { "
+                     "function f() { return 'B'; } }") != base);
+
+  return Count(true);
+}
@@ -0,0 +1,37 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __TEST_REPO_H__
+#define __TEST_REPO_H__
+
+#include <test/test_base.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+class TestRepo : public TestBase {
+ public:
+  virtual bool RunTests(const std::string &which);
+
+  // analysis results that decide whether a unit can be reused
+  bool TestUnitFingerprint();
+
+ private:
+  std::string Fingerprint(const char *parent, const char *child);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // __TEST_REPO_H__
@@ -25,6 +25,7 @@
 #include <util/async_func.h>
 #include <runtime/ext/ext_curl.h>
 #include <runtime/ext/ext_options.h>
+#include <runtime/ext/ext_string.h>
 #include <runtime/base/server/http_request_handler.h>
 #include <runtime/base/util/http_client.h>
 #include <runtime/base/runtime_option.h>
@@ -43,6 +44,25 @@ TestServer::TestServer() {
 static int s_server_port = 0;
 static int inherit_fd = -1;
 
+bool TestServer::PrepareServerInput(const char *input) {
+  if (!CleanUp()) return false;
+  if (Option::EnableEval < Option::FullEval) {
+    return GenerateFiles(input, "TestServer") && CompileFiles();
+  }
+
+  string fullPath = "runtime/tmp/string";
+  std::ofstream f(fullPath.c_str());
+  if (!f) {
+    printf("Unable to open %s for write. Run this test from hphp/.\n",
+           fullPath.c_str());
+    return false;
+  }
+
+  f << input;
+  f.close();
+  return true;
+}
+
 bool TestServer::VerifyServerResponse(const char *input, const char *output,
                                       const char *url, const char *method,
                                       const char *header, const char *postdata,
@@ -53,32 +73,48 @@ bool TestServer::VerifyServerResponse(const char *input, const char *output,
   assert(input);
   if (port == 0) port = s_server_port;
 
-  if (!CleanUp()) return false;
-  if (Option::EnableEval < Option::FullEval) {
-    if (!GenerateFiles(input, "TestServer") || !CompileFiles()) {
-      return false;
-    }
-  } else {
-    string fullPath = "runtime/tmp/string";
-    std::ofstream f(fullPath.c_str());
-    if (!f) {
-      printf("Unable to open %s for write. Run this test from hphp/.\n",
-             fullPath.c_str());
-      return false;
-    }
-
-    f << input;
-    f.close();
-  }
+  if (!PrepareServerInput(input)) return false;
 
   AsyncFunc<TestServer> func(this, &TestServer::RunServer);
   func.start();
 
+  string actual = GetServerResponse(url, header, postdata, responseHeader,
+                                    port);
+
+  AsyncFunc<TestServer>(this, &TestServer::StopServer).run();
+  func.waitForEnd();
+
+  bool passed = (actual == output);
+  if (responseHeader) {
+    passed = (actual.find(output) != string::npos);
+  }
+
+  if (!passed) {
+    printf("%s:%d\nParsing: [%s]\nBet %d:\n"
+           "--------------------------------------\n"
+           "%s"
+           "--------------------------------------\n"
+           "Got %d:\n"
+           "--------------------------------------\n"
+           "%s"
+           "--------------------------------------\n",
+           file, line, input, (int)strlen(output), output,
+           (int)actual.length(), actual.c_str());
+    return false;
+  }
+  return true;
+}
+
+string TestServer::GetServerResponse(const char *url, const char *header,
+                                     const char *postdata,
+                                     bool responseHeader,
+                                     int port /* = 0 */) {
+  if (port == 0) port = s_server_port;
   String server = "http://";
   server += f_php_uname("n");
   server += ":" + lexical_cast<string>(port) + "/";
   server += url;
-  string actual, err;
+  string actual;
   for (int i = 0; i < 10; i++) {
     Variant c = f_curl_init();
     f_curl_setopt(c, k_CURLOPT_URL, server);
@@ -101,29 +137,7 @@ bool TestServer::VerifyServerResponse(const char *input, const char *output,
     }
     sleep(1); // wait until HTTP server is up and running
   }
-
-  AsyncFunc<TestServer>(this, &TestServer::StopServer).run();
-  func.waitForEnd();
-
-  bool passed = (actual == output);
-  if (responseHeader) {
-    passed = (actual.find(output) != string::npos);
-  }
-
-  if (!passed) {
-    printf("%s:%d\nParsing: [%s]\nBet %d:\n"
-           "--------------------------------------\n"
-           "%s"
-           "--------------------------------------\n"
-           "Got %d:\n"
-           "--------------------------------------\n"
-           "%s"
-           "--------------------------------------\n",
-           file, line, input, (int)strlen(output), output,
-           (int)actual.length(), actual.c_str());
-    return false;
-  }
-  return true;
+  return actual;
 }
 
 void TestServer::RunServer() {
@@ -131,20 +145,25 @@ void TestServer::RunServer() {
   string portConfig = "Server.Port=" + lexical_cast<string>(s_server_port);
   string fd = lexical_cast<string>(inherit_fd);
 
-  const char *argv[] = {
-    "", "--mode=server", "--config=test/config-server.hdf",
-    "-v", portConfig.c_str(),
-    "--port-fd", fd.c_str(),
-    NULL
-  };
-
+  std::vector<const char *> argv;
   if (Option::EnableEval < Option::FullEval) {
-    argv[0] = "runtime/tmp/TestServer/test";
+    argv.push_back("runtime/tmp/TestServer/test");
   } else {
-    argv[0] = HHVM_PATH;
+    argv.push_back(HHVM_PATH);
+  }
+  argv.push_back("--mode=server");
+  argv.push_back("--config=test/config-server.hdf");
+  argv.push_back("-v");
+  argv.push_back(portConfig.c_str());
+  argv.push_back("--port-fd");
+  argv.push_back(fd.c_str());
+  for (unsigned int i = 0; i < m_serverOptions.size(); i++) {
+    argv.push_back("-v");
+    argv.push_back(m_serverOptions[i].c_str());
   }
+  argv.push_back(NULL);
 
-  Process::Exec(argv[0], argv, NULL, out, &err);
+  Process::Exec(argv[0], &argv[0], NULL, out, &err);
 }
 
 void TestServer::StopServer() {
@@ -184,11 +203,15 @@ bool TestServer::RunTests(const std::string &which) {
   RUN_TEST(TestCookie);
   RUN_TEST(TestResponseHeader);
   RUN_TEST(TestSetCookie);
+  RUN_TEST(TestLargeResponse);
   //RUN_TEST(TestRequestHandling);
   RUN_TEST(TestHttpClient);
   RUN_TEST(TestRPCServer);
   RUN_TEST(TestXboxServer);
+  RUN_TEST(TestXboxResultEncodings);
   RUN_TEST(TestPageletServer);
+  RUN_TEST(TestSandboxShareUnits);
+  RUN_TEST(TestStaticContent);
 
   return ret;
 }
@@ -341,6 +364,18 @@ bool TestServer::TestSetCookie() {
   return true;
 }
 
+bool TestServer::TestLargeResponse() {
+  // spans several output buffer segments, which are sent without joining
+  string large(200000, 'x');
+  VSR("<?php for ($i = 0; $i < 2000; $i++) echo str_repeat('x', 100);",
+      large.c_str());
+
+  VSRES("<?php for ($i = 0; $i < 2000; $i++) echo str_repeat('x', 100);",
+        "Content-Length: 200000");
+
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class TestTransport : public Transport {
@@ -700,9 +735,79 @@ bool TestServer::TestXboxServer() {
         "int(2)\n",
         "string?main=1");
 
+  // return values round trip the same, serialized or as SharedVariants
+  // (Xbox.SharedResults)
+  for (int shared = 0; shared < 2; shared++) {
+    if (shared) m_serverOptions.push_back("Xbox.SharedResults=true");
+    VSGET("<?php\n"
+          "if (array_key_exists('main', $_GET)) {\n"
+          "  foreach (array('s', 'a', 'o') as $msg) {\n"
+          "    xbox_send_message($msg, $r, 5000);\n"
+          "    echo $r['code'], ' ', serialize($r['response']), \"\\n\";\n"
+          "  }\n"
+          "  $t = xbox_task_start('a');\n"
+          "  echo xbox_task_result($t, 0, $r), ' ', serialize($r), \"\\n\";\n"
+          "} else {\n"
+          "  function xbox_process_message($msg) {\n"
+          "    if ($msg == 's') return 'str';\n"
+          "    if ($msg == 'a') {\n"
+          "      return array(1, 'a' => array(2.5, null, true));\n"
+          "    }\n"
+          "    $o = new stdClass;\n"
+          "    $o->p = 'q';\n"
+          "    return $o;\n"
+          "  }\n"
+          "}\n",
+          "200 s:3:\"str\";\n"
+          "200 a:2:{i:0;i:1;s:1:\"a\";a:3:{i:0;d:2.5;i:1;N;i:2;b:1;}}\n"
+          "200 O:8:\"stdClass\":1:{s:1:\"p\";s:1:\"q\";}\n"
+          "200 a:2:{i:0;i:1;s:1:\"a\";a:3:{i:0;d:2.5;i:1;N;i:2;b:1;}}\n",
+          "string?main=1");
+  }
+  m_serverOptions.clear();
+
   return true;
 }
 
+bool TestServer::TestXboxResultEncodings() {
+  // A larger value than TestXboxServer's, sent many times over, comes back
+  // the same serialized and as a SharedVariant. How long the round trips
+  // take with each is reported by the xbox:send latency stat, not here.
+  const char *input =
+    "<?php\n"
+    "if (array_key_exists('main', $_GET)) {\n"
+    "  $all = '';\n"
+    "  for ($i = 0; $i < 100; $i++) {\n"
+    "    xbox_send_message('rows', $r, 5000);\n"
+    "    if ($r['code'] != 200) exit;\n"
+    "    $all .= serialize($r['response']);\n"
+    "  }\n"
+    "  echo count($r['response']), ' ', md5($all);\n"
+    "} else {\n"
+    "  function xbox_process_message($msg) {\n"
+    "    $row = array('id' => 1, 'name' => str_repeat('x', 32), 1.5);\n"
+    "    return array_fill(0, 100, $row);\n"
+    "  }\n"
+    "}\n";
+
+  string actual[2];
+  for (int shared = 0; shared < 2; shared++) {
+    if (shared) m_serverOptions.push_back("Xbox.SharedResults=true");
+    if (!PrepareServerInput(input)) return Count(false);
+
+    AsyncFunc<TestServer> func(this, &TestServer::RunServer);
+    func.start();
+    actual[shared] = GetServerResponse("string?main=1", nullptr, nullptr,
+                                       false);
+    AsyncFunc<TestServer>(this, &TestServer::StopServer).run();
+    func.waitForEnd();
+    m_serverOptions.clear();
+  }
+  VERIFY(actual[0].size() == 36 && actual[0].compare(0, 4, "100 ") == 0);
+  VS(String(actual[1]), String(actual[0]));
+  return Count(true);
+}
+
 bool TestServer::TestPageletServer() {
   VSGET("<?php\n"
         "if (array_key_exists('pagelet', $_GET)) {\n"
@@ -761,3 +866,118 @@ bool TestServer::TestPageletServer() {
 
   return true;
 }
+
+bool TestServer::TestSandboxShareUnits() {
+  if (Option::EnableEval < Option::FullEval) {
+    SKIP(sandboxes need a server that reads php files);
+  }
+  if (!CleanUp()) return false;
+
+  // The same files checked out in two sandboxes share their units. Only
+  // lib/local.php differs, and inc.php includes it relative to itself.
+  string root = Process::GetCurrentDirectory() + "/runtime/tmp/sandboxes";
+  const char *sandboxes[] = { "alpha", "beta" };
+  for (int i = 0; i < 2; i++) {
+    string dir = root + "/" + sandboxes[i] + "/";
+    Util::mkdir(dir + "lib/");
+    std::ofstream index((dir + "index.php").c_str());
+    index << "<?php\n"
+             "include 'lib/inc.php';\n"
+             "echo __FILE__, \"\\n\", __DIR__, \"\\n\", inc_file(), \"\\n\";\n"
+             "$bt = inc_bt();\n"
+             "echo $bt[0]['file'], \"\\n\", $bt[1]['file'], \"\\n\";\n";
+    std::ofstream inc((dir + "lib/inc.php").c_str());
+    inc << "<?php\n"
+           "include 'local.php';\n"
+           "function inc_file() { return __FILE__; }\n"
+           "function inc_bt() { return inc_frames(); }\n"
+           "function inc_frames() { return debug_backtrace(); }\n";
+    std::ofstream local((dir + "lib/local.php").c_str());
+    local << "<?php echo '" << sandboxes[i] << "', \"\\n\";\n";
+    if (!index || !inc || !local) {
+      printf("Unable to write %s. Run this test from hphp/.\n", dir.c_str());
+      return false;
+    }
+  }
+
+  m_serverOptions.push_back("Sandbox.SandboxMode=true");
+  m_serverOptions.push_back("Sandbox.Pattern=^([a-z]+)-sb");
+  m_serverOptions.push_back("Sandbox.FromCommonRoot=true");
+  m_serverOptions.push_back("Sandbox.DirectoriesRoot=" + root);
+  m_serverOptions.push_back("Sandbox.LogsRoot=" + root);
+  m_serverOptions.push_back("Sandbox.ShareUnits=true");
+
+  AsyncFunc<TestServer> func(this, &TestServer::RunServer);
+  func.start();
+  string actual[2];
+  for (int i = 0; i < 2; i++) {
+    string host = string("Host: ") + sandboxes[i] + "-sb";
+    actual[i] = GetServerResponse("index.php", host.c_str(), nullptr, false);
+  }
+  AsyncFunc<TestServer>(this, &TestServer::StopServer).run();
+  func.waitForEnd();
+  m_serverOptions.clear();
+
+  for (int i = 0; i < 2; i++) {
+    string dir = root + "/" + sandboxes[i];
+    string expected = string(sandboxes[i]) + "\n" +
+      dir + "/index.php\n" +
+      dir + "\n" +
+      dir + "/lib/inc.php\n" +
+      dir + "/lib/inc.php\n" +
+      dir + "/index.php\n";
+    VS(String(actual[i]), String(expected));
+  }
+  return Count(true);
+}
+
+bool TestServer::TestStaticContent() {
+  if (Option::EnableEval < Option::FullEval) {
+    SKIP(static files are only served by the eval server here);
+  }
+  if (!CleanUp()) return false;
+
+  // loaded into the static content cache when the server starts
+  const char *content = "0123456789";
+  {
+    std::ofstream f("runtime/tmp/static.txt");
+    f << content;
+    if (!f) {
+      printf("Unable to write runtime/tmp/static.txt. "
+             "Run this test from hphp/.\n");
+      return false;
+    }
+  }
+  string etag = string("\"") + f_md5(content).data() + "\"";
+  string ifNoneMatch = "If-None-Match: W/" + etag;
+
+  m_serverOptions.push_back("StaticFile.Extensions.txt=text/plain");
+  AsyncFunc<TestServer> func(this, &TestServer::RunServer);
+  func.start();
+  string full = GetServerResponse("static.txt", nullptr, nullptr, true);
+  string notModified = GetServerResponse("static.txt", ifNoneMatch.c_str(),
+                                         nullptr, true);
+  string partial = GetServerResponse("static.txt", "Range: bytes=2-5",
+                                     nullptr, true);
+  string unsatisfiable = GetServerResponse("static.txt", "Range: bytes=20-",
+                                           nullptr, true);
+  AsyncFunc<TestServer>(this, &TestServer::StopServer).run();
+  func.waitForEnd();
+  m_serverOptions.clear();
+
+  VERIFY(full.find("HTTP/1.1 200") == 0);
+  VERIFY(full.find("ETag: " + etag + "\r\n") != string::npos);
+  VERIFY(full.find("\r\n\r\n0123456789") != string::npos);
+
+  VERIFY(notModified.find("HTTP/1.1 304") == 0);
+  VERIFY(notModified.find("0123456789") == string::npos);
+
+  VERIFY(partial.find("HTTP/1.1 206") == 0);
+  VERIFY(partial.find("Content-Range: bytes 2-5/10\r\n") != string::npos);
+  VERIFY(partial.substr(partial.size() - 6) == "\r\n2345");
+
+  VERIFY(unsatisfiable.find("HTTP/1.1 416") == 0);
+  VERIFY(unsatisfiable.find("Content-Range: bytes */10\r\n") !=
+         string::npos);
+  return Count(true);
+}
@@ -43,6 +43,7 @@ public:
   // test transport related extension functions
   bool TestResponseHeader();
   bool TestSetCookie();
+  bool TestLargeResponse();
 
   // test multithreaded request processing
   bool TestRequestHandling();
@@ -59,13 +60,28 @@ public:
 
   // test XboxServer
   bool TestXboxServer();
+  bool TestXboxResultEncodings();
 
   // test PageletServer
   bool TestPageletServer();
 
+  // test units shared by sandboxes
+  bool TestSandboxShareUnits();
+
+  // test ETag and Range handling of static content
+  bool TestStaticContent();
+
 protected:
+  // extra "-v" options passed to the server started by RunServer()
+  std::vector<std::string> m_serverOptions;
+
   void RunServer();
   void StopServer();
+  // writes or compiles the "string" page the server will run
+  bool PrepareServerInput(const char *input);
+  std::string GetServerResponse(const char *url, const char *header,
+                                const char *postdata, bool responseHeader,
+                                int port = 0);
   bool VerifyServerResponse(const char *input, const char *output,
                             const char *url, const char *method,
                             const char *header, const char *postdata,
@@ -17,9 +17,26 @@
 #include <test/test_util.h>
 #include <util/logger.h>
 #include <util/lfu_table.h>
+#include <util/latency_histogram.h>
+#include <util/job_queue.h>
+#include <util/http_parser.h>
+#include <util/ssl_session_cache.h>
+#include <util/lock.h>
 #include <runtime/base/complex_types.h>
 #include <runtime/base/shared/shared_string.h>
 #include <runtime/base/zend/zend_string.h>
+#include <runtime/base/server/http_request_handler.h>
+#include <runtime/base/server/access_log.h>
+#include <runtime/base/server/replay_transport.h>
+#include <runtime/base/server/raw_http_transport.h>
+#include <runtime/base/server/replay_benchmark.h>
+#include <runtime/base/server/server_note.h>
+#include <runtime/base/runtime_option.h>
+#include <runtime/base/string_util.h>
+#include <runtime/base/time/timestamp.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #define VERIFY_DUMP(map, exp)                                           \
   if (!(exp)) {                                                         \
@@ -41,6 +58,18 @@ bool TestUtil::RunTests(const std::string &which) {
   RUN_TEST(TestSharedString);
   RUN_TEST(TestCanonicalize);
   RUN_TEST(TestHDF);
+  RUN_TEST(TestLatencyHistogram);
+  RUN_TEST(TestJobQueue);
+  RUN_TEST(TestHttpParser);
+  RUN_TEST(TestSSLSessionCache);
+  RUN_TEST(TestStaticRange);
+  RUN_TEST(TestStaticETag);
+  RUN_TEST(TestStaticZeroCopy);
+  RUN_TEST(TestCompressionDecision);
+  RUN_TEST(TestAccessLogFormat);
+  RUN_TEST(TestAsyncAccessLog);
+  RUN_TEST(TestReplayBenchmark);
+  RUN_TEST(TestRawHttpTransport);
   return ret;
 }
 
@@ -277,3 +306,704 @@ bool TestUtil::TestHDF() {
 
   return Count(true);
 }
+
+bool TestUtil::TestLatencyHistogram() {
+  for (int64 v = 0; v < (1LL << LatencyHistogram::MaxValueBits);
+       v = v * 11 / 10 + 1) {
+    int bucket = LatencyHistogram::BucketOf(v);
+    VERIFY(bucket >= 0 && bucket < LatencyHistogram::BucketCount);
+    int64 highest = LatencyHistogram::HighestValueOf(bucket);
+    VERIFY(highest >= v && highest - v <= v / 32);
+    VERIFY(LatencyHistogram::BucketOf(highest) == bucket);
+  }
+  VERIFY(LatencyHistogram::BucketOf(1LL << 40) ==
+         LatencyHistogram::BucketCount - 1);
+
+  LatencyHistogram h;
+  VERIFY(h.count() == 0);
+  VERIFY(h.percentile(50) == 0);
+  for (int i = 1; i <= 10000; i++) {
+    h.record(i);
+  }
+  VERIFY(h.count() == 10000);
+  VERIFY(h.min() == 1);
+  VERIFY(h.max() == 10000);
+  VERIFY(h.sum() == 50005000);
+  VERIFY(h.percentile(50) >= 5000 && h.percentile(50) <= 5000 * 33 / 32);
+  VERIFY(h.percentile(99) >= 9900 && h.percentile(99) <= 9900 * 33 / 32);
+  VERIFY(h.percentile(100) == 10000);
+
+  h.clear();
+  VERIFY(h.count() == 0);
+  VERIFY(h.min() == 0);
+  return Count(true);
+}
+
+bool TestUtil::TestJobQueue() {
+  int a, b;
+  {
+    JobQueue<int> q(1, false, 0, false, false);
+    for (int i = 0; i < 4; i++) {
+      q.enqueue(10 + i, &a);
+    }
+    q.enqueue(20, &b);
+    q.enqueue(30);
+    q.enqueue(21, &b);
+    VERIFY(q.getQueuedJobs() == 7);
+    VERIFY(q.promote(13, &a));
+    VERIFY(!q.promote(99, &a));
+    VERIFY(!q.promote(20, &a));
+
+    // the promoted job first, then owners take turns
+    int expected[] = { 13, 20, 30, 10, 21, 11, 12 };
+    for (int i = 0; i < 7; i++) {
+      VERIFY(q.dequeue(0) == expected[i]);
+    }
+    VERIFY(q.getQueuedJobs() == 0);
+  }
+  {
+    JobQueue<int> q(1, false, 0, false, true);
+    for (int i = 0; i < 3; i++) {
+      q.enqueue(i, &a);
+    }
+    for (int i = 2; i >= 0; i--) {
+      VERIFY(q.dequeue(0) == i);
+    }
+  }
+  {
+    JobQueue<int> q(1, false, 0, false, false);
+    q.enqueue(1);
+    q.enqueue(2);
+    q.enqueuePriority(9);
+    bool expired;
+    VERIFY(q.dequeue(0, false, &expired) == 9 && !expired);
+
+    // a whole interval with every wait over target: overloaded
+    q.setLoadShedding(1, 1);
+    usleep(5000);
+    VERIFY(q.dequeue(0, false, &expired) == 1 && !expired);
+    VERIFY(q.getEstimatedWait() >= 5000);
+    usleep(2000);
+    VERIFY(q.dequeue(0, false, &expired) == 2 && expired);
+    VERIFY(q.getEstimatedWait() == 0);
+  }
+  return Count(true);
+}
+
+static bool within(folly::StringPiece s, const std::string &buf) {
+  return s.empty() ||
+    (s.begin() >= buf.data() && s.end() <= buf.data() + buf.size());
+}
+
+bool TestUtil::TestHttpParser() {
+  {
+    std::string req =
+      "\r\nGET /index.php?a=1 HTTP/1.1\r\n"
+      "Host: www.example.com\r\n"
+      "accept-encoding:  gzip, deflate \r\n"
+      "X-Empty:\r\n"
+      "\r\n"
+      "body";
+    int headSize = req.size() - 4;
+    HttpParser parser;
+    // fed a byte at a time, it finishes once the whole head is there
+    for (int i = 0; i < headSize; i++) {
+      VERIFY(parser.parse(req.data(), i) == HttpParser::Incomplete);
+    }
+    VERIFY(parser.parse(req.data(), req.size()) == HttpParser::Done);
+    VERIFY(parser.headSize() == headSize);
+    VERIFY(parser.method().str() == "GET");
+    VERIFY(parser.url().str() == "/index.php?a=1");
+    VERIFY(parser.versionMajor() == 1 && parser.versionMinor() == 1);
+    VERIFY(parser.headers().size() == 3);
+    VERIFY(parser.getHeader("host").str() == "www.example.com");
+    VERIFY(parser.getHeader("Accept-Encoding").str() == "gzip, deflate");
+    VERIFY(parser.getHeader("X-Empty").empty());
+    VERIFY(parser.getHeader("Missing").empty());
+    VERIFY(parser.getHeader("Host").data() ==
+           req.data() + req.find("www.example.com"));
+    VERIFY(parser.keepAlive());
+    VERIFY(parser.contentLength() == -1 && !parser.chunked());
+  }
+  {
+    HttpParser parser;
+    const char *req = "POST /x HTTP/1.0\nContent-Length: 12\n"
+      "Connection: keep-alive\n\n";
+    VERIFY(parser.parse(req, strlen(req)) == HttpParser::Done);
+    VERIFY(parser.contentLength() == 12 && parser.keepAlive());
+
+    parser.reset();
+    req = "POST /x HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n"
+      "Connection: Upgrade, close\r\n\r\n";
+    VERIFY(parser.parse(req, strlen(req)) == HttpParser::Done);
+    VERIFY(parser.chunked() && !parser.keepAlive());
+  }
+  {
+    static const char *bad[] = {
+      "GET / HTTP/1.1\r\n Folded: header\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost : x\r\n\r\n",
+      "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+      "GET / HTTP/1.1\r\nA: b\rc\r\n\r\n",
+      "GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+      "GET / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+      "GET / HTTP/1.1\r\nContent-Length: 1\r\n"
+      "Transfer-Encoding: chunked\r\n\r\n",
+      "GET / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n",
+      "GET /\r\n\r\n",
+      "GET  / HTTP/1.1\r\n\r\n",
+      "GET / HTTP/2.0\r\n\r\n",
+      "G(T / HTTP/1.1\r\n\r\n",
+    };
+    for (unsigned int i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+      HttpParser parser;
+      VERIFY(parser.parse(bad[i], strlen(bad[i])) == HttpParser::Error);
+    }
+  }
+  {
+    std::string body;
+    int consumed;
+    std::string chunked = "5\r\nhello\r\n1;ext=1\r\n \r\n0\r\nTrailer: x\r\n\r\n";
+    for (unsigned int i = 0; i < chunked.size(); i++) {
+      VERIFY(HttpParser::Dechunk(chunked.data(), i, body, consumed) ==
+             HttpParser::Incomplete);
+    }
+    VERIFY(HttpParser::Dechunk(chunked.data(), chunked.size(), body,
+                               consumed) == HttpParser::Done);
+    VERIFY(body == "hello " && consumed == (int)chunked.size());
+    VERIFY(HttpParser::Dechunk("5\r\nhelloX\r\n", 11, body, consumed) ==
+           HttpParser::Error);
+    VERIFY(HttpParser::Dechunk("x\r\n", 3, body, consumed) ==
+           HttpParser::Error);
+  }
+  {
+    // fuzzing: mutated requests must never be read out of bounds, and
+    // parsing them whole or bit by bit has to agree
+    static const char *seeds[] = {
+      "GET /a/b?c=d HTTP/1.1\r\nHost: h\r\nCookie: a=b; c=d\r\n\r\n",
+      "POST / HTTP/1.0\r\nContent-Length: 3\r\n\r\nabc",
+      "PUT /p HTTP/1.1\nTransfer-Encoding: chunked\n\n3\nabc\n0\n\n",
+    };
+    static const char noise[] = "\r\n :\t\0\x7f,;aZ9";
+    unsigned int seed = 20121019;
+    for (int i = 0; i < 20000; i++) {
+      std::string req = seeds[i % 3];
+      int mutations = 1 + i % 4;
+      for (int j = 0; j < mutations; j++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int pos = (seed >> 8) % req.size();
+        char c = (seed >> 4) & 1 ? noise[(seed >> 16) % (sizeof(noise) - 1)]
+                                 : (char)(seed >> 16);
+        switch ((seed >> 24) % 3) {
+        case 0: req[pos] = c; break;
+        case 1: req.insert(req.begin() + pos, c); break;
+        case 2: req.erase(pos, 1); break;
+        }
+        if (req.empty()) req = "G";
+      }
+
+      HttpParser whole;
+      HttpParser::Status status = whole.parse(req.data(), req.size());
+      if (status == HttpParser::Done) {
+        VERIFY(whole.headSize() > 0 && whole.headSize() <= (int)req.size());
+        VERIFY(!whole.method().empty() && within(whole.method(), req));
+        VERIFY(!whole.url().empty() && within(whole.url(), req));
+        for (unsigned int k = 0; k < whole.headers().size(); k++) {
+          VERIFY(within(whole.headers()[k].name, req));
+          VERIFY(within(whole.headers()[k].value, req));
+        }
+        if (whole.chunked()) {
+          std::string body;
+          int consumed = 0;
+          int offset = whole.headSize();
+          if (HttpParser::Dechunk(req.data() + offset, req.size() - offset,
+                                  body, consumed) == HttpParser::Done) {
+            VERIFY(consumed > 0 && consumed <= (int)req.size() - offset);
+          }
+        }
+      }
+
+      HttpParser pieces;
+      HttpParser::Status last = HttpParser::Incomplete;
+      for (unsigned int size = 0; size <= req.size(); size += 7) {
+        last = pieces.parse(req.data(), size);
+        if (last != HttpParser::Incomplete) break;
+      }
+      if (last == HttpParser::Incomplete) {
+        last = pieces.parse(req.data(), req.size());
+      }
+      VERIFY(last == status);
+      if (status == HttpParser::Done) {
+        VERIFY(pieces.headSize() == whole.headSize());
+      }
+    }
+  }
+  return Count(true);
+}
+
+bool TestUtil::TestSSLSessionCache() {
+  char path[] = "/tmp/hphp_test_ssl_session_cache_XXXXXX";
+  int fd = mkstemp(path);
+  VERIFY(fd >= 0);
+  close(fd);
+  unsigned char id[] = { 1, 2, 3, 4 };
+  unsigned char data[SSLSessionCache::MaxSessionSize];
+  SSLSessionCache::TicketKey keys[2], otherKeys[2];
+  {
+    SSLSessionCache cache, other; // as if in two processes
+    VERIFY(cache.open(path, 64));
+    VERIFY(cache.add(id, sizeof(id), (const unsigned char *)"hello", 5,
+                     1000));
+    VERIFY(other.open(path, 64));
+    VERIFY(other.get(id, sizeof(id), data, 999) == 5);
+    VERIFY(memcmp(data, "hello", 5) == 0);
+    VERIFY(other.get(id, sizeof(id), data, 1000) == 0); // expired
+    VERIFY(other.get(id, 3, data, 999) == 0);
+    VERIFY(cache.getTicketKeys(keys) && other.getTicketKeys(otherKeys));
+    VERIFY(memcmp(keys, otherKeys, sizeof(keys)) == 0);
+
+    VERIFY(!cache.add(id, sizeof(id), data,
+                      SSLSessionCache::MaxSessionSize + 1, 1000));
+  }
+  {
+    // sessions and keys outlive the processes that made them
+    SSLSessionCache cache;
+    VERIFY(cache.open(path, 64));
+    VERIFY(cache.get(id, sizeof(id), data, 999) == 5);
+    VERIFY(cache.getTicketKeys(otherKeys));
+    VERIFY(memcmp(keys, otherKeys, sizeof(keys)) == 0);
+  }
+  {
+    // ticket keys roll over once they're lifetime seconds old
+    SSLSessionCache cache, other;
+    VERIFY(cache.open(path, 64) && other.open(path, 64));
+    time_t now = time(nullptr);
+    cache.rotateTicketKeys(now, 300);
+    VERIFY(cache.getTicketKeys(otherKeys));
+    VERIFY(memcmp(keys, otherKeys, sizeof(keys)) == 0);
+    cache.rotateTicketKeys(now + 300, 300);
+    VERIFY(other.getTicketKeys(otherKeys));
+    VERIFY(memcmp(&otherKeys[1], &keys[0], sizeof(keys[0])) == 0);
+    VERIFY(memcmp(&otherKeys[0], &keys[0], sizeof(keys[0])) != 0);
+    // and the other process doesn't roll them again
+    memcpy(keys, otherKeys, sizeof(keys));
+    other.rotateTicketKeys(now + 300, 300);
+    VERIFY(cache.getTicketKeys(otherKeys));
+    VERIFY(memcmp(keys, otherKeys, sizeof(keys)) == 0);
+    // after lifetime more, the previous key is too old to keep
+    cache.rotateTicketKeys(now + 900, 300);
+    VERIFY(cache.getTicketKeys(otherKeys));
+    VERIFY(memcmp(&otherKeys[0], &keys[0], sizeof(keys[0])) != 0);
+    VERIFY(memcmp(&otherKeys[1], &keys[0], sizeof(keys[0])) != 0);
+    memcpy(keys, otherKeys, sizeof(keys));
+  }
+  {
+    // a slot left half written by a process that died is taken over
+    SSLSessionCache cache;
+    VERIFY(cache.open(path, 64));
+    void *fault = mmap(nullptr, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+    VERIFY(fault != MAP_FAILED);
+    pid_t pid = fork();
+    if (pid == 0) {
+      // dies copying the session in
+      cache.add(id, sizeof(id), (const unsigned char *)fault, 5, 1000);
+      _exit(0);
+    }
+    int status;
+    VERIFY(pid > 0 && waitpid(pid, &status, 0) == pid);
+    munmap(fault, 4096);
+    VERIFY(WIFSIGNALED(status));
+    VERIFY(cache.get(id, sizeof(id), data, 999) == 0);
+    VERIFY(cache.add(id, sizeof(id), (const unsigned char *)"again", 5,
+                     1000));
+    VERIFY(cache.get(id, sizeof(id), data, 999) == 5);
+    VERIFY(memcmp(data, "again", 5) == 0);
+  }
+  {
+    // but not a change of size
+    SSLSessionCache cache;
+    VERIFY(cache.open(path, 128));
+    VERIFY(cache.get(id, sizeof(id), data, 999) == 0);
+    VERIFY(cache.getTicketKeys(otherKeys));
+    VERIFY(memcmp(keys, otherKeys, sizeof(keys)) != 0);
+  }
+  unlink(path);
+  return Count(true);
+}
+
+bool TestUtil::TestStaticRange() {
+  int start = -1, end = -1;
+  VERIFY(HttpRequestHandler::ParseRange("bytes=2-5", 10, start, end) == 1);
+  VERIFY(start == 2 && end == 5);
+  // open range: through the end
+  VERIFY(HttpRequestHandler::ParseRange("bytes=7-", 10, start, end) == 1);
+  VERIFY(start == 7 && end == 9);
+  // the end is clamped to the body
+  VERIFY(HttpRequestHandler::ParseRange("bytes=7-20", 10, start, end) == 1);
+  VERIFY(start == 7 && end == 9);
+  // suffix range: the last n bytes, or all of them
+  VERIFY(HttpRequestHandler::ParseRange("bytes=-3", 10, start, end) == 1);
+  VERIFY(start == 7 && end == 9);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=-30", 10, start, end) == 1);
+  VERIFY(start == 0 && end == 9);
+  // values too big for any body saturate instead of wrapping
+  VERIFY(HttpRequestHandler::ParseRange("bytes=0-99999999999999999999", 10,
+                                        start, end) == 1);
+  VERIFY(start == 0 && end == 9);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=-99999999999999999999", 10,
+                                        start, end) == 1);
+  VERIFY(start == 0 && end == 9);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=99999999999999999999-", 10,
+                                        start, end) == -1);
+
+  // unsatisfiable: answered with 416
+  VERIFY(HttpRequestHandler::ParseRange("bytes=10-", 10, start, end) == -1);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=12-15", 10, start, end) == -1);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=-0", 10, start, end) == -1);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=-3", 0, start, end) == -1);
+
+  // ignored, so the whole body is sent: multiple ranges, other units and
+  // malformed headers
+  VERIFY(HttpRequestHandler::ParseRange("", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=0-1,4-5", 10,
+                                        start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("items=0-1", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=5-2", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=-", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=--3", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes= 2-5", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=+2-5", 10, start, end) == 0);
+  VERIFY(HttpRequestHandler::ParseRange("bytes=2-5x", 10, start, end) == 0);
+  return Count(true);
+}
+
+bool TestUtil::TestStaticETag() {
+  std::string etag = "\"0123abcd\"";
+  VERIFY(HttpRequestHandler::MatchETag("\"0123abcd\"", etag));
+  VERIFY(HttpRequestHandler::MatchETag("W/\"0123abcd\"", etag));
+  VERIFY(HttpRequestHandler::MatchETag("*", etag));
+  VERIFY(HttpRequestHandler::MatchETag(" * ", etag));
+  VERIFY(HttpRequestHandler::MatchETag("\"x\", W/\"0123abcd\"", etag));
+  VERIFY(HttpRequestHandler::MatchETag("\"x\",\t\"0123abcd\" ", etag));
+
+  VERIFY(!HttpRequestHandler::MatchETag("", etag));
+  VERIFY(!HttpRequestHandler::MatchETag("\"x\"", etag));
+  VERIFY(!HttpRequestHandler::MatchETag("\"0123abc\"", etag));
+  VERIFY(!HttpRequestHandler::MatchETag("\"x0123abcd\"", etag));
+  VERIFY(!HttpRequestHandler::MatchETag("0123abcd", etag));
+  VERIFY(!HttpRequestHandler::MatchETag("\"*\"", etag));
+  return Count(true);
+}
+
+namespace {
+// writes the segments from their own memory, as the libevent server does
+// when the socket takes them right away
+class ZeroCopyTransport : public ReplayTransport {
+public:
+  virtual void sendSegmentsImpl(const std::vector<StringSlice> &segments,
+                                int size, int code) {
+    onZeroCopyProgress(size);
+    ReplayTransport::sendSegmentsImpl(segments, size, code);
+  }
+};
+}
+
+bool TestUtil::TestStaticZeroCopy() {
+  static const char data[] = "0123456789";
+  int len = sizeof(data) - 1;
+  Hdf hdf;
+  hdf["url"] = "/static.txt";
+  hdf["cmd"] = (int)Transport::GET;
+  HttpRequestHandler handler;
+  {
+    ZeroCopyTransport transport;
+    transport.replayInput(hdf);
+    handler.sendStaticContent(&transport, data, len, 0, false, "static.txt",
+                              "txt");
+    VERIFY(transport.getResponseCode() == 200);
+    VERIFY(transport.getResponseZeroCopySize() == len);
+    VERIFY(transport.getResponseCopiedSize() == 0);
+  }
+  {
+    // a range is sent from the cached copy too
+    hdf["headers"][0]["name"] = "Range";
+    hdf["headers"][0]["value"] = "bytes=2-5";
+    ZeroCopyTransport transport;
+    transport.replayInput(hdf);
+    handler.sendStaticContent(&transport, data, len, 0, false, "static.txt",
+                              "txt");
+    VERIFY(transport.getResponseCode() == 206);
+    VERIFY(transport.getResponseZeroCopySize() == 4);
+  }
+  {
+    // precompressed content still goes through sendRaw()
+    ZeroCopyTransport transport;
+    transport.replayInput(hdf);
+    handler.sendStaticContent(&transport, data, len, 0, true, "static.txt",
+                              "txt");
+    VERIFY(transport.getResponseZeroCopySize() == 0);
+  }
+  return Count(true);
+}
+
+bool TestUtil::TestCompressionDecision() {
+  bool lz4 = RuntimeOption::EnableLZ4Compression;
+  RuntimeOption::EnableLZ4Compression = true;
+  const char *accepts[] = { "gzip, lz4", "gzip", "identity" };
+  int codings[] = { CODING_LZ4, CODING_GZIP, 0 };
+  for (int i = 0; i < 3; i++) {
+    Hdf hdf;
+    hdf["url"] = "/page.php";
+    hdf["cmd"] = (int)Transport::GET;
+    hdf["headers"][0]["name"] = "Accept-Encoding";
+    hdf["headers"][0]["value"] = accepts[i];
+    ReplayTransport transport;
+    transport.replayInput(hdf);
+    VERIFY(transport.decideCompression() == codings[i]);
+  }
+  RuntimeOption::EnableLZ4Compression = lz4;
+  return Count(true);
+}
+
+static AccessLog::ThreadData s_accessLogData;
+static AccessLog::ThreadData *get_access_log_data() {
+  return &s_accessLogData;
+}
+
+/**
+ * Replaces every run of digits with a single 0, for fields that measure
+ * time and so differ from one line to the next.
+ */
+static string mask_digits(const string &s) {
+  string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (!isdigit(s[i])) {
+      out += s[i];
+    } else if (out.empty() || out[out.size() - 1] != '0' ||
+               !isdigit(s[i - 1])) {
+      out += '0';
+    }
+  }
+  return out;
+}
+
+bool TestUtil::TestAccessLogFormat() {
+  Hdf hdf;
+  hdf["url"] = "/dir/page.php?a=1&b=2";
+  hdf["cmd"] = (int)Transport::GET;
+  hdf["remote_host"] = "10.1.2.3";
+  hdf["headers"][0]["name"] = "Referer";
+  hdf["headers"][0]["value"] = "http://www.example.com/from";
+  hdf["headers"][1]["name"] = "Cookie";
+  hdf["headers"][1]["value"] = "other=1; user=j\"d\t\xC3\xA9; last=2";
+  hdf["headers"][2]["name"] = "Host";
+  hdf["headers"][2]["value"] = "www.example.com";
+  ReplayTransport transport;
+  transport.replayInput(hdf);
+  transport.sendString("not found", 404);
+  ServerNote::Add("color", "blue");
+  s_accessLogData.startTime = TimeStamp::Current();
+
+  AccessLog log(get_access_log_data);
+
+  auto compiled = [&](const char *format) {
+    AccessLog::LogFormat fields;
+    AccessLog::CompileFormat(format, fields);
+    string out;
+    log.formatLine(out, fields, &transport, nullptr);
+    return String(out);
+  };
+
+  // every directive, with and without the arguments it takes
+  VS(compiled("%h %b %B %s %S %U %v %r %q"),
+     "10.1.2.3 9 9 404 - /dir/page.php www.example.com "
+     "GET /dir/page.php?a=1&b=2 HTTP/1.1 -\n");
+  VS(compiled("%{Referer}i %{Missing}i %i"),
+     "http://www.example.com/from - -\n");
+  VS(compiled("%{user}C %{other}C %{none}C %C"),
+     "j\\\"d\\t\\xc3\\xa9 1 - -\n");
+  VS(compiled("%{color}n %{shape}n %n"), "blue - -\n");
+  VS(compiled("[%404s] [%200,404s] [%!404s] [%!200,404s] [%!404{Referer}i]"),
+     "[404] [404] [-] [-] [-]\n");
+  VS(compiled("100%% %200,304s %!404,500s %!200s|"), "100% - - 404|\n");
+  VS(compiled("text only"), "text only\n");
+  VS(compiled(""), "\n");
+
+  // fields that measure time or read counters only have a known shape
+  VS(String(mask_digits(compiled("%{%Y}t").data())), "0\n");
+  String t = compiled("%t"); // [dd/Mon/yyyy:hh:mm:ss +zzzz]
+  VERIFY(t.size() == 29 && t[0] == '[' && t[27] == ']');
+  VS(String(mask_digits(compiled("%D %d %T").data())), "0 0 0\n");
+  VS(String(mask_digits(compiled("%y %Z %z").data())), "0 0 0\n");
+  VERIFY(!compiled("%Y").same("-\n"));
+
+  VS(compiled("%h \"%r\" %s %b %{Referer}i %{user}C %{color}n"),
+     "10.1.2.3 \"GET /dir/page.php?a=1&b=2 HTTP/1.1\" 404 9 "
+     "http://www.example.com/from j\\\"d\\t\\xc3\\xa9 blue\n");
+  ServerNote::Reset();
+  return Count(true);
+}
+
+bool TestUtil::TestAsyncAccessLog() {
+  bool async = RuntimeOption::AsyncAccessLog;
+  int ringSize = RuntimeOption::AccessLogRingSize;
+  int flushInterval = RuntimeOption::AccessLogFlushInterval;
+  RuntimeOption::AsyncAccessLog = true;
+  RuntimeOption::AccessLogRingSize = 4; // holds 3 lines
+  RuntimeOption::AccessLogFlushInterval = 1000;
+
+  const char *path = "/tmp/hphp_test_access_log";
+  unlink(path);
+  Hdf hdf;
+  hdf["url"] = "/page.php";
+  hdf["cmd"] = (int)Transport::GET;
+  ReplayTransport transport;
+  transport.replayInput(hdf);
+  transport.sendString("ok", 200);
+
+  int lines = 0;
+  int64 dropped = 0;
+  {
+    AccessLog log(get_access_log_data);
+    log.init("%U %s", "", path, "");
+    s_accessLogData.ring.reset();
+    // the writer only wakes up once a second, so the ring fills up
+    for (int i = 0; i < 10; i++) {
+      log.log(&transport, nullptr);
+    }
+    dropped = log.dropped();
+    log.stop();
+    // written directly once the writer has stopped
+    log.log(&transport, nullptr);
+    VERIFY(log.dropped() == dropped);
+
+    std::ifstream f(path);
+    string line;
+    while (std::getline(f, line)) {
+      VS(String(line), "/page.php 200");
+      lines++;
+    }
+  }
+  s_accessLogData.ring.reset();
+  unlink(path);
+  RuntimeOption::AsyncAccessLog = async;
+  RuntimeOption::AccessLogRingSize = ringSize;
+  RuntimeOption::AccessLogFlushInterval = flushInterval;
+
+  VERIFY(dropped > 0);
+  VERIFY(lines == 10 - dropped + 1);
+  return Count(true);
+}
+
+namespace {
+// takes down each request it gets, and answers 404 for all but /a
+class StubBenchmark : public ReplayBenchmark {
+public:
+  Mutex mutex;
+  std::vector<string> seen;  // url, X-Test header and post data
+
+protected:
+  virtual RequestHandler *createRequestHandler();
+};
+
+class StubHandler : public RequestHandler {
+public:
+  explicit StubHandler(StubBenchmark *bench) : m_bench(bench) {}
+
+  virtual void handleRequest(Transport *transport) {
+    int size;
+    const char *post = (const char *)transport->getPostData(size);
+    string url = transport->getUrl();
+    {
+      Lock lock(m_bench->mutex);
+      m_bench->seen.push_back(url + " " + transport->getHeader("X-Test") +
+                              " " + string(post, size));
+    }
+    transport->sendString("ok", url == "/a" ? 200 : 404);
+  }
+
+private:
+  StubBenchmark *m_bench;
+};
+
+RequestHandler *StubBenchmark::createRequestHandler() {
+  return new StubHandler(this);
+}
+}
+
+bool TestUtil::TestReplayBenchmark() {
+  char path[] = "/tmp/hphp_test_replay_XXXXXX";
+  int fd = mkstemp(path);
+  VERIFY(fd >= 0);
+  close(fd);
+
+  // two requests, recorded 100ms apart
+  string saved = RuntimeOption::RecordStreamFile;
+  RuntimeOption::RecordStreamFile = path;
+  const char *urls[] = { "/a", "/b" };
+  const char *tags[] = { "one", "two" };
+  const char *posts[] = { "a=1", "b=2" };
+  for (int i = 0; i < 2; i++) {
+    if (i) usleep(100000);
+    Hdf hdf;
+    hdf["url"] = urls[i];
+    hdf["cmd"] = (int)Transport::POST;
+    hdf["headers"][0]["name"] = "X-Test";
+    hdf["headers"][0]["value"] = tags[i];
+    hdf["post"] = StringUtil::UUEncode(posts[i]).data();
+    ReplayTransport transport;
+    transport.replayInput(hdf);
+    ReplayBenchmark::RecordRequest(&transport);
+  }
+  RuntimeOption::RecordStreamFile = saved;
+
+  StubBenchmark bench;
+  VERIFY(bench.load(path));
+  unlink(path);
+  VERIFY(bench.m_requests.size() == 2);
+
+  // three rounds at the recorded pace on two threads
+  bench.run(2, 3, 1.0);
+  VERIFY(bench.m_results.size() == 6);
+  int notFound = 0;
+  for (unsigned int i = 0; i < bench.m_results.size(); i++) {
+    if (bench.m_results[i].code == 404) notFound++;
+  }
+  VERIFY(notFound == 3);
+  VERIFY(bench.report().find("6 requests on 2 threads") == 0);
+  VERIFY(bench.report().find(", 3 not 200\n") != string::npos);
+
+  // every request came back as recorded
+  VERIFY(bench.seen.size() == 6);
+  std::sort(bench.seen.begin(), bench.seen.end());
+  for (int i = 0; i < 6; i++) {
+    int r = i / 3;
+    VS(String(bench.seen[i]),
+       String(string(urls[r]) + " " + tags[r] + " " + posts[r]));
+  }
+
+  // Rounds start the recorded gap plus 1us apart, so the last request, /b
+  // of the third round, is due three gaps in: no sooner than 300ms.
+  VERIFY(bench.m_elapsed >= 300000);
+  return Count(true);
+}
+
+bool TestUtil::TestRawHttpTransport() {
+  RawHttpTransport transport;
+  string request = "GET /page HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+  VERIFY(transport.parse(request));
+  VS(String(transport.getUrl()), "/page");
+
+  // a chunked response keeps every chunk after the one head
+  transport.sendRaw((void*)"hello ", 6, 200, false, true);
+  transport.sendRaw((void*)"world", 5, 200, false, true);
+  transport.onSendEnd();
+  const string &response = transport.getResponse();
+  VS(transport.getResponseCode(), 200);
+  VERIFY(response.find("HTTP/1.1 200 OK\r\n") == 0);
+  VERIFY(response.find("HTTP/1.1", 1) == string::npos);
+  VERIFY(response.find("\r\n\r\nhello world") != string::npos);
+  VERIFY(response.size() ==
+         response.find("\r\n\r\n") + strlen("\r\n\r\nhello world"));
+  return Count(true);
+}
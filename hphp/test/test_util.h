@@ -32,6 +32,18 @@ class TestUtil : public TestBase {
   bool TestSharedString();
   bool TestCanonicalize();
   bool TestHDF();
+  bool TestLatencyHistogram();
+  bool TestJobQueue();
+  bool TestHttpParser();
+  bool TestSSLSessionCache();
+  bool TestStaticRange();
+  bool TestStaticETag();
+  bool TestStaticZeroCopy();
+  bool TestCompressionDecision();
+  bool TestAccessLogFormat();
+  bool TestAsyncAccessLog();
+  bool TestReplayBenchmark();
+  bool TestRawHttpTransport();
 };
 
 ///////////////////////////////////////////////////////////////////////////////
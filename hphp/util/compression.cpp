@@ -19,6 +19,9 @@
 #include "logger.h"
 #include "exception.h"
 
+#include <lz4.h>
+#include <lz4hc.h>
+
 #define PHP_ZLIB_MODIFIER 1000
 #define GZIP_HEADER_LENGTH 10
 #define GZIP_FOOTER_LENGTH 8
@@ -161,6 +164,20 @@ bool is_compressible_file(const char *filename) {
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// ResponseCompressor
+
+ResponseCompressor *ResponseCompressor::Create(int encoding_mode, int level) {
+  switch (encoding_mode) {
+  case CODING_GZIP:
+  case CODING_DEFLATE:
+    return new StreamCompressor(level, encoding_mode, true);
+  case CODING_LZ4:
+    return new LZ4StreamCompressor(level);
+  }
+  return nullptr;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // StreamCompressor
 
@@ -208,6 +225,10 @@ StreamCompressor::~StreamCompressor() {
   }
 }
 
+const char *StreamCompressor::getEncoding() const {
+  return m_encoding == CODING_GZIP ? "gzip" : "deflate";
+}
+
 char *StreamCompressor::compress(const char *data, int &len, bool trailer) {
   // middle chunks should never be zero size
   assert(len || trailer);
@@ -272,6 +293,45 @@ char *StreamCompressor::compress(const char *data, int &len, bool trailer) {
   return nullptr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// LZ4StreamCompressor
+
+LZ4StreamCompressor::LZ4StreamCompressor(int level) : m_hc(level >= 9) {
+}
+
+char *LZ4StreamCompressor::compress(const char *data, int &len,
+                                    bool trailer) {
+  // every chunk is a frame of its own, so there is nothing left to flush
+  if (len == 0) {
+    assert(trailer);
+    return (char *)calloc(1, 1);
+  }
+
+  int bound = LZ4_compressBound(len);
+  if (bound <= 0) {
+    return nullptr;
+  }
+  char *s2 = (char *)malloc(bound + 5 /* varint */ + 1 /* \0 */);
+  char *p = s2;
+  for (unsigned int val = len; ; val >>= 7) {
+    if (val < 128) {
+      *p++ = (char)val;
+      break;
+    }
+    *p++ = 0x80 | (char)(val & 0x7f);
+  }
+
+  int csize = m_hc ? LZ4_compressHC(data, p, len) : LZ4_compress(data, p, len);
+  if (csize <= 0) {
+    free(s2);
+    Logger::Error("lz4 compression failed: len=%d", len);
+    return nullptr;
+  }
+  len = (p - s2) + csize;
+  s2[len] = '\0';
+  return s2;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 char *gzencode(const char *data, int &len, int level, int encoding_mode) {
@@ -23,6 +23,7 @@
 // encoding_mode
 #define CODING_GZIP     1
 #define CODING_DEFLATE  2
+#define CODING_LZ4      3  // responses only, see LZ4StreamCompressor
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -35,15 +36,38 @@ char *gzdecode(const char *data, int &len);
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class StreamCompressor {
+/**
+ * Compresses a response one chunk a time, for one of the content codings
+ * above. Returned buffers are malloc()-ed and owned by the caller.
+ */
+class ResponseCompressor {
 public:
-  StreamCompressor(int level, int encoding_mode, bool header);
-  ~StreamCompressor();
+  /**
+   * Creates a compressor for an encoding_mode, or returns nullptr if the
+   * mode is not known.
+   */
+  static ResponseCompressor *Create(int encoding_mode, int level);
+
+  virtual ~ResponseCompressor() {}
+
+  /**
+   * Value of the Content-Encoding header for compressed output.
+   */
+  virtual const char *getEncoding() const = 0;
 
   /**
    * Compress one chunk a time.
    */
-  char *compress(const char *data, int &len, bool trailer);
+  virtual char *compress(const char *data, int &len, bool trailer) = 0;
+};
+
+class StreamCompressor : public ResponseCompressor {
+public:
+  StreamCompressor(int level, int encoding_mode, bool header);
+  ~StreamCompressor();
+
+  virtual const char *getEncoding() const;
+  virtual char *compress(const char *data, int &len, bool trailer);
 
 private:
   int m_level;
@@ -54,6 +78,22 @@ private:
   bool m_ended;
 };
 
+/**
+ * Writes each chunk as the same frame lz4compress() produces: the
+ * uncompressed size as a varint, then one LZ4 block. Much cheaper on CPU
+ * than zlib, but only our own clients understand it.
+ */
+class LZ4StreamCompressor : public ResponseCompressor {
+public:
+  explicit LZ4StreamCompressor(int level);
+
+  virtual const char *getEncoding() const { return "lz4"; }
+  virtual char *compress(const char *data, int &len, bool trailer);
+
+private:
+  bool m_hc; // high compression mode, for the top levels
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 
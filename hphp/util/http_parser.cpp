@@ -0,0 +1,301 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <util/http_parser.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+using folly::StringPiece;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+// what each byte can be part of, so scanning a line is one lookup per byte
+enum CharClass {
+  TokenChar = 1, // RFC 7230 tchar, for methods and header names
+  TextChar  = 2, // allowed in header values: no controls but tab
+};
+
+static struct CharClasses {
+  unsigned char of[256];
+  CharClasses() {
+    for (int c = 0; c < 256; c++) {
+      of[c] = (c >= 0x20 && c != 0x7f) || c == '\t' ? TextChar : 0;
+      if (isalnum(c) || (c && strchr("!#$%&'*+-.^_`|~", c))) {
+        of[c] |= TokenChar;
+      }
+    }
+  }
+} s_chars;
+
+static bool is_token_char(char c) {
+  return s_chars.of[(unsigned char)c] & TokenChar;
+}
+
+static bool is_text_char(char c) {
+  return s_chars.of[(unsigned char)c] & TextChar;
+}
+
+static bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static int hex_value(char c) {
+  if (is_digit(c)) return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t';
+}
+
+static bool iequals(StringPiece s, const char *lit) {
+  size_t len = strlen(lit);
+  return s.size() == len && strncasecmp(s.data(), lit, len) == 0;
+}
+
+static StringPiece trim(const char *p, const char *end) {
+  while (p < end && is_space(*p)) p++;
+  while (end > p && is_space(end[-1])) end--;
+  return StringPiece(p, end);
+}
+
+// the end of the line starting at p, not counting a CR before the LF
+static const char *line_end(const char *p, const char *end,
+                            const char *&next) {
+  const char *lf = (const char *)memchr(p, '\n', end - p);
+  if (!lf) return nullptr;
+  next = lf + 1;
+  return lf > p && lf[-1] == '\r' ? lf - 1 : lf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void HttpParser::reset() {
+  m_method.clear();
+  m_url.clear();
+  m_versionMajor = m_versionMinor = 0;
+  m_headers.clear();
+  m_headSize = 0;
+  m_scanned = 0;
+  m_contentLength = -1;
+  m_chunked = false;
+  m_keepAlive = false;
+}
+
+HttpParser::Status HttpParser::parse(const char *data, int size) {
+  if (m_headSize) return Done;
+
+  // empty lines before the request line are allowed
+  int start = 0;
+  while (start < size && (data[start] == '\r' || data[start] == '\n')) {
+    start++;
+  }
+
+  const char *end = data + size;
+  const char *p = data + (m_scanned > start ? m_scanned : start);
+  const char *headEnd = nullptr;
+  while (true) {
+    const char *lf = (const char *)memchr(p, '\n', end - p);
+    if (!lf) {
+      m_scanned = size;
+      break;
+    }
+    const char *q = lf + 1;
+    if (q < end && *q == '\r') q++;
+    if (q >= end) {
+      m_scanned = lf - data; // the next line may turn out to be empty
+      break;
+    }
+    if (*q == '\n') {
+      headEnd = q + 1;
+      break;
+    }
+    p = lf + 1;
+  }
+  if (!headEnd) {
+    return size - start > MaxHeadSize ? Error : Incomplete;
+  }
+  if (headEnd - (data + start) > MaxHeadSize) return Error;
+
+  Status status = parseHead(data + start, headEnd);
+  if (status == Done) {
+    m_headSize = headEnd - data;
+  }
+  return status;
+}
+
+HttpParser::Status HttpParser::parseHead(const char *p, const char *end) {
+  if (parseRequestLine(p, end) != Done) return Error;
+
+  while (p < end) {
+    const char *next;
+    const char *eol = line_end(p, end, next);
+    if (eol == p) break; // the empty line ending the head
+    if (is_space(*p)) return Error; // obs-fold
+
+    const char *colon = p;
+    while (colon < eol && is_token_char(*colon)) colon++;
+    if (colon == p || colon == eol || *colon != ':') return Error;
+    for (const char *c = colon + 1; c < eol; c++) {
+      if (!is_text_char(*c)) return Error;
+    }
+    if ((int)m_headers.size() >= MaxHeaders) return Error;
+
+    Header header;
+    header.name = StringPiece(p, colon);
+    header.value = trim(colon + 1, eol);
+    m_headers.push_back(header);
+    p = next;
+  }
+  return checkHeaders();
+}
+
+HttpParser::Status HttpParser::parseRequestLine(const char *&p,
+                                                const char *end) {
+  const char *next;
+  const char *eol = line_end(p, end, next);
+  if (!eol) return Error;
+
+  const char *q = p;
+  while (q < eol && is_token_char(*q)) q++;
+  if (q == p || q == eol || *q != ' ') return Error;
+  m_method = StringPiece(p, q);
+
+  p = ++q;
+  while (q < eol && (unsigned char)*q > ' ' && *q != 0x7f) q++;
+  if (q == p || q == eol || *q != ' ') return Error;
+  m_url = StringPiece(p, q);
+
+  p = ++q;
+  if (eol - p != 8 || strncmp(p, "HTTP/", 5) ||
+      !is_digit(p[5]) || p[6] != '.' || !is_digit(p[7])) {
+    return Error;
+  }
+  m_versionMajor = p[5] - '0';
+  m_versionMinor = p[7] - '0';
+  if (m_versionMajor != 1) return Error;
+
+  p = next;
+  return Done;
+}
+
+HttpParser::Status HttpParser::checkHeaders() {
+  m_keepAlive = m_versionMinor >= 1;
+  bool transferEncoding = false;
+  for (unsigned int i = 0; i < m_headers.size(); i++) {
+    const Header &header = m_headers[i];
+    if (iequals(header.name, "Content-Length")) {
+      StringPiece value = header.value;
+      if (value.empty() || value.size() > 18) return Error;
+      int64 length = 0;
+      for (unsigned int j = 0; j < value.size(); j++) {
+        if (!is_digit(value[j])) return Error;
+        length = length * 10 + (value[j] - '0');
+      }
+      if (m_contentLength >= 0 && m_contentLength != length) return Error;
+      m_contentLength = length;
+    } else if (iequals(header.name, "Transfer-Encoding")) {
+      // only the last coding matters, and it has to be chunked
+      const char *begin = header.value.begin();
+      const char *comma = header.value.end();
+      while (comma > begin && comma[-1] != ',') comma--;
+      m_chunked = iequals(trim(comma, header.value.end()), "chunked");
+      transferEncoding = true;
+    } else if (iequals(header.name, "Connection")) {
+      const char *p = header.value.begin();
+      const char *end = header.value.end();
+      while (p < end) {
+        const char *comma = (const char *)memchr(p, ',', end - p);
+        if (!comma) comma = end;
+        StringPiece option = trim(p, comma);
+        if (iequals(option, "close")) {
+          m_keepAlive = false;
+          break;
+        }
+        if (iequals(option, "keep-alive")) {
+          m_keepAlive = true;
+        }
+        p = comma + 1;
+      }
+    }
+  }
+  if (transferEncoding && (!m_chunked || m_contentLength >= 0)) {
+    return Error;
+  }
+  return Done;
+}
+
+StringPiece HttpParser::getHeader(StringPiece name) const {
+  for (unsigned int i = 0; i < m_headers.size(); i++) {
+    const StringPiece &n = m_headers[i].name;
+    if (n.size() == name.size() &&
+        strncasecmp(n.data(), name.data(), n.size()) == 0) {
+      return m_headers[i].value;
+    }
+  }
+  return StringPiece();
+}
+
+HttpParser::Status HttpParser::Dechunk(const char *data, int size,
+                                       std::string &body, int &consumed) {
+  const char *p = data;
+  const char *end = data + size;
+  body.clear();
+  while (true) {
+    const char *next;
+    const char *eol = line_end(p, end, next);
+    if (!eol) return end - p > MaxHeadSize ? Error : Incomplete;
+
+    int64 chunkSize = 0;
+    const char *q = p;
+    for (; q < eol && hex_value(*q) >= 0; q++) {
+      if (q - p == 15) return Error;
+      chunkSize = chunkSize * 16 + hex_value(*q);
+    }
+    if (q == p || (q < eol && *q != ';')) return Error; // or an extension
+    p = next;
+
+    if (chunkSize == 0) {
+      // skip trailers, up to the empty line
+      while (true) {
+        eol = line_end(p, end, next);
+        if (!eol) return end - p > MaxHeadSize ? Error : Incomplete;
+        bool empty = eol == p;
+        p = next;
+        if (empty) {
+          consumed = p - data;
+          return Done;
+        }
+      }
+    }
+
+    if (end - p < chunkSize) return Incomplete;
+    body.append(p, chunkSize);
+    p += chunkSize;
+    // the chunk's data ends with a line break
+    if (p < end && *p == '\r') p++;
+    if (p >= end) return Incomplete;
+    if (*p != '\n') return Error;
+    p++;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
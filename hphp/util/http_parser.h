@@ -0,0 +1,110 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_HTTP_PARSER_H__
+#define __HPHP_HTTP_PARSER_H__
+
+#include <util/base.h>
+#include <folly/Range.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Parses the head of an HTTP/1.x request without copying it: the method,
+ * URL and headers are StringPieces into the caller's buffer, which has to
+ * stay around for as long as they are used.
+ *
+ * parse() can be called again with more data, and picks up where it left
+ * off looking for the end of the head. Anything that could make two
+ * servers disagree about where a request ends is rejected: folded headers,
+ * space before a header's colon, bad or conflicting Content-Length values,
+ * and Content-Length with Transfer-Encoding.
+ */
+class HttpParser {
+public:
+  enum Status {
+    Incomplete,
+    Done,
+    Error,
+  };
+
+  struct Header {
+    folly::StringPiece name;
+    folly::StringPiece value;
+  };
+
+  static const int MaxHeadSize = 64 * 1024;
+  static const int MaxHeaders = 256;
+
+  HttpParser() { reset(); }
+  void reset();
+
+  /**
+   * data holds everything received so far, starting from the request line.
+   */
+  Status parse(const char *data, int size);
+
+  folly::StringPiece method() const { return m_method; }
+  folly::StringPiece url() const { return m_url; }
+  int versionMajor() const { return m_versionMajor; }
+  int versionMinor() const { return m_versionMinor; }
+  const std::vector<Header> &headers() const { return m_headers; }
+
+  /**
+   * The first value of a header, with the name matched case-insensitively.
+   * Empty if there's no such header.
+   */
+  folly::StringPiece getHeader(folly::StringPiece name) const;
+
+  /**
+   * Bytes taken by the request line and headers, including the empty line
+   * at the end. The body starts right after.
+   */
+  int headSize() const { return m_headSize; }
+
+  int64 contentLength() const { return m_contentLength; } // -1 if none
+  bool chunked() const { return m_chunked; }
+  bool keepAlive() const { return m_keepAlive; }
+
+  /**
+   * Decodes a chunked body, which starts at data, into body. Trailers are
+   * skipped. On Done, consumed is how many bytes the body took.
+   */
+  static Status Dechunk(const char *data, int size, std::string &body,
+                        int &consumed);
+
+private:
+  folly::StringPiece m_method;
+  folly::StringPiece m_url;
+  int m_versionMajor;
+  int m_versionMinor;
+  std::vector<Header> m_headers;
+  int m_headSize;
+  int m_scanned;   // how far we have looked for the end of the head
+  int64 m_contentLength;
+  bool m_chunked;
+  bool m_keepAlive;
+
+  Status parseHead(const char *p, const char *end);
+  Status parseRequestLine(const char *&p, const char *end);
+  Status checkHeaders();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_HTTP_PARSER_H__
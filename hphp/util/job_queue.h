@@ -19,12 +19,16 @@
 
 #include <vector>
 #include <set>
+#include <map>
+#include <deque>
+#include <algorithm>
 #include "util/async_func.h"
 #include "util/synchronizable_multi.h"
 #include "util/lock.h"
 #include "util/atomic.h"
 #include "util/alloc.h"
 #include "util/exception.h"
+#include "util/compatibility.h"
 
 namespace HPHP {
 ///////////////////////////////////////////////////////////////////////////////
@@ -91,28 +95,93 @@ public:
       : SynchronizableMulti(threadRoundRobin ? 1 : threadCount),
         m_jobCount(0), m_stopped(false), m_workerCount(0),
         m_dropCacheTimeout(dropCacheTimeout), m_dropStack(dropStack),
-        m_lifo(lifo) {
+        m_lifo(lifo), m_shedTarget(0), m_shedInterval(0), m_minDelay(0),
+        m_lastDelay(0), m_overloaded(false) {
+    m_intervalEnd.tv_sec = m_intervalEnd.tv_nsec = 0;
+  }
+
+  /**
+   * Turn on CoDel-style load shedding: once jobs have waited longer than
+   * targetMs for a whole intervalMs, the queue is overloaded and dequeue()
+   * flags jobs that waited more than twice targetMs as expired, until waits
+   * drop back under targetMs. Zero targetMs turns it off.
+   */
+  void setLoadShedding(int targetMs, int intervalMs) {
+    Lock lock(this);
+    m_shedTarget = targetMs * 1000LL;
+    m_shedInterval = intervalMs * 1000LL;
+    m_overloaded = false;
+    m_intervalEnd.tv_sec = m_intervalEnd.tv_nsec = 0;
   }
 
   /**
    * Put a job into the queue and notify a worker to pick it up.
+   *
+   * A job can have an owner, like the request that created it. Owners take
+   * turns, so an owner with many queued jobs cannot hold up other owners'
+   * jobs, while each owner's jobs are still taken in order. Jobs without an
+   * owner share a single turn.
+   */
+  void enqueue(TJob job, const void *owner = nullptr) {
+    Lock lock(this);
+    JobList &jobs = owner ? m_ownerJobs[owner] : m_jobs;
+    if (jobs.empty()) {
+      m_owners.push_back(owner);
+    }
+    jobs.push_back(QueuedJob(job));
+    m_jobCount++;
+    notify();
+  }
+
+  /**
+   * Put a job ahead of all normal ones, e.g. a health check. Such jobs are
+   * never shed.
    */
-  void enqueue(TJob job) {
+  void enqueuePriority(TJob job) {
     Lock lock(this);
-    m_jobs.push_back(job);
-    m_jobCount = m_jobs.size();
+    m_priorityJobs.push_back(QueuedJob(job));
+    m_jobCount++;
     notify();
   }
 
+  /**
+   * Move a queued job ahead of all others, because something is blocked
+   * waiting for it. Returns false if a worker has already taken the job.
+   */
+  bool promote(TJob job, const void *owner = nullptr) {
+    Lock lock(this);
+    JobList *jobs = &m_jobs;
+    if (owner) {
+      typename std::map<const void*, JobList>::iterator iter =
+        m_ownerJobs.find(owner);
+      if (iter == m_ownerJobs.end()) return false;
+      jobs = &iter->second;
+    }
+    typename JobList::iterator iter = jobs->begin();
+    while (iter != jobs->end() && !(iter->job == job)) ++iter;
+    if (iter == jobs->end()) return false;
+    QueuedJob queued = *iter;
+    jobs->erase(iter);
+    if (m_lifo) {
+      jobs->push_back(queued);
+    } else {
+      jobs->push_front(queued);
+    }
+    m_owners.erase(std::find(m_owners.begin(), m_owners.end(), owner));
+    m_owners.push_front(owner);
+    return true;
+  }
+
   /**
    * Grab a job from the queue for processing. Since the job was not created
    * by this queue class, it's up to a worker class on whether to deallocate
-   * the job object correctly.
+   * the job object correctly. With load shedding on, expired tells whether
+   * the job waited too long and should be turned away instead.
    */
-  TJob dequeue(int id, bool inc = false) {
+  TJob dequeue(int id, bool inc = false, bool *expired = nullptr) {
     Lock lock(this);
     bool flushed = false;
-    while (m_jobs.empty()) {
+    while (m_jobCount == 0) {
       if (m_stopped) {
         throw StopSignal();
       }
@@ -120,7 +189,7 @@ public:
         wait(id, false);
       } else if (!wait(id, true, m_dropCacheTimeout)) {
         // since we timed out, maybe we can turn idle without holding memory
-        if (m_jobs.empty()) {
+        if (m_jobCount == 0) {
           ScopedUnlock unlock(this);
           Util::flush_thread_caches();
           if (m_dropStack && Util::s_stackLimit) {
@@ -132,15 +201,55 @@ public:
       }
     }
     if (inc) incActiveWorker();
-    m_jobCount = m_jobs.size() - 1;
-    if (m_lifo) {
-      TJob job = m_jobs.back();
-      m_jobs.pop_back();
+    m_jobCount--;
+    if (expired) *expired = false;
+
+    if (!m_priorityJobs.empty()) {
+      TJob job = m_priorityJobs.front().job;
+      m_priorityJobs.pop_front();
       return job;
     }
-    TJob job = m_jobs.front();
-    m_jobs.pop_front();
-    return job;
+
+    const void *owner = m_owners.front();
+    m_owners.pop_front();
+    JobList &jobs = owner ? m_ownerJobs[owner] : m_jobs;
+    QueuedJob queued = m_lifo ? jobs.back() : jobs.front();
+    if (m_lifo) {
+      jobs.pop_back();
+    } else {
+      jobs.pop_front();
+    }
+    if (!jobs.empty()) {
+      m_owners.push_back(owner);
+    } else if (owner) {
+      m_ownerJobs.erase(owner);
+    }
+
+    timespec now;
+    gettime(CLOCK_MONOTONIC, &now);
+    m_lastDelay = gettime_diff_us(queued.queued, now);
+    if (m_shedTarget > 0 && shouldShed(m_lastDelay, now) && expired) {
+      *expired = true;
+    }
+    return queued.job;
+  }
+
+  /**
+   * How long a job queued now can expect to wait, in microseconds: as long
+   * as the last job taken waited, or as long as the oldest job has been
+   * waiting, whichever is longer. Only meaningful for first-in, first-out
+   * queues.
+   */
+  int64 getEstimatedWait() {
+    Lock lock(this);
+    if (m_jobCount == 0) return 0;
+    int64 wait = m_lastDelay;
+    if (!m_jobs.empty()) {
+      timespec now;
+      gettime(CLOCK_MONOTONIC, &now);
+      wait = std::max(wait, gettime_diff_us(m_jobs.front().queued, now));
+    }
+    return wait;
   }
 
   /**
@@ -176,13 +285,51 @@ public:
   }
 
  private:
+  struct QueuedJob {
+    explicit QueuedJob(TJob j) : job(j) {
+      gettime(CLOCK_MONOTONIC, &queued);
+    }
+    TJob job;
+    timespec queued;
+  };
+  typedef std::deque<QueuedJob> JobList;
+
   int m_jobCount;
-  std::deque<TJob> m_jobs;
+  JobList m_jobs;                             // jobs without an owner
+  std::map<const void*, JobList> m_ownerJobs;
+  std::deque<const void*> m_owners;           // whose turn is next
+  JobList m_priorityJobs;                     // ahead of everybody's turn
   bool m_stopped;
   int m_workerCount;
   int m_dropCacheTimeout;
   bool m_dropStack;
   bool m_lifo;
+
+  // load shedding, all in microseconds
+  int64 m_shedTarget;
+  int64 m_shedInterval;
+  int64 m_minDelay;      // shortest wait in the current interval
+  int64 m_lastDelay;     // how long the last job taken waited
+  timespec m_intervalEnd;
+  bool m_overloaded;
+
+  bool shouldShed(int64 delay, const timespec &now) {
+    if (gettime_diff_us(m_intervalEnd, now) > 0) {
+      // the verdict on the interval that just ended holds for the next one
+      m_overloaded = m_minDelay > m_shedTarget;
+      m_minDelay = delay;
+      m_intervalEnd = now;
+      m_intervalEnd.tv_sec += m_shedInterval / 1000000;
+      m_intervalEnd.tv_nsec += m_shedInterval % 1000000 * 1000;
+      if (m_intervalEnd.tv_nsec >= 1000000000) {
+        m_intervalEnd.tv_sec++;
+        m_intervalEnd.tv_nsec -= 1000000000;
+      }
+    } else if (delay < m_minDelay) {
+      m_minDelay = delay;
+    }
+    return m_overloaded && delay > 2 * m_shedTarget;
+  }
 };
 
 template<class TJob, class Policy>
@@ -263,6 +410,12 @@ public:
    */
   virtual void doJob(TJob job) = 0;
   virtual void onThreadEnter() {}
+
+  /**
+   * Called instead of doJob() for a job the queue shed because it waited
+   * too long. Workers that can turn a job away cheaply should do so here.
+   */
+  virtual void abortJob(TJob job) { doJob(job); }
   virtual void onThreadExit() {}
 
   /**
@@ -273,8 +426,13 @@ public:
     onThreadEnter();
     while (!m_stopped) {
       try {
-        TJob job = m_queue->dequeue(m_id, countActive);
-        doJob(job);
+        bool expired;
+        TJob job = m_queue->dequeue(m_id, countActive, &expired);
+        if (expired) {
+          abortJob(job);
+        } else {
+          doJob(job);
+        }
         if (countActive) {
           if (!m_queue->decActiveWorker() && waitable) {
             Lock lock(m_queue);
@@ -384,10 +542,10 @@ public:
   }
 
   /**
-   * Enqueue a new job.
+   * Enqueue a new job, optionally on behalf of an owner.
    */
-  void enqueue(TJob job) {
-    m_queue.enqueue(job);
+  void enqueue(TJob job, const void *owner = nullptr) {
+    m_queue.enqueue(job, owner);
     // Spin up another worker thread if appropriate
     int target = getTargetNumWorkers();
     int n = m_workers.size();
@@ -396,6 +554,32 @@ public:
     }
   }
 
+  /**
+   * Enqueue a job ahead of all normal ones.
+   */
+  void enqueuePriority(TJob job) {
+    m_queue.enqueuePriority(job);
+    int target = getTargetNumWorkers();
+    int n = m_workers.size();
+    if (n < target) {
+      addWorker();
+    }
+  }
+
+  /**
+   * Move a queued job to the front of the queue.
+   */
+  bool promote(TJob job, const void *owner = nullptr) {
+    return m_queue.promote(job, owner);
+  }
+
+  void setLoadShedding(int targetMs, int intervalMs) {
+    m_queue.setLoadShedding(targetMs, intervalMs);
+  }
+  int64 getEstimatedWait() {
+    return m_queue.getEstimatedWait();
+  }
+
   /**
    * Add a worker thread on the fly.
    */
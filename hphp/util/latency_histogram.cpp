@@ -0,0 +1,97 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <util/latency_histogram.h>
+#include <limits>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+int LatencyHistogram::BucketOf(int64 value) {
+  if (value < (1 << SubBucketBits)) {
+    return value < 0 ? 0 : value;
+  }
+  if (value >> MaxValueBits) {
+    return BucketCount - 1;
+  }
+  // keep the top SubBucketBits bits of the value, and its magnitude
+  int magnitude = 63 - __builtin_clzll(value);
+  int shift = magnitude - (SubBucketBits - 1);
+  return (shift << (SubBucketBits - 1)) + (value >> shift);
+}
+
+int64 LatencyHistogram::HighestValueOf(int bucket) {
+  if (bucket < (1 << SubBucketBits)) {
+    return bucket;
+  }
+  int half = 1 << (SubBucketBits - 1);
+  int shift = bucket / half - 1;
+  int64 sub = bucket % half + half;
+  return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64 value) {
+  if (value < 0) value = 0;
+  m_buckets[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(value, std::memory_order_relaxed);
+
+  int64 old = m_min.load(std::memory_order_relaxed);
+  while (value < old &&
+         !m_min.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+  old = m_max.load(std::memory_order_relaxed);
+  while (value > old &&
+         !m_max.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::clear() {
+  for (int i = 0; i < BucketCount; i++) {
+    m_buckets[i].store(0, std::memory_order_relaxed);
+  }
+  m_count.store(0, std::memory_order_relaxed);
+  m_sum.store(0, std::memory_order_relaxed);
+  m_min.store(std::numeric_limits<int64>::max(), std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+}
+
+int64 LatencyHistogram::min() const {
+  return count() ? m_min.load(std::memory_order_relaxed) : 0;
+}
+
+int64 LatencyHistogram::percentile(double p) const {
+  int64 total = count();
+  if (total == 0) return 0;
+  int64 wanted = (int64)(p * total / 100 + 0.5);
+  if (wanted < 1) wanted = 1;
+  if (wanted > total) wanted = total;
+
+  int64 seen = 0;
+  for (int i = 0; i < BucketCount; i++) {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= wanted) {
+      int64 value = HighestValueOf(i);
+      // nothing recorded is larger than max
+      int64 largest = max();
+      return value < largest ? value : largest;
+    }
+  }
+  return max();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
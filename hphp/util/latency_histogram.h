@@ -0,0 +1,73 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_LATENCY_HISTOGRAM_H__
+#define __HPHP_LATENCY_HISTOGRAM_H__
+
+#include <util/base.h>
+#include <atomic>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A distribution of latencies, laid out like an HdrHistogram. Values below
+ * 64 are counted exactly. Above that, each power of two is split into 32
+ * equal buckets, so a reported percentile is off by at most about 3%.
+ * Values from 2^MaxValueBits up are counted in the last bucket.
+ *
+ * All counts are atomic, so any number of threads can record into the same
+ * histogram without taking a lock. Readers may see a recording that is only
+ * partly done, which is fine for statistics.
+ */
+class LatencyHistogram {
+public:
+  static const int SubBucketBits = 6;
+  static const int MaxValueBits = 36; // about 19 hours in microseconds
+  static const int BucketCount =
+    (MaxValueBits - SubBucketBits + 2) << (SubBucketBits - 1);
+
+  LatencyHistogram() { clear(); }
+
+  void record(int64 value);
+  void clear();
+
+  int64 count() const { return m_count.load(std::memory_order_relaxed); }
+  int64 sum() const { return m_sum.load(std::memory_order_relaxed); }
+  int64 min() const;
+  int64 max() const { return m_max.load(std::memory_order_relaxed); }
+
+  /**
+   * The smallest value that at least p percent of recorded values are less
+   * than or equal to, as precise as the bucket it falls in.
+   */
+  int64 percentile(double p) const;
+
+  static int BucketOf(int64 value);
+  static int64 HighestValueOf(int bucket);
+
+private:
+  std::atomic<int64> m_buckets[BucketCount];
+  std::atomic<int64> m_count;
+  std::atomic<int64> m_sum;
+  std::atomic<int64> m_min;
+  std::atomic<int64> m_max;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_LATENCY_HISTOGRAM_H__
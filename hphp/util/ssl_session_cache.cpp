@@ -0,0 +1,336 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <util/ssl_session_cache.h>
+#include <util/hash.h>
+#include <util/logger.h>
+#include <atomic>
+#include <sched.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+static const char s_magic[8] = { 'H', 'P', 'H', 'P', 'S', 'S', 'L', '2' };
+
+struct SSLSessionCache::Header {
+  char magic[8];
+  uint32 slots;
+  uint32 slotSize;
+  std::atomic<uint32> keySeq;   // odd while the keys are being replaced
+  std::atomic<int64> keyTime;   // when keys[0] became the current key
+  TicketKey keys[2];            // current and previous
+};
+
+struct SSLSessionCache::Slot {
+  // The low half is a sequence number, odd while the slot is being
+  // written, and the high half the pid of whoever wrote it last.
+  std::atomic<uint64> state;
+  uint32 idSize;
+  int64 expire;
+  unsigned char id[MaxIdSize];
+  uint32 size;
+  unsigned char data[MaxSessionSize];
+};
+
+static bool random_bytes(void *buf, size_t size) {
+  int fd = ::open("/dev/urandom", O_RDONLY);
+  if (fd < 0) return false;
+  bool ok = read(fd, buf, size) == (ssize_t)size;
+  ::close(fd);
+  return ok;
+}
+
+SSLSessionCache::SSLSessionCache()
+  : m_fd(-1), m_size(0), m_header(nullptr), m_slots(nullptr) {
+}
+
+SSLSessionCache::~SSLSessionCache() {
+  close();
+}
+
+bool SSLSessionCache::open(const std::string &path, int slots) {
+  assert(slots > 0);
+  close();
+  m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (m_fd < 0) {
+    Logger::Error("Unable to open SSL session cache %s: %s", path.c_str(),
+                  strerror(errno));
+    return false;
+  }
+
+  // keep other processes from using the file while it's being laid out
+  flock(m_fd, LOCK_EX);
+  size_t size = sizeof(Header) + sizeof(Slot) * slots;
+  struct stat st;
+  bool fresh = fstat(m_fd, &st) != 0 || (size_t)st.st_size != size;
+  if (fresh && (ftruncate(m_fd, 0) != 0 || ftruncate(m_fd, size) != 0)) {
+    Logger::Error("Unable to size SSL session cache %s: %s", path.c_str(),
+                  strerror(errno));
+    flock(m_fd, LOCK_UN);
+    close();
+    return false;
+  }
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    m_fd, 0);
+  if (addr == MAP_FAILED) {
+    Logger::Error("Unable to map SSL session cache %s: %s", path.c_str(),
+                  strerror(errno));
+    flock(m_fd, LOCK_UN);
+    close();
+    return false;
+  }
+  m_size = size;
+  m_header = (Header*)addr;
+  m_slots = (Slot*)(m_header + 1);
+
+  if (!fresh &&
+      (memcmp(m_header->magic, s_magic, sizeof(s_magic)) ||
+       m_header->slots != (uint32)slots ||
+       m_header->slotSize != sizeof(Slot))) {
+    memset(addr, 0, size);
+    fresh = true;
+  }
+  // Keys are only replaced under the lock, so odd keySeq here means
+  // whoever was replacing them died halfway.
+  if (fresh || (m_header->keySeq.load(std::memory_order_relaxed) & 1)) {
+    newTicketKeys(time(nullptr), true);
+  }
+  if (fresh) {
+    m_header->slots = slots;
+    m_header->slotSize = sizeof(Slot);
+    memcpy(m_header->magic, s_magic, sizeof(s_magic));
+  }
+  flock(m_fd, LOCK_UN);
+  return true;
+}
+
+void SSLSessionCache::close() {
+  if (m_header) {
+    munmap(m_header, m_size);
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_size = 0;
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+SSLSessionCache::Slot *SSLSessionCache::find(const unsigned char *id,
+                                             int idSize) {
+  assert(m_slots);
+  uint32 hash = hash_string_cs((const char *)id, idSize);
+  return &m_slots[hash % m_header->slots];
+}
+
+bool SSLSessionCache::add(const unsigned char *id, int idSize,
+                          const unsigned char *data, int size,
+                          time_t expire) {
+  if (!m_slots || idSize <= 0 || idSize > MaxIdSize ||
+      size <= 0 || size > MaxSessionSize) {
+    return false;
+  }
+  Slot *slot = find(id, idSize);
+  uint64 state = slot->state.load(std::memory_order_relaxed);
+  uint32 seq = state;
+  pid_t pid = getpid();
+  if (seq & 1) {
+    // Somebody else is writing it, and the session will just not be
+    // cached, unless they died halfway and the slot is ours to take.
+    pid_t writer = state >> 32;
+    if (writer == pid || kill(writer, 0) == 0 || errno != ESRCH) {
+      return false;
+    }
+  }
+  // odd either way, and different from what a reader may have seen
+  uint32 next = seq + ((seq & 1) ? 2 : 1);
+  uint64 mine = (uint64)pid << 32;
+  if (!slot->state.compare_exchange_strong(state, mine | next)) {
+    return false;
+  }
+  slot->idSize = idSize;
+  memcpy(slot->id, id, idSize);
+  slot->expire = expire;
+  slot->size = size;
+  memcpy(slot->data, data, size);
+  slot->state.store(mine | (uint32)(next + 1), std::memory_order_release);
+  return true;
+}
+
+int SSLSessionCache::get(const unsigned char *id, int idSize,
+                         unsigned char *data, time_t now) {
+  if (!m_slots || idSize <= 0 || idSize > MaxIdSize) return 0;
+  Slot *slot = find(id, idSize);
+  uint64 state = slot->state.load(std::memory_order_acquire);
+  if (state & 1) return 0;
+  int size = slot->size;
+  if (slot->idSize != (uint32)idSize || memcmp(slot->id, id, idSize) ||
+      slot->expire <= now || size <= 0 || size > MaxSessionSize) {
+    return 0;
+  }
+  memcpy(data, slot->data, size);
+  // the copy only counts if nobody wrote the slot while we were reading it
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->state.load(std::memory_order_relaxed) != state) return 0;
+  return size;
+}
+
+bool SSLSessionCache::getTicketKeys(TicketKey keys[2]) const {
+  if (!m_header) return false;
+  // replacing them only takes a moment, so try a few times
+  for (int i = 0; i < 100; i++) {
+    uint32 seq = m_header->keySeq.load(std::memory_order_acquire);
+    if (!(seq & 1)) {
+      memcpy(keys, m_header->keys, sizeof(m_header->keys));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_header->keySeq.load(std::memory_order_relaxed) == seq) {
+        return true;
+      }
+    }
+    sched_yield();
+  }
+  return false;
+}
+
+void SSLSessionCache::rotateTicketKeys(time_t now, int lifetime) {
+  if (!m_header ||
+      now - m_header->keyTime.load(std::memory_order_relaxed) < lifetime) {
+    return;
+  }
+  flock(m_fd, LOCK_EX);
+  // another process may have rotated them while we waited for the lock
+  int64 age = now - m_header->keyTime.load(std::memory_order_relaxed);
+  bool torn = m_header->keySeq.load(std::memory_order_relaxed) & 1;
+  if (torn || age >= lifetime) {
+    newTicketKeys(now, torn || age >= 2 * (int64)lifetime);
+  }
+  flock(m_fd, LOCK_UN);
+}
+
+void SSLSessionCache::newTicketKeys(time_t now, bool both) {
+  // called with the file locked, so there's only one writer
+  TicketKey fresh[2];
+  if (!random_bytes(fresh, sizeof(fresh))) {
+    Logger::Error("Unable to generate SSL session ticket keys");
+    return;
+  }
+  uint32 seq = m_header->keySeq.load(std::memory_order_relaxed) | 1;
+  m_header->keySeq.store(seq, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  m_header->keys[1] = both ? fresh[1] : m_header->keys[0];
+  m_header->keys[0] = fresh[0];
+  m_header->keyTime.store(now, std::memory_order_relaxed);
+  m_header->keySeq.store(seq + 1, std::memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// hooking it up with OpenSSL
+
+static SSLSessionCache s_cache;
+static int s_ticketKeyLifetime;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+typedef const unsigned char SessionId;
+#else
+typedef unsigned char SessionId;
+#endif
+
+static int new_session(SSL *ssl, SSL_SESSION *session) {
+  int size = i2d_SSL_SESSION(session, nullptr);
+  if (size > 0 && size <= SSLSessionCache::MaxSessionSize) {
+    unsigned char data[SSLSessionCache::MaxSessionSize];
+    unsigned char *p = data;
+    i2d_SSL_SESSION(session, &p);
+    unsigned int idSize;
+    const unsigned char *id = SSL_SESSION_get_id(session, &idSize);
+    s_cache.add(id, idSize, data, size,
+                SSL_SESSION_get_time(session) +
+                SSL_SESSION_get_timeout(session));
+  }
+  return 0; // we kept no reference to the session
+}
+
+static SSL_SESSION *get_session(SSL *ssl, SessionId *id, int idSize,
+                                int *copy) {
+  *copy = 0;
+  unsigned char data[SSLSessionCache::MaxSessionSize];
+  int size = s_cache.get(id, idSize, data, time(nullptr));
+  if (size == 0) return nullptr;
+  const unsigned char *p = data;
+  return d2i_SSL_SESSION(nullptr, &p, size);
+}
+
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+static int ticket_key(SSL *ssl, unsigned char *name, unsigned char *iv,
+                      EVP_CIPHER_CTX *ctx, HMAC_CTX *hctx, int enc) {
+  // checked on resumptions too, or keys would stay put while only those
+  // came in
+  s_cache.rotateTicketKeys(time(nullptr), s_ticketKeyLifetime);
+  SSLSessionCache::TicketKey keys[2];
+  if (enc) {
+    if (!s_cache.getTicketKeys(keys) ||
+        RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+      return -1;
+    }
+    memcpy(name, keys[0].name, sizeof(keys[0].name));
+    EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, keys[0].aes, iv);
+    HMAC_Init_ex(hctx, keys[0].hmac, sizeof(keys[0].hmac), EVP_sha256(),
+                 nullptr);
+    return 1;
+  }
+  if (!s_cache.getTicketKeys(keys)) return 0;
+  for (int i = 0; i < 2; i++) {
+    if (memcmp(name, keys[i].name, sizeof(keys[i].name))) continue;
+    HMAC_Init_ex(hctx, keys[i].hmac, sizeof(keys[i].hmac), EVP_sha256(),
+                 nullptr);
+    EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, keys[i].aes, iv);
+    // a ticket under the previous key is reissued under the current one
+    return i == 0 ? 1 : 2;
+  }
+  return 0; // unknown key: a full handshake
+}
+#endif
+
+bool SSLSessionCache::Enable(SSL_CTX *ctx, const std::string &path,
+                             int slots, int timeout) {
+  assert(ctx);
+  if (!s_cache.open(path, slots)) return false;
+
+  // Sessions live in the file only. Were OpenSSL to keep its own copies,
+  // freeing ctx would flush them, taking them out of the file as well,
+  // just when the next server is about to need them.
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER |
+                                 SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_set_timeout(ctx, timeout);
+  SSL_CTX_sess_set_new_cb(ctx, new_session);
+  SSL_CTX_sess_set_get_cb(ctx, get_session);
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+  s_ticketKeyLifetime = timeout;
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key);
+#endif
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,108 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010- Facebook, Inc. (http://www.facebook.com)         |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef __HPHP_SSL_SESSION_CACHE_H__
+#define __HPHP_SSL_SESSION_CACHE_H__
+
+#include <util/base.h>
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * SSL sessions kept in a file that is mapped into memory, so that they are
+ * shared by every process serving the same port and outlive any one of
+ * them: a server started with takeover resumes the sessions its predecessor
+ * handed out. Put the file on tmpfs, e.g. /dev/shm, to keep it off disk.
+ *
+ * The file is a direct mapped table of fixed size slots keyed by session
+ * id, each guarded by a sequence number, so lookups don't lock. The
+ * sequence number carries the writer's pid, so a slot left half written by
+ * a process that died is taken over by the next write to it.
+ *
+ * The file also holds the session ticket keys: tickets are issued under
+ * the current key, and those from the previous one are still accepted and
+ * reissued. The keys roll over once per session timeout, so a ticket stays
+ * good for at least that long and no key is used for more than twice that.
+ */
+class SSLSessionCache {
+public:
+  static const int MaxIdSize = 32;       // SSL_MAX_SSL_SESSION_ID_LENGTH
+  static const int MaxSessionSize = 1024;
+
+  struct TicketKey {
+    unsigned char name[16];
+    unsigned char hmac[32];              // HMAC-SHA256 key
+    unsigned char aes[32];               // AES-256-CBC key
+  };
+
+  /**
+   * Makes ctx look sessions up in the cache at path, with room for slots
+   * sessions, each good for timeout seconds, and take its ticket keys from
+   * there. Returns false if the file can't be set up.
+   */
+  static bool Enable(SSL_CTX *ctx, const std::string &path, int slots,
+                     int timeout);
+
+  SSLSessionCache();
+  ~SSLSessionCache();
+
+  /**
+   * Maps path, sizing it for slots entries. The table is started afresh
+   * when the file is new or was laid out for a different size.
+   */
+  bool open(const std::string &path, int slots);
+  void close();
+
+  bool add(const unsigned char *id, int idSize, const unsigned char *data,
+           int size, time_t expire);
+  /**
+   * Copies the session into data, which has room for MaxSessionSize bytes,
+   * and returns its size, or 0 if there's no unexpired entry for id.
+   */
+  int get(const unsigned char *id, int idSize, unsigned char *data,
+          time_t now);
+
+  /**
+   * Copies the current key into keys[0] and the previous one into keys[1].
+   * Returns false if they're being replaced and couldn't be read.
+   */
+  bool getTicketKeys(TicketKey keys[2]) const;
+  /**
+   * Makes the current key the previous one once it's lifetime seconds old,
+   * or replaces both once it's twice that.
+   */
+  void rotateTicketKeys(time_t now, int lifetime);
+
+private:
+  struct Header;
+  struct Slot;
+
+  int m_fd;
+  size_t m_size;
+  Header *m_header;
+  Slot *m_slots;
+
+  Slot *find(const unsigned char *id, int idSize);
+  void newTicketKeys(time_t now, bool both);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // __HPHP_SSL_SESSION_CACHE_H__
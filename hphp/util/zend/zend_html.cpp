@@ -20,6 +20,10 @@
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 
+#ifdef __x86_64__
+#include <emmintrin.h>
+#endif
+
 namespace HPHP {
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -459,6 +463,63 @@ static void init_entity_table() {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace {
+
+/*
+ * Finds runs of bytes that the encoders below copy through unchanged,
+ * 16 at a time: everything except a few special ASCII characters and,
+ * optionally, NUL and bytes >= 0x80. Blocks containing a special byte,
+ * and the final partial block, are left to the per-byte loops.
+ */
+struct SafeRunScanner {
+  static const int kMaxSpecial = 6;
+
+  SafeRunScanner(bool highIsSafe, bool nulIsSafe)
+    : m_num(0), m_highIsSafe(highIsSafe), m_nulIsSafe(nulIsSafe) {}
+
+  bool addSpecial(char c) {
+    if (m_num == kMaxSpecial) return false;
+#ifdef __x86_64__
+    m_special[m_num] = _mm_set1_epi8(c);
+#endif
+    m_num++;
+    return true;
+  }
+
+  // Length of the run of safe bytes at p.
+  int run(const char *p, const char *end) const {
+    const char *start = p;
+#ifdef __x86_64__
+    for (; end - p >= 16; p += 16) {
+      __m128i block = _mm_loadu_si128((const __m128i *)p);
+      __m128i hit = m_nulIsSafe ? _mm_setzero_si128() :
+        _mm_cmpeq_epi8(block, _mm_setzero_si128());
+      for (int i = 0; i < m_num; i++) {
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, m_special[i]));
+      }
+      unsigned mask = _mm_movemask_epi8(hit);
+      if (!m_highIsSafe) {
+        mask |= _mm_movemask_epi8(block);
+      }
+      if (mask) {
+        return p - start + __builtin_ctz(mask);
+      }
+    }
+#endif
+    return p - start;
+  }
+
+ private:
+#ifdef __x86_64__
+  __m128i m_special[kMaxSpecial];
+#endif
+  int m_num;
+  bool m_highIsSafe;
+  bool m_nulIsSafe;
+};
+
+}
+
 char *string_html_encode(const char *input, int &len, bool encode_double_quote,
                          bool encode_single_quote, bool utf8, bool nbsp) {
   assert(input);
@@ -481,7 +542,19 @@ char *string_html_encode(const char *input, int &len, bool encode_double_quote,
     return nullptr;
   }
   char *q = ret;
+  // Only the nbsp encoding looks at bytes >= 0x80.
+  SafeRunScanner scanner(!nbsp, true);
+  for (const char *c = "\"'<>&"; *c; c++) {
+    scanner.addSpecial(*c);
+  }
   for (const char *p = input, *end = input + len; p < end; p++) {
+    int run = scanner.run(p, end);
+    if (run) {
+      memcpy(q, p, run);
+      q += run;
+      p += run;
+      if (p == end) break;
+    }
     char c = *p;
     switch (c) {
     case '"':
@@ -560,8 +633,28 @@ char *string_html_encode_extra(const char *input, int &len,
   }
   char *q = ret;
   const char *rep = "\ufffd";
+
+  // The bulk copy is only usable when the map escapes a handful of
+  // characters, as it does for htmlspecialchars.
+  SafeRunScanner scanner(false, false);
+  bool useScanner = true;
+  for (int c = 1; c < 128 && useScanner; c++) {
+    if ((asciiMap->map[c & 64 ? 1 : 0] >> (c & 63)) & 1) {
+      useScanner = scanner.addSpecial(c);
+    }
+  }
+
   int32_t srcPosBytes;
   for (srcPosBytes = 0; srcPosBytes < len; /* incremented in-loop */) {
+    if (useScanner) {
+      int run = scanner.run(input + srcPosBytes, input + len);
+      if (run) {
+        memcpy(q, input + srcPosBytes, run);
+        q += run;
+        srcPosBytes += run;
+        if (srcPosBytes == len) break;
+      }
+    }
     unsigned char c = input[srcPosBytes];
     if (c && c < 128) {
       srcPosBytes++; // Optimize US-ASCII case